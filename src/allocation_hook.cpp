@@ -0,0 +1,147 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "memory_usage.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+namespace memory_usage {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+// Each block starts with a header that keeps the bytes counted when it was allocated,
+// 0 if counting had not started, so the frees of older blocks are not subtracted from
+// the live bytes. The header takes the alignment of the block, so the block stays aligned.
+constexpr size_t header_size = alignof(max_align_t);
+
+
+size_t header_offset(size_t alignment)
+{
+    return max(alignment, header_size);
+}
+
+
+size_t& counted_bytes(void* p)
+{
+    return static_cast<size_t*>(p)[-1];
+}
+
+
+void* allocate(size_t size, size_t alignment = 0)
+{
+    // operator new returns a distinct pointer even for 0 bytes
+    size = max(size, size_t(1));
+    const size_t offset = header_offset(alignment);
+    if (size > SIZE_MAX - offset) {
+        throw bad_alloc();
+    }
+
+    while (true) {
+        void* block = nullptr;
+        if (alignment == 0) {
+            block = malloc(offset + size);
+        } else if (posix_memalign(&block, alignment, offset + size) != 0) {
+            block = nullptr;
+        }
+
+        if (block != nullptr) {
+            void* p = static_cast<char*>(block) + offset;
+            counted_bytes(p) = detail::counting_allocations() ? size : 0;
+            if (counted_bytes(p) != 0) {
+                detail::record_allocation(size);
+            }
+            return p;
+        }
+
+        new_handler handler = get_new_handler();
+        if (handler == nullptr) {
+            throw bad_alloc();
+        }
+        handler();
+    }
+}
+
+
+void* allocate(size_t size, size_t alignment, const nothrow_t&) noexcept
+{
+    try {
+        return allocate(size, alignment);
+    } catch (const bad_alloc&) {
+        return nullptr;
+    }
+}
+
+
+/// alignment must be the one p was allocated with.
+void deallocate(void* p, size_t alignment = 0) noexcept
+{
+    if (p == nullptr) {
+        return;
+    }
+
+    if (counted_bytes(p) != 0) {
+        detail::record_deallocation(counted_bytes(p));
+    }
+    free(static_cast<char*>(p) - header_offset(alignment));
+}
+
+}
+
+}
+
+}
+
+
+using sbg_partitioner::memory_usage::allocate;
+using sbg_partitioner::memory_usage::deallocate;
+
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const nothrow_t& tag) noexcept { return allocate(size, 0, tag); }
+void* operator new[](size_t size, const nothrow_t& tag) noexcept { return allocate(size, 0, tag); }
+void* operator new(size_t size, align_val_t alignment) { return allocate(size, size_t(alignment)); }
+void* operator new[](size_t size, align_val_t alignment) { return allocate(size, size_t(alignment)); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t& tag) noexcept { return allocate(size, size_t(alignment), tag); }
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t& tag) noexcept { return allocate(size, size_t(alignment), tag); }
+
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, size_t) noexcept { deallocate(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { deallocate(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { deallocate(p); }
+void operator delete(void* p, align_val_t alignment) noexcept { deallocate(p, size_t(alignment)); }
+void operator delete[](void* p, align_val_t alignment) noexcept { deallocate(p, size_t(alignment)); }
+void operator delete(void* p, size_t, align_val_t alignment) noexcept { deallocate(p, size_t(alignment)); }
+void operator delete[](void* p, size_t, align_val_t alignment) noexcept { deallocate(p, size_t(alignment)); }
+void operator delete(void* p, align_val_t alignment, const nothrow_t&) noexcept { deallocate(p, size_t(alignment)); }
+void operator delete[](void* p, align_val_t alignment, const nothrow_t&) noexcept { deallocate(p, size_t(alignment)); }
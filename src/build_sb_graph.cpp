@@ -18,7 +18,9 @@
  ******************************************************************************/
 
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -26,12 +28,16 @@
 #include <rapidjson/document.h>
 #include <rapidjson/pointer.h>
 #include <rapidjson/istreamwrapper.h>
+#include <set>
+#include <stdexcept>
 #include <vector>
 #include <util/defs.hpp>
 #include <util/logger.hpp>
 
 #include "build_sb_graph.hpp"
 #include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+#include "trace.hpp"
 #include "weighted_sb_graph.hpp"
 
 #define CHECK_1_N_REL 1
@@ -84,6 +90,13 @@ struct Node {
     vector<Var> rhs;
     vector<Var> lhs;
 
+    /// (begin, end, weight) of consecutive ranges of the first interval with their own
+    /// weight, taken from a cost profile. If it is empty, every element weighs weight.
+    vector<tuple<int, int, int>> range_weights;
+
+    /// Weights of the other balance constraints, given as "weight": [w, c_1, ..., c_n].
+    vector<int> constraint_weights;
+
     Node(int id, int weight, vector<pair<int, int>>&& intervals, vector<Var>&& rhs, vector<Var>&& lhs)
       : id(id),
       weight(weight),
@@ -120,6 +133,127 @@ struct Node {
 }
 
 
+bool is_int_pair(const rapidjson::Value& value)
+{
+  return value.IsArray() and value.Size() == 2 and value[0].IsInt() and value[1].IsInt();
+}
+
+
+/// Checks a lhs or rhs array of a node with the given number of dimensions, whose
+/// definitions should be nodes in ids.
+bool validate_vars(const rapidjson::Value& vars, size_t dimensions, const set<int>& ids, const string& where, string& error)
+{
+  if (not vars.IsArray()) {
+    error = where + " should be an array";
+    return false;
+  }
+
+  for (const auto& var : vars.GetArray()) {
+    if (not var.IsObject() or not var.HasMember("id") or not var["id"].IsString()) {
+      error = where + " has a variable without a string id";
+      return false;
+    }
+
+    if (not var.HasMember("exp") or not var["exp"].IsArray() or var["exp"].Size() != dimensions) {
+      error = where + " has a variable without an expression for each dimension";
+      return false;
+    }
+    for (const auto& exp : var["exp"].GetArray()) {
+      if (not is_int_pair(exp)) {
+        error = where + " has an expression that is not a pair of integers";
+        return false;
+      }
+    }
+
+    if (not var.HasMember("defs") or not var["defs"].IsArray()) {
+      error = where + " has a variable without defs";
+      return false;
+    }
+    for (const auto& def : var["defs"].GetArray()) {
+      if (not def.IsInt() or ids.count(def.GetInt()) == 0) {
+        error = where + " has a definition that is not a node id";
+        return false;
+      }
+    }
+
+    if (var.HasMember("cost") and not var["cost"].IsUint()) {
+      error = where + " has a cost that is not an unsigned integer";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool validate_model(const rapidjson::Value& model, string& error)
+{
+  if (not model.IsObject() or not model.HasMember("nodes") or not model["nodes"].IsArray()
+      or model["nodes"].Empty()) {
+    error = "model should have a non empty nodes array";
+    return false;
+  }
+
+  set<int> ids;
+  for (const auto& node : model["nodes"].GetArray()) {
+    if (not node.IsObject() or not node.HasMember("id") or not node["id"].IsInt() or node["id"].GetInt() < 0) {
+      error = "nodes should have a non negative integer id";
+      return false;
+    }
+
+    if (not ids.insert(node["id"].GetInt()).second) {
+      error = "node " + to_string(node["id"].GetInt()) + " is repeated";
+      return false;
+    }
+  }
+
+  for (const auto& node : model["nodes"].GetArray()) {
+    const string where = "node " + to_string(node["id"].GetInt());
+
+    if (node.HasMember("weight")) {
+      const auto& weight = node["weight"];
+      bool valid = weight.IsInt() or (weight.IsArray() and not weight.Empty());
+      for (rapidjson::SizeType i = 0; valid and weight.IsArray() and i < weight.Size(); i++) {
+        valid = weight[i].IsInt();
+      }
+      if (not valid) {
+        error = where + " weight should be an integer or a non empty array of integers";
+        return false;
+      }
+    }
+
+    if (not node.HasMember("interval") or not node["interval"].IsArray() or node["interval"].Empty()) {
+      error = where + " should have a non empty interval array";
+      return false;
+    }
+    for (const auto& interval : node["interval"].GetArray()) {
+      if (not is_int_pair(interval) or interval[0].GetInt() > interval[1].GetInt()) {
+        error = where + " has an interval that is not a pair of integers [begin, end]";
+        return false;
+      }
+    }
+
+    if (not node.HasMember("lhs") or not node.HasMember("rhs")) {
+      error = where + " should have lhs and rhs";
+      return false;
+    }
+
+    const size_t dimensions = node["interval"].Size();
+    if (not validate_vars(node["lhs"], dimensions, ids, where + " lhs", error)
+        or not validate_vars(node["rhs"], dimensions, ids, where + " rhs", error)) {
+      return false;
+    }
+
+    if (node["lhs"].Empty()) {
+      error = where + " lhs should not be empty";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
 /// This funcion takes a json array and returns a list of parsed variable objects (Var)
 vector<Var> read_var_object(const rapidjson::Value& var_array)
 {
@@ -179,8 +313,16 @@ map<int, Node> create_node_objects_from_json(const Document& document)
     unsigned id = node["id"].GetInt();
 
     int node_weight = 1; // default value
-    if (node.HasMember("weight")) {
-      assert(node["weight"].IsInt());
+    vector<int> constraint_weights;
+    // build_sb_graph validated the weights, they are an int or a non-empty array of ints
+    if (node.HasMember("weight") and node["weight"].IsArray()) {
+      // multi-constraint weights, the first one is the node weight
+      for (const auto& weight : node["weight"].GetArray()) {
+        constraint_weights.push_back(weight.GetInt());
+      }
+      node_weight = constraint_weights.front();
+      constraint_weights.erase(constraint_weights.begin());
+    } else if (node.HasMember("weight")) {
       node_weight = node["weight"].GetInt();
     }
 
@@ -204,30 +346,132 @@ map<int, Node> create_node_objects_from_json(const Document& document)
     vector<Var> lhs = read_var_object(node["lhs"]);
 
     Node node_element = Node{int(id), node_weight, std::move(intervals), std::move(rhs), std::move(lhs)};
+    node_element.constraint_weights = std::move(constraint_weights);
 
     nodes.insert({node_element.id, node_element});
   }
 
   for (const auto& [i, n]: nodes) {
-    logging::sbg_log << n << endl;
+    logging::build_log << n << endl;
   }
-  logging::sbg_log << endl;
+  logging::build_log << endl;
 
   return nodes;
 }
 
 
-/// Creates a set of nodes, taking into aclogging::sbg_log the offset of each one to avoid collisions.
-tuple<OrdSet, NodeWeight> create_set_of_nodes(const map<int, Node>& nodes, map<int, int>& node_offsets, int& max_value)
+/// Sets the weight of each node from the measured costs of profile. Costs are scaled so
+/// an element with the mean cost per element weighs profile_mean_weight, and so do the
+/// elements without measures. Measures that overlap add up.
+void apply_cost_profile(map<int, Node>& nodes, const CostProfile& profile)
+{
+  struct RangeCost {
+    int begin;
+    int end;
+    double cost_per_element;
+  };
+
+  // elements of each row of the first interval
+  auto row_size = [] (const Node& node) {
+    double acc = 1;
+    for (size_t i = 1; i < node.intervals.size(); i++) {
+      acc *= node.intervals[i].second - node.intervals[i].first + 1;
+    }
+    return acc;
+  };
+
+  map<int, vector<RangeCost>> costs;
+  double total_cost = 0, total_elements = 0;
+  for (const auto& measure : profile) {
+    auto node = nodes.find(measure.id);
+    if (node == nodes.end() or node->second.intervals.empty()) {
+      logging::build_log << "cost profile: node " << measure.id << " does not exist" << endl;
+      continue;
+    }
+
+    const auto& first = node->second.intervals.front();
+    int begin = max(measure.begin, first.first);
+    int end = min(measure.end, first.second);
+    if (begin > end) {
+      continue;
+    }
+
+    double elements = (end - begin + 1) * row_size(node->second);
+    costs[measure.id].push_back(RangeCost{begin, end, measure.cost / elements});
+    total_cost += measure.cost;
+    total_elements += elements;
+  }
+
+  if (total_cost <= 0) {
+    return;
+  }
+
+  const double mean = total_cost / total_elements;
+  for (auto& [id, node] : nodes) {
+    auto node_costs = costs.find(id);
+    if (node_costs == costs.end()) {
+      node.weight = profile_mean_weight;
+      continue;
+    }
+
+    // Split the first interval at each measure boundary, and add the cost of the
+    // measures that cover each range
+    const auto& first = node.intervals.front();
+    vector<int> bounds = {first.first, first.second + 1};
+    for (const auto& range : node_costs->second) {
+      bounds.push_back(range.begin);
+      bounds.push_back(range.end + 1);
+    }
+    sort(bounds.begin(), bounds.end());
+    bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+
+    for (size_t b = 0; b + 1 < bounds.size(); b++) {
+      double cost = 0;
+      bool measured = false;
+      for (const auto& range : node_costs->second) {
+        if (range.begin <= bounds[b] and bounds[b] <= range.end) {
+          cost += range.cost_per_element;
+          measured = true;
+        }
+      }
+
+      int weight = measured ? max(1, int(lround(profile_mean_weight * cost / mean))) : profile_mean_weight;
+      if (not node.range_weights.empty() and get<2>(node.range_weights.back()) == weight) {
+        get<1>(node.range_weights.back()) = bounds[b + 1] - 1;
+      } else {
+        node.range_weights.emplace_back(bounds[b], bounds[b + 1] - 1, weight);
+      }
+    }
+
+    logging::build_log << "cost profile: node " << id << " has " << node.range_weights.size() << " weighted ranges" << endl;
+  }
+}
+
+
+/// Creates a set of nodes, taking into account the offset of each one to avoid collisions.
+tuple<OrdSet, NodeWeight, vector<NodeWeight>> create_set_of_nodes(const map<int, Node>& nodes, map<int, int>& node_offsets, int& max_value)
 {
   // We start to build out set of intervals from 0
   int current_max = 0;
   OrdSet node_set;
   NodeWeight weights;
 
+  // Every node has as many constraints as the node with most of them, 1 by default
+  size_t number_of_constraints = 0;
   for (const auto& [id, node] : nodes) {
+    number_of_constraints = max(number_of_constraints, node.constraint_weights.size());
+  }
+  vector<NodeWeight> constraint_weights(number_of_constraints);
+  auto add_constraint_weights = [&constraint_weights] (const SetPiece& set_piece, const Node& node) {
+    for (size_t c = 0; c < constraint_weights.size(); c++) {
+      int weight = c < node.constraint_weights.size() ? node.constraint_weights[c] : 1;
+      constraint_weights[c].insert({set_piece, weight});
+    }
+  };
 
-    logging::sbg_log << "Defining interval for node " << id << " ";
+  for (const auto& [id, node] : nodes) {
+
+    logging::build_log << "Defining interval for node " << id << endl;
 
     // Define the interval and add it to the node set taking into account the current offset
     // Create an offset for each equation node. We want that each equation has its
@@ -247,7 +491,7 @@ tuple<OrdSet, NodeWeight> create_set_of_nodes(const map<int, Node>& nodes, map<i
       Interval interval = Interval(interval_begin, 1, interval_end);
 
       array_of_nodes.emplaceBack(interval);
-      logging::sbg_log << interval << endl;
+      logging::build_log << interval << endl;
 
       // set this node offset, the difference between the interval and the original one
       node_offsets[id] =  interval_begin - node_interval.first;
@@ -257,14 +501,33 @@ tuple<OrdSet, NodeWeight> create_set_of_nodes(const map<int, Node>& nodes, map<i
         current_max = interval_end + 1;
       }
     }
-    node_set.emplace_hint(node_set.end(), array_of_nodes);
-    weights.insert({array_of_nodes, node.weight});
+    if (node.range_weights.empty()) {
+      node_set.emplace_hint(node_set.end(), array_of_nodes);
+      weights.insert({array_of_nodes, node.weight});
+      add_constraint_weights(array_of_nodes, node);
+      continue;
+    }
+
+    // A set piece for each range with its own weight, so the weight of any subset of
+    // a set piece is exact
+    const int offset = node_offsets[id];
+    for (const auto& [begin, end, weight] : node.range_weights) {
+      SetPiece range;
+      range.emplaceBack(Interval(begin + offset, 1, end + offset));
+      for (size_t i = 1; i < array_of_nodes.intervals().size(); i++) {
+        range.emplaceBack(array_of_nodes.intervals()[i]);
+      }
+
+      node_set.emplace_hint(node_set.end(), range);
+      weights.insert({range, weight});
+      add_constraint_weights(range, node);
+    }
   }
 
   // We save max value so edge domain will not collide with node domain
   max_value = current_max;
 
-  return {node_set, weights};
+  return {node_set, weights, constraint_weights};
 }
 
 
@@ -309,7 +572,7 @@ CanonMap create_set_edge_map(const OrdSet& pre_image, const OrdSet& edge_domain,
   for (const auto& var_exp : var_exps.exps()) {
     // If the slope is 0, we just return the expression.
     if (var_exp.slope() == 0) {
-      logging::sbg_log << "Creating constant interval" << endl;
+      logging::build_log << "Creating constant interval" << endl;
       LExp map_exp = var_exp;
       INT offset = var_exp.offset().numerator();
       if (i == 0) {
@@ -342,13 +605,13 @@ CanonMap create_set_edge_map(const OrdSet& pre_image, const OrdSet& edge_domain,
 
     i++;
   }
-  logging::sbg_log << "created " << i << " maps out of " << var_exps << endl;
+  logging::build_log << "created " << i << " maps out of " << var_exps << endl;
 
   // And create the map
   map.set_exp(map_exps);
 
   // useful for debugging
-  // logging::sbg_log << "edge_domain " << edge_domain << ": " << image(map) << endl;
+  // logging::build_log << "edge_domain " << edge_domain << ": " << image(map) << endl;
 
   return map;
 }
@@ -373,7 +636,7 @@ Set get_node_domain(Node node)
 template<typename S, typename T>
 S get_edge_domain(SetPiece image_intersection_set, T& edge_set, int& max_value)
 {
-  logging::sbg_log << "get_edge_domain " << image_intersection_set << ", " << edge_set << endl;
+  logging::build_log << "get_edge_domain " << image_intersection_set << ", " << edge_set << endl;
   SetPiece edge_domain_set;
   for (size_t i = 0; i < image_intersection_set.size(); i++) {
     // Edge domain will be from the current max value and will have the quantity as the intersection
@@ -411,7 +674,7 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
   EdgeCost costs; // Weight of edges
 
   for (const auto& [id, node] : nodes) {
-    logging::sbg_log << "Looking for connections with " << id << endl;
+    logging::build_log << "Looking for connections with " << id << endl;
 
     // Define the equation intervals (without offsets)
     OrdSet current_node_domain;
@@ -437,12 +700,12 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
       auto rhs_map = CanonMap(current_node_domain, right_exps);
       // This is the image *used* by this expression, wwe want to
       // check where is defined.
-      auto used_node_image = image(CanonMap(current_node_domain, right_exps));
+      auto used_node_image = set_ops::image(CanonMap(current_node_domain, right_exps));
 
       // Definitions of this variable are on defs field. We want to check if
       // intersects with any node
       for (int i : right_var.defs) {
-        logging::sbg_log << "Is it connected to " << i << "?" << endl;
+        logging::build_log << "Is it connected to " << i << "?" << endl;
         auto node_candidate = nodes.at(i);
 
         // Domain of the node candidate
@@ -457,15 +720,15 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
 
           // Now, get the image.
           auto node_candidate_CanonMap = CanonMap(node_candidate_domain, node_candidate_exps);
-          auto node_candidate_image = image(node_candidate_CanonMap);
+          auto node_candidate_image = set_ops::image(node_candidate_CanonMap);
 
           // we want to see if the intersection of the images is not empty
-          auto candidate_image_intersection = intersection(node_candidate_image, used_node_image);
+          auto candidate_image_intersection = set_ops::intersection(node_candidate_image, used_node_image);
           if (isEmpty(candidate_image_intersection)) {
-            logging::sbg_log << "No, it is not" << endl;
+            logging::build_log << "No, it is not" << endl;
             continue;
           }
-          logging::sbg_log << "Yes, it is: " << candidate_image_intersection << endl;
+          logging::build_log << "Yes, it is: " << candidate_image_intersection << endl;
 
           // Now we need to create both maps, let's create their domain.
           auto image_intersection_set = candidate_image_intersection[0];
@@ -476,29 +739,29 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
 #if CHECK_1_N_REL
           // we have to use the first map of candidate node
           if (node_candidate_exps.exps()[0].slope() == 0) {
-            logging::sbg_log << "This should be 1-N " << node_candidate_domain << endl;
+            logging::build_log << "This should be 1-N " << node_candidate_domain << endl;
             auto node_size = node_candidate_domain[0][0].end() - node_candidate_domain[0][0].begin();
             image_intersection_set[0] = Interval(image_intersection_set[0].begin(), 1, image_intersection_set[0].begin() + node_size);
 
             OrdSet edge_domain_set = get_edge_domain<OrdSet>(image_intersection_set, edge_set, max_value);
 
             int offset = node_candidate_domain[0][0].begin() + node_offsets.at(i) - edge_domain_set[0][0].begin();
-            logging::sbg_log << "node offset " << node_offsets.at(i) << ", " << edge_domain_set << " so offset is " << offset << endl;
+            logging::build_log << "node offset " << node_offsets.at(i) << ", " << edge_domain_set << " so offset is " << offset << endl;
             CanonMap to_node_candidate = CanonMap(edge_domain_set, LExp(1, RAT(offset, 1)));
-            logging::sbg_log << "to_node_candidate " << to_node_candidate << endl;
+            logging::build_log << "to_node_candidate " << to_node_candidate << endl;
 
-            logging::sbg_log << to_node_candidate << endl;
+            logging::build_log << to_node_candidate << endl;
 
             auto im = Interval(node_candidate_exps.exps()[0].offset().numerator(), 1, node_candidate_exps.exps()[0].offset().numerator());
             CanonMap to_current_node = create_set_edge_map(OrdSet(im), edge_domain_set, Exp(LExp(0, node_candidate_exps.exps()[0].offset())), node_offsets.at(id));
-            logging::sbg_log << "to_current_node " << to_current_node << endl;
+            logging::build_log << "to_current_node " << to_current_node << endl;
 
             lhs_maps.emplace(to_current_node);
             rhs_maps.emplace(to_node_candidate);
 
             continue;
           } else if (exp.exps()[0].slope() == 0) {
-            logging::sbg_log << "This should be N-1" << endl;
+            logging::build_log << "This should be N-1" << endl;
             auto node_size = current_node_domain[0][0].end() - current_node_domain[0][0].begin();
             image_intersection_set[0] = Interval(image_intersection_set[0].begin(), 1, image_intersection_set[0].begin() + node_size);
 
@@ -506,11 +769,11 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
 
             int offset = current_node_domain[0][0].begin() + node_offsets.at(id) - edge_domain_set[0][0].begin();
             CanonMap to_current_node = CanonMap(edge_domain_set, LExp(1, RAT(offset, 1)));
-            logging::sbg_log << "to_current_node " << to_current_node << endl;
+            logging::build_log << "to_current_node " << to_current_node << endl;
 
             auto im = Interval(exp.exps()[0].offset().numerator(), 1, exp.exps()[0].offset().numerator());
             CanonMap to_node_candidate = create_set_edge_map(OrdSet(im), edge_domain_set, Exp(LExp(0, node_candidate_exps.exps()[0].offset())), node_offsets.at(i));
-            logging::sbg_log << "to_node_candidate " << to_node_candidate << endl;
+            logging::build_log << "to_node_candidate " << to_node_candidate << endl;
 
             lhs_maps.emplace(to_current_node);
             rhs_maps.emplace(to_node_candidate);
@@ -525,20 +788,20 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
 
           // Create map to node candidate
           auto first_lhs_node_candidate = Exp(LExp(RAT(node_candidate.lhs[0].exps[0].first, 1), RAT(node_candidate.lhs[0].exps[0].second, 1)));
-          auto pre_ima_candidate = preImage(node_candidate_CanonMap);
-          logging::sbg_log << "pre_ima_candidate " << pre_ima_candidate << " from " << node_candidate_CanonMap << endl;
+          auto pre_ima_candidate = set_ops::preImage(node_candidate_CanonMap);
+          logging::build_log << "pre_ima_candidate " << pre_ima_candidate << " from " << node_candidate_CanonMap << endl;
           auto node_candidate_map = create_set_edge_map(pre_ima_candidate, edge_domain_set, first_lhs_node_candidate, node_offsets.at(i));
-          auto node_candidate_map_image = image(node_candidate_map);
-          logging::sbg_log << "map is " << node_candidate_map << endl;
-          logging::sbg_log << "image: " << node_candidate_map_image << endl;
+          auto node_candidate_map_image = set_ops::image(node_candidate_map);
+          logging::build_log << "map is " << node_candidate_map << endl;
+          logging::build_log << "image: " << node_candidate_map_image << endl;
 
           // Create map to current node
-          auto pre_image_current_node = preImage(OrdSet(image_intersection_set), rhs_map);
-          auto im = image(CanonMap(OrdSet(pre_image_current_node), exp));
+          auto pre_image_current_node = set_ops::preImage(OrdSet(image_intersection_set), rhs_map);
+          auto im = set_ops::image(CanonMap(OrdSet(pre_image_current_node), exp));
           auto current_node_map = create_set_edge_map(im, edge_domain_set, exp, node_offsets.at(id));
-          auto current_node_map_image = image(current_node_map);
-          logging::sbg_log << "map is " << current_node_map << endl;
-          logging::sbg_log << "image: " << current_node_map_image << endl;
+          auto current_node_map_image = set_ops::image(current_node_map);
+          logging::build_log << "map is " << current_node_map << endl;
+          logging::build_log << "image: " << current_node_map_image << endl;
 
           if (not (current_node_map_image == node_candidate_map_image)) {
               lhs_maps.emplace(current_node_map);
@@ -546,9 +809,9 @@ tuple<OrdSet, CanonPWMap, CanonPWMap, EdgeCost> create_graph_edges(
               edge_set = edge_set_copy;
               max_value = max_value_copy;
           } else {
-            logging::sbg_log << "ignoring it since it's a reflexive conexion" << endl;
+            logging::build_log << "ignoring it since it's a reflexive conexion" << endl;
           }
-          logging::sbg_log << "----" << endl;
+          logging::build_log << "----" << endl;
 
           costs.insert({edge_domain_set, var.cost});
         }
@@ -568,8 +831,8 @@ WeightedSBGraph create_sb_graph(const std::map<int, Node>& nodes)
   map<int, int> node_offsets;
 
   // Now, we create our set of nodes.
-  auto [node_set, weights] = create_set_of_nodes(nodes, node_offsets, max_value);
-  logging::sbg_log << "node_set " << node_set << endl;
+  auto [node_set, weights, constraint_weights] = create_set_of_nodes(nodes, node_offsets, max_value);
+  logging::build_log << "node_set " << node_set << endl;
 
   // Now, let's build a graph!
   WeightedSBGraph graph; // This will be our graph
@@ -583,6 +846,8 @@ WeightedSBGraph create_sb_graph(const std::map<int, Node>& nodes)
   // Now add those edges and maps to the graph
   graph = addSEW(left_maps, right_maps, costs, graph);
 
+  graph.set_constraint_weights(constraint_weights);
+
   return graph;
 }
 
@@ -590,14 +855,14 @@ WeightedSBGraph create_sb_graph(const std::map<int, Node>& nodes)
 template<typename Set>
 unsigned add_adjacent_nodes(const CanonPWMap& incoming_map, const CanonPWMap& arrival_map, const Set& node, OrdSet& adjacents)
 {
-  auto map_image = image(incoming_map);
-  auto node_map_intersection = intersection(map_image, node);
+  auto map_image = set_ops::image(incoming_map);
+  auto node_map_intersection = set_ops::intersection(map_image, node);
 
   unsigned qty = 0;
   if (not isEmpty(node_map_intersection)) {
 
-    auto pre_image = preImage(OrdSet(node_map_intersection), incoming_map);
-    auto adjs = image(pre_image, arrival_map);
+    auto pre_image = set_ops::preImage(OrdSet(node_map_intersection), incoming_map);
+    auto adjs = set_ops::image(pre_image, arrival_map);
     qty += get_node_size(adjs, NodeWeight());
     for_each(adjs.begin(), adjs.end(), [&adjacents](auto& b) { adjacents.emplace(b); });
   }
@@ -637,18 +902,25 @@ Interval get_pre_image(const Interval& image_interval, const LExp& expression)
 }
 
 
-WeightedSBGraph build_sb_graph(const string& filename)
+WeightedSBGraph build_sb_graph(const Document& document, const CostProfile& profile = CostProfile())
 {
-  logging::sbg_log << "Reading " << filename << "..." << endl;
+  trace::Span span("build_sb_graph", "build");
+  set_ops::PhaseScope phase(set_ops::Phase::BUILD);
 
-  // Parse json document
-  Document document;
-  ifstream ifs(filename);
-  IStreamWrapper isw(ifs);
-  document.ParseStream(isw);
+  string error;
+  if (document.HasParseError()) {
+    error = "model is not valid json";
+  }
+  if (not error.empty() or not validate_model(document, error)) {
+    logging::build_log << "Invalid model: " << error << endl;
+    throw invalid_argument(error);
+  }
 
   // Now read the document and convert it into a known type
   auto nodes = create_node_objects_from_json(document);
+  if (not profile.empty()) {
+    apply_cost_profile(nodes, profile);
+  }
 
   // Now, let's get our graph
   auto graph = create_sb_graph(nodes);
@@ -659,6 +931,48 @@ WeightedSBGraph build_sb_graph(const string& filename)
 }
 
 
+WeightedSBGraph build_sb_graph(const string& filename)
+{
+  return build_sb_graph(filename, CostProfile());
+}
+
+
+WeightedSBGraph build_sb_graph(const string& filename, const CostProfile& profile)
+{
+  logging::build_log << "Reading " << filename << "..." << endl;
+
+  // Parse json document
+  Document document;
+  ifstream ifs(filename);
+  IStreamWrapper isw(ifs);
+  document.ParseStream(isw);
+
+  return build_sb_graph(document, profile);
+}
+
+
+bool validate_model(const string& json, string& error)
+{
+  Document document;
+  document.Parse(json.c_str(), json.size());
+  if (document.HasParseError()) {
+    error = "model is not valid json";
+    return false;
+  }
+
+  return validate_model(document, error);
+}
+
+
+WeightedSBGraph build_sb_graph_from_json(const string& json)
+{
+  Document document;
+  document.Parse(json.c_str(), json.size());
+
+  return build_sb_graph(document);
+}
+
+
 OrdSet get_adjacents(const CanonSBG& graph, const OrdSet& node)
 {
   OrdSet adjacents = {};
@@ -681,7 +995,7 @@ OrdSet get_adjacents(const CanonSBG& graph, const SetPiece& node)
 
       acc += add_adjacent_nodes(map1, map2, node, adjacents);
 
-      auto map2_minus_map1_dom = difference(map2.dom(), map1.dom());
+      auto map2_minus_map1_dom = set_ops::difference(map2.dom(), map1.dom());
       if (not isEmpty(map2_minus_map1_dom)){
         CanonMap map2_ = CanonMap(map2_minus_map1_dom, map2.exp());
 
@@ -695,7 +1009,7 @@ OrdSet get_adjacents(const CanonSBG& graph, const SetPiece& node)
 
 pair<OrdSet, OrdSet> cut_bidimensional_interval(const SetPiece &set_piece, size_t s)
 {
-    logging::sbg_log << "cutting interval " << set_piece << ", " << s << endl;
+    logging::build_log << "cutting interval " << set_piece << ", " << s << endl;
 
     auto size_node_2 = get_node_size(SetPiece(set_piece.intervals()[1]), NodeWeight());
 
@@ -703,7 +1017,7 @@ pair<OrdSet, OrdSet> cut_bidimensional_interval(const SetPiece &set_piece, size_
 
     unsigned rest = s % size_node_2;
 
-    logging::sbg_log << "Ammount of rows " << ammount_of_rows << endl;
+    logging::build_log << "Ammount of rows " << ammount_of_rows << endl;
 
     OrdSet OrdSet_ret;
     SetPiece interval_2 = *set_piece.intervals().begin();
@@ -711,7 +1025,7 @@ pair<OrdSet, OrdSet> cut_bidimensional_interval(const SetPiece &set_piece, size_
     if (ammount_of_rows > 0) {
         SetPiece interval_1;
         tie(interval_1, interval_2) = cut_interval(set_piece.intervals().front(), set_piece.intervals().front().begin() + ammount_of_rows - 1);
-        logging::sbg_log << "Interval cut in " << ammount_of_rows << ": " << interval_1 << ", " << interval_2 << endl;
+        logging::build_log << "Interval cut in " << ammount_of_rows << ": " << interval_1 << ", " << interval_2 << endl;
         if (interval_2.size() == 0 and rest > 0) {
             interval_2 = Interval(interval_1.intervals().front().end(), 1, interval_1.intervals().front().end());
         }
@@ -729,9 +1043,9 @@ pair<OrdSet, OrdSet> cut_bidimensional_interval(const SetPiece &set_piece, size_
         OrdSet_ret.emplace(rest_set_piece);
     }
 
-    OrdSet remaining = difference(OrdSet(set_piece), OrdSet_ret);
+    OrdSet remaining = set_ops::difference(OrdSet(set_piece), OrdSet_ret);
 
-    logging::sbg_log << "original " << OrdSet(set_piece) << ", " << OrdSet_ret << ", " << remaining << endl;
+    logging::build_log << "original " << OrdSet(set_piece) << ", " << OrdSet_ret << ", " << remaining << endl;
 
     return make_pair(OrdSet_ret, remaining);
 }
@@ -763,8 +1077,8 @@ pair<OrdSet, OrdSet> cut_interval_by_dimension(OrdSet& set_piece, const NodeWeig
           size_t size_to_cut = min(pice_size, actual_size);
           OrdSet cut_node_piece, remaining_node_piece;
           tie(cut_node_piece, remaining_node_piece) = cut_bidimensional_interval(piece, size_to_cut);
-          cut_node = cup(cut_node, cut_node_piece);
-          remaining_node = difference(remaining_node, cut_node);
+          cut_node = set_ops::cup(cut_node, cut_node_piece);
+          remaining_node = set_ops::difference(remaining_node, cut_node);
 
           if (remaining_node.pieces().empty()) {
             return make_pair(cut_node, remaining_node);
@@ -774,12 +1088,40 @@ pair<OrdSet, OrdSet> cut_interval_by_dimension(OrdSet& set_piece, const NodeWeig
         return make_pair(cut_node, remaining_node);
     }
 
-    logging::sbg_log << "Unexpected dimension: " << set_piece.pieces().begin()->intervals().size() << endl;
+    logging::build_log << "Unexpected dimension: " << set_piece.pieces().begin()->intervals().size() << endl;
 
     throw 1;
 }
 
 
+OrdSet take_weight(const OrdSet& candidates, const NodeWeight& node_weights, unsigned weight)
+{
+    OrdSet taken;
+    for (const SetPiece& set_piece : candidates.pieces()) {
+        if (weight == 0) {
+            break;
+        }
+
+        unsigned piece_weight = get_node_size(set_piece, node_weights);
+        if (piece_weight <= weight) {
+            taken = set_ops::cup(taken, OrdSet(set_piece));
+            weight -= piece_weight;
+            continue;
+        }
+
+        OrdSet piece(set_piece);
+        unsigned element_weight = get_set_cost(set_piece, node_weights);
+        if (weight >= element_weight) {
+            auto [cut, rest] = cut_interval_by_dimension(piece, node_weights, weight);
+            taken = set_ops::cup(taken, cut);
+        }
+        break;
+    }
+
+    return taken;
+}
+
+
 unsigned get_node_size(const SetPiece& node, const NodeWeight& node_weight)
 {
     if (node.size() == 0) {
@@ -855,7 +1197,7 @@ unsigned get_edge_set_cost(const SBG::LIB::OrdSet& node, const EdgeCost& edge_co
 void flatten_set(OrdSet &set, const CanonSBG& graph)
 {
     if (set.pieces().size() > 0 and set.pieces().begin()->intervals().size() > 1) {
-        logging::sbg_log << "flatten_set for sets with "
+        logging::build_log << "flatten_set for sets with "
              << set.pieces().size()
              << " is not implemented"
              << endl;
@@ -867,16 +1209,16 @@ void flatten_set(OrdSet &set, const CanonSBG& graph)
         MDInterOrdSet set_piece_this_node_vector;
         for (auto& set_piece : set.pieces()) {
 
-            if (not isEmpty(intersection(v, set_piece))) {
+            if (not isEmpty(set_ops::intersection(v, set_piece))) {
                 set_piece_this_node_vector.emplace(set_piece);
             }
         }
 
-        set_piece_this_node_vector = canonize(set_piece_this_node_vector);
-        new_partition = cup(new_partition, set_piece_this_node_vector);
+        set_piece_this_node_vector = set_ops::canonize(set_piece_this_node_vector);
+        new_partition = set_ops::cup(new_partition, set_piece_this_node_vector);
     }
 
-    auto diff = difference(set, new_partition);
+    auto diff = set_ops::difference(set, new_partition);
     assert(isEmpty(diff));
 
     set = new_partition;
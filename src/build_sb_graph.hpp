@@ -21,6 +21,7 @@
 
 #include <sbg/sbg.hpp>
 
+#include "cost_profile.hpp"
 #include "weighted_sb_graph.hpp"
 
 namespace sbg_partitioner {
@@ -30,9 +31,26 @@ namespace sbg_partitioner {
 /// a node for each access to a variable and an edge for each connection
 /// between variables.
 /// If a variable appears on the left and on the right side, an edge is created.
+/// Throws std::invalid_argument if the model is not valid (see validate_model).
 WeightedSBGraph build_sb_graph(const std::string& filename);
 
 
+/// Same as above, but node weights are measured costs taken from profile instead of the
+/// weight field of the model, scaled as cost_profile.hpp describes. Nodes with ranges of
+/// different cost are split into a set piece for each range.
+WeightedSBGraph build_sb_graph(const std::string& filename, const CostProfile& profile);
+
+
+/// Same as build_sb_graph, but the model is given as a json string instead of a path.
+WeightedSBGraph build_sb_graph_from_json(const std::string& json);
+
+
+/// Checks that json is a model that build_sb_graph can take: node ids are unique, and
+/// intervals, weights, expressions and definitions have the expected types and sizes.
+/// Returns false, with the reason in error, otherwise.
+bool validate_model(const std::string& json, std::string& error);
+
+
 /// Ad hoc function to get pre image of an expression from its image.
 /// @param image_interval  Image we want to get the pre image from
 /// @param expression  Expression to get the pre image
@@ -94,4 +112,15 @@ T get_set_cost(const SBG::LIB::SetPiece& set, const std::map<SBG::LIB::OrdSet, T
 
 
 std::pair<SBG::LIB::OrdSet, SBG::LIB::OrdSet> cut_interval_by_dimension(SBG::LIB::OrdSet& set_piece, const NodeWeight& node_weight, size_t size);
+
+
+/// Cuts a two dimensional set piece after its first s elements, whole rows of the second
+/// dimension first. Returns the cut and the rest.
+std::pair<SBG::LIB::OrdSet, SBG::LIB::OrdSet> cut_bidimensional_interval(const SBG::LIB::SetPiece& set_piece, size_t s);
+
+
+/// Takes up to weight from candidates, whole set pieces first and then a cut of the
+/// last one, and returns it.
+SBG::LIB::OrdSet take_weight(const SBG::LIB::OrdSet& candidates, const NodeWeight& node_weights, unsigned weight);
+
 }
\ No newline at end of file
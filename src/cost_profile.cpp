@@ -0,0 +1,145 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <sstream>
+
+#include "cost_profile.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+bool ends_with(const string& str, const string& suffix)
+{
+    return str.size() >= suffix.size() and str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+bool read_json_cost_profile(const string& filename, CostProfile& profile)
+{
+    ifstream ifs(filename);
+    if (not ifs) {
+        cerr << "Unable to open " << filename << endl;
+        return false;
+    }
+
+    rapidjson::IStreamWrapper isw(ifs);
+    rapidjson::Document document;
+    document.ParseStream(isw);
+    if (document.HasParseError() or not document.IsObject() or not document.HasMember("costs") or not document["costs"].IsArray()) {
+        cerr << filename << " has no costs array" << endl;
+        return false;
+    }
+
+    for (const auto& cost : document["costs"].GetArray()) {
+        if (not cost.IsObject() or not cost.HasMember("id") or not cost["id"].IsInt()
+            or not cost.HasMember("cost") or not cost["cost"].IsNumber()) {
+            cerr << filename << " has a cost without id or cost" << endl;
+            return false;
+        }
+
+        CostMeasure measure{cost["id"].GetInt(), numeric_limits<int>::min(), numeric_limits<int>::max(), cost["cost"].GetDouble()};
+        if (cost.HasMember("interval")) {
+            const auto& interval = cost["interval"];
+            if (not interval.IsArray() or interval.Size() != 2 or not interval[0].IsInt() or not interval[1].IsInt()) {
+                cerr << filename << " has a wrong interval for node " << measure.id << endl;
+                return false;
+            }
+            measure.begin = interval[0].GetInt();
+            measure.end = interval[1].GetInt();
+        }
+
+        profile.push_back(measure);
+    }
+
+    return true;
+}
+
+
+bool read_csv_cost_profile(const string& filename, CostProfile& profile)
+{
+    ifstream ifs(filename);
+    if (not ifs) {
+        cerr << "Unable to open " << filename << endl;
+        return false;
+    }
+
+    string line;
+    for (size_t line_number = 1; getline(ifs, line); line_number++) {
+        if (line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+
+        for (char& c : line) {
+            if (c == ',') {
+                c = ' ';
+            }
+        }
+
+        CostMeasure measure;
+        istringstream fields(line);
+        if (not (fields >> measure.id >> measure.begin >> measure.end >> measure.cost)) {
+            // the header
+            if (line_number == 1) {
+                continue;
+            }
+
+            cerr << filename << ":" << line_number << " should be id,begin,end,cost" << endl;
+            return false;
+        }
+
+        profile.push_back(measure);
+    }
+
+    return true;
+}
+
+}
+
+
+bool read_cost_profile(const string& filename, CostProfile& profile)
+{
+    profile.clear();
+
+    bool ok = ends_with(filename, ".json") ? read_json_cost_profile(filename, profile) : read_csv_cost_profile(filename, profile);
+    if (not ok) {
+        return false;
+    }
+
+    for (const auto& measure : profile) {
+        if (measure.begin > measure.end or measure.cost < 0) {
+            cerr << filename << " has a wrong measure for node " << measure.id << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
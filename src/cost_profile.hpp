@@ -0,0 +1,54 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+namespace sbg_partitioner {
+
+/// Measured cost of the elements [begin, end] of node id, e.g. the CPU time per step of an
+/// equation in a QSS run. Indexes are those of the first dimension of the node in the
+/// model, and the cost is the total cost of the range, not of each element.
+struct CostMeasure {
+    int id;
+    int begin;
+    int end;
+    double cost;
+};
+
+
+using CostProfile = std::vector<CostMeasure>;
+
+
+/// Weight of an element with the mean measured cost. Node weights are integers, so the
+/// measured costs are scaled relative to the mean cost per element.
+constexpr int profile_mean_weight = 100;
+
+
+/// Reads a cost profile from filename. If it ends with .json, it must be
+/// {"costs": [{"id": 1, "interval": [1, 100], "cost": 12.5}, ...]}, where interval can be
+/// omitted to measure the whole node. Otherwise it is a csv file with id,begin,end,cost
+/// lines, and an optional header line.
+/// Returns false, printing why, if it can not be read.
+bool read_cost_profile(const std::string& filename, CostProfile& profile);
+
+}
@@ -0,0 +1,269 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <thread>
+
+#include "build_sb_graph.hpp"
+#include "csr_graph.hpp"
+#include "element_index.hpp"
+#include "sbg_partitioner_log.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+using namespace SBG::Util;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+// Edges each task expands, it is only a hint since set pieces are split by their first dimension.
+constexpr size_t edges_per_task = 1 << 14;
+
+/// Part of the domain of a pair of maps, the rows [first, last] of a domain set piece.
+struct EdgeTask {
+    size_t map;
+    SetPiece set_piece;
+    INT first;
+    INT last;
+    unsigned cost;
+};
+
+
+INT evaluate(const LExp& exp, INT x)
+{
+    const RAT& slope = exp.slope();
+    const RAT& offset = exp.offset();
+
+    return (slope.numerator() * x * offset.denominator() + offset.numerator() * slope.denominator())
+        / (slope.denominator() * offset.denominator());
+}
+
+
+/// Calls f(u, v, cost) for each edge of task, where u and v are the indexes of its ends.
+template<typename F>
+void for_each_edge(const EdgeTask& task, const vector<CanonMap>& maps_1, const vector<CanonMap>& maps_2, const ElementIndex& index, F f)
+{
+    const auto& intervals = task.set_piece.intervals();
+    const auto& exps_1 = maps_1[task.map].exp().exps();
+    const auto& exps_2 = maps_2[task.map].exp().exps();
+
+    vector<INT> edge(intervals.size());
+    vector<INT> u(exps_1.size()), v(exps_2.size());
+    for (size_t d = 0; d < intervals.size(); d++) {
+        edge[d] = intervals[d].begin();
+    }
+    edge[0] = task.first;
+
+    while (true) {
+        for (size_t d = 0; d < u.size(); d++) {
+            u[d] = evaluate(exps_1[d], edge[d]);
+        }
+        for (size_t d = 0; d < v.size(); d++) {
+            v[d] = evaluate(exps_2[d], edge[d]);
+        }
+
+        size_t node_u = index.find_node(u[0]);
+        size_t node_v = index.find_node(v[0]);
+        if (node_u != ElementIndex::npos and node_v != ElementIndex::npos) {
+            f(index.index(node_u, u), index.index(node_v, v), task.cost);
+        }
+
+        // next edge, in row-major order
+        size_t d = intervals.size();
+        while (d > 0) {
+            d--;
+            edge[d] += intervals[d].step();
+            if (edge[d] <= (d == 0 ? task.last : intervals[d].end())) {
+                break;
+            }
+            edge[d] = intervals[d].begin();
+            if (d == 0) {
+                return;
+            }
+        }
+    }
+}
+
+
+vector<EdgeTask> get_edge_tasks(const WeightedSBGraph& graph, const vector<CanonMap>& maps_1)
+{
+    const auto edge_costs = graph.get_edge_costs();
+
+    vector<EdgeTask> tasks;
+    for (size_t i = 0; i < maps_1.size(); i++) {
+        for (const auto& set_piece : maps_1[i].dom().pieces()) {
+            if (set_piece.intervals().empty()) {
+                continue;
+            }
+
+            const Interval& first = set_piece.intervals()[0];
+            const INT rows = (first.end() - first.begin()) / first.step() + 1;
+            const INT row_size = max(INT(cardinality(set_piece) / rows), INT(1));
+            const INT rows_per_task = max(INT(edges_per_task) / row_size, INT(1));
+            const unsigned cost = get_set_cost(set_piece, edge_costs);
+
+            for (INT row = 0; row < rows; row += rows_per_task) {
+                INT task_first = first.begin() + row * first.step();
+                INT task_last = first.begin() + (min(row + rows_per_task, rows) - 1) * first.step();
+                tasks.push_back(EdgeTask{i, set_piece, task_first, task_last, cost});
+            }
+        }
+    }
+
+    return tasks;
+}
+
+
+/// Runs f(task) for every task using threads workers.
+template<typename F>
+void run_tasks(const vector<EdgeTask>& tasks, unsigned threads, F f)
+{
+    atomic<size_t> next(0);
+    auto worker = [&tasks, &next, &f]() {
+        for (size_t t = next++; t < tasks.size(); t = next++) {
+            f(tasks[t]);
+        }
+    };
+
+    vector<future<void>> futures;
+    for (unsigned t = 1; t < threads; t++) {
+        futures.push_back(async(launch::async, worker));
+    }
+
+    worker();
+
+    for (auto& future : futures) {
+        future.get();
+    }
+}
+
+}
+
+
+template<typename Index>
+CSRGraph<Index> build_csr_graph(const WeightedSBGraph& graph, unsigned threads)
+{
+    ElementIndex index(graph.V());
+
+    vector<CanonMap> maps_1(graph.map1().maps().begin(), graph.map1().maps().end());
+    vector<CanonMap> maps_2(graph.map2().maps().begin(), graph.map2().maps().end());
+
+    auto tasks = get_edge_tasks(graph, maps_1);
+
+    if (threads == 0) {
+        threads = max(thread::hardware_concurrency(), 1u);
+    }
+    threads = unsigned(min(size_t(threads), max(tasks.size(), size_t(1))));
+
+    logging::sbg_log << "building csr graph of " << index.size() << " vertices from " << tasks.size()
+                     << " tasks with " << threads << " threads" << endl;
+
+    CSRGraph<Index> csr;
+    const size_t n = index.size();
+
+    // vertex weights
+    const auto node_weights = graph.get_node_weights();
+    csr.vwgt.resize(n);
+    for (size_t i = 0; i < index.number_of_nodes(); i++) {
+        const auto& node = index.node(i);
+        fill_n(csr.vwgt.begin() + node.offset, node.size, Index(get_set_cost(node.set_piece, node_weights)));
+    }
+
+    // count degrees, each edge is counted in both of its ends
+    vector<atomic<Index>> degree(n);
+    for (auto& d : degree) {
+        d.store(0, memory_order_relaxed);
+    }
+    run_tasks(tasks, threads, [&](const EdgeTask& task) {
+        for_each_edge(task, maps_1, maps_2, index, [&degree](size_t u, size_t v, unsigned) {
+            if (u != v) {
+                degree[u].fetch_add(1, memory_order_relaxed);
+                degree[v].fetch_add(1, memory_order_relaxed);
+            }
+        });
+    });
+
+    csr.xadj.resize(n + 1);
+    csr.xadj[0] = 0;
+    for (size_t v = 0; v < n; v++) {
+        csr.xadj[v + 1] = csr.xadj[v] + degree[v].load(memory_order_relaxed);
+        degree[v].store(csr.xadj[v], memory_order_relaxed);
+    }
+
+    // fill adjacencies, degree is now the next free position of each vertex
+    csr.adjncy.resize(csr.xadj[n]);
+    csr.ewgt.resize(csr.xadj[n]);
+    run_tasks(tasks, threads, [&](const EdgeTask& task) {
+        for_each_edge(task, maps_1, maps_2, index, [&degree, &csr](size_t u, size_t v, unsigned cost) {
+            if (u != v) {
+                Index pos_u = degree[u].fetch_add(1, memory_order_relaxed);
+                csr.adjncy[pos_u] = v;
+                csr.ewgt[pos_u] = cost;
+
+                Index pos_v = degree[v].fetch_add(1, memory_order_relaxed);
+                csr.adjncy[pos_v] = u;
+                csr.ewgt[pos_v] = cost;
+            }
+        });
+    });
+
+    // sort each adjacency and merge parallel edges, compacting the arrays in place
+    Index last = 0;
+    vector<pair<Index, Index>> adjacency;
+    for (size_t v = 0; v < n; v++) {
+        adjacency.clear();
+        for (Index e = csr.xadj[v]; e < csr.xadj[v + 1]; e++) {
+            adjacency.emplace_back(csr.adjncy[e], csr.ewgt[e]);
+        }
+        sort(adjacency.begin(), adjacency.end());
+
+        csr.xadj[v] = last;
+        for (const auto& [u, cost] : adjacency) {
+            if (last > csr.xadj[v] and csr.adjncy[last - 1] == u) {
+                csr.ewgt[last - 1] += cost;
+            } else {
+                csr.adjncy[last] = u;
+                csr.ewgt[last] = cost;
+                last++;
+            }
+        }
+    }
+    csr.xadj[n] = last;
+    csr.adjncy.resize(last);
+    csr.ewgt.resize(last);
+
+    logging::sbg_log << "csr graph has " << n << " vertices and " << last << " arcs" << endl;
+
+    return csr;
+}
+
+
+template CSRGraph<int32_t> build_csr_graph<int32_t>(const WeightedSBGraph&, unsigned);
+template CSRGraph<int64_t> build_csr_graph<int64_t>(const WeightedSBGraph&, unsigned);
+
+}
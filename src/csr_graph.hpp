@@ -0,0 +1,55 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <vector>
+
+#include "weighted_sb_graph.hpp"
+
+
+namespace sbg_partitioner {
+
+/// Flattened graph in compressed sparse row format, as Metis, Scotch, KaHIP and
+/// PaToH expect it. Vertices are the elements of the sb graph nodes, numbered as
+/// ElementIndex does, and each edge of the sb graph appears in the adjacency of both
+/// of its ends. Parallel edges are merged adding their costs, and self loops are dropped.
+template<typename Index>
+struct CSRGraph {
+    std::vector<Index> xadj;    // adjacency of vertex v is adjncy[xadj[v]:xadj[v + 1]]
+    std::vector<Index> adjncy;
+    std::vector<Index> vwgt;    // weight of each vertex
+    std::vector<Index> ewgt;    // cost of each adjncy entry
+
+    Index number_of_vertices() const { return xadj.empty() ? 0 : xadj.size() - 1; }
+
+    /// Number of adjncy entries, twice the number of edges.
+    Index number_of_arcs() const { return adjncy.size(); }
+};
+
+
+/// Expands graph into a CSR graph. Map pieces are evaluated element by element, in
+/// parallel, counting the degree of each vertex first so the adjacency is written in
+/// place and no edge list is built. If threads is 0, all the hardware threads are used.
+/// Instantiated for int32_t and int64_t.
+template<typename Index>
+CSRGraph<Index> build_csr_graph(const WeightedSBGraph& graph, unsigned threads = 0);
+
+}
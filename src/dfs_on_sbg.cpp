@@ -21,6 +21,8 @@
 
 #include "dfs_on_sbg.hpp"
 #include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+#include "trace.hpp"
 #include "weighted_sb_graph.hpp"
 
 using namespace std;
@@ -33,103 +35,68 @@ namespace sbg_partitioner {
 
 namespace search {
 
-static bool initialized = false;
-static DFS sort_object;
-
-void initialize_partitioning(
-    WeightedSBGraph& graph,
-    unsigned number_of_partitions)
-{
-    initialized = true;
-    sort_object = DFS(graph, number_of_partitions);
-}
-
-
-void add_strategy(PartitionStrategy& strategy, bool pre_order)
-{
-    sort_object.add_partition_strategy(strategy, pre_order);
-}
-
-
-vector<map<unsigned, set<SetPiece>>> partitionate()
-{
-    assert(initialized and "Partioning was not inialized");
-
-    sort_object.start();
-    sort_object.iterate();
-    vector<map<unsigned, set<SetPiece>>> partitions = sort_object.partitions();
-
-    return partitions;
-}
-
-
-DFS::DFS(WeightedSBGraph & graph, unsigned number_of_partitions)
-    : _number_of_partitions(number_of_partitions),
-    _graph(graph)
+shared_ptr<const Adjacency> make_adjacency(const WeightedSBGraph& graph)
 {
-    initialize_adjacents();
-}
+    trace::Span span("dfs_adjacency", "initial partition");
+    set_ops::PhaseScope phase(set_ops::Phase::DFS);
 
+    auto adjacency = make_shared<Adjacency>();
+    auto& adjacent = adjacency->adjacent;
 
-void DFS::initialize_adjacents()
-{
     // Fill adjacents
-    for (node_identifier i = 0; i < _graph.V().size(); i++) {
-        const auto incoming_node = _graph.V()[i];
+    for (size_t i = 0; i < graph.V().size(); i++) {
+        const auto incoming_node = graph.V()[i];
 
-        auto pre_im_1 = preImage(OrdSet(incoming_node), _graph.map1());
-        auto im_1 = image(pre_im_1, _graph.map2());
-        auto adjacent_nodes_1 = difference(im_1, incoming_node);
+        auto pre_im_1 = set_ops::preImage(OrdSet(incoming_node), graph.map1());
+        auto im_1 = set_ops::image(pre_im_1, graph.map2());
+        auto adjacent_nodes_1 = set_ops::difference(im_1, incoming_node);
 
-        auto pre_im_2 = preImage(OrdSet(incoming_node), _graph.map2());
-        auto im_2 = image(pre_im_2, _graph.map1());
-        auto adjacent_nodes_2 = difference(im_2, incoming_node);
+        auto pre_im_2 = set_ops::preImage(OrdSet(incoming_node), graph.map2());
+        auto im_2 = set_ops::image(pre_im_2, graph.map1());
+        auto adjacent_nodes_2 = set_ops::difference(im_2, incoming_node);
 
-        auto adjacent_nodes = cup(adjacent_nodes_1, adjacent_nodes_2);
+        auto adjacent_nodes = set_ops::cup(adjacent_nodes_1, adjacent_nodes_2);
 
-        for (node_identifier node_idx = 0; node_idx < _graph.V().size(); node_idx++) {
+        for (size_t node_idx = 0; node_idx < graph.V().size(); node_idx++) {
             if (node_idx == i) {
                 continue;
             }
 
-            const auto potential_arriving_node = _graph.V()[node_idx];
-            if (intersection(potential_arriving_node, adjacent_nodes) == potential_arriving_node) {
-                _adjacent[i].insert(node_idx);
+            const auto potential_arriving_node = graph.V()[node_idx];
+            if (set_ops::intersection(potential_arriving_node, adjacent_nodes) == potential_arriving_node) {
+                adjacent[i].insert(node_idx);
             }
         }
     }
 
     // Choosing root node
-    _root_node_idx = 0;
-    node_identifier current_max_adj_values = _adjacent[_root_node_idx].size();
-    for (node_identifier i = 1; i < _graph.V().size(); i++) {
-        if (_adjacent[i].size() > current_max_adj_values) {
-            _root_node_idx = i;
-            current_max_adj_values = _adjacent[_root_node_idx].size();
+    size_t& root_node_idx = adjacency->root_node_idx;
+    root_node_idx = 0;
+    size_t current_max_adj_values = adjacent[root_node_idx].size();
+    for (size_t i = 1; i < graph.V().size(); i++) {
+        if (adjacent[i].size() > current_max_adj_values) {
+            root_node_idx = i;
+            current_max_adj_values = adjacent[root_node_idx].size();
         }
     }
 
-    logging::sbg_log << "Root node is " << _root_node_idx << endl;
+    logging::dfs_log << "Root node is " << root_node_idx << endl;
+
+    return adjacency;
 }
 
 
-void DFS::add_adjacent_nodes(const node_identifier id, const CanonPWMap& map, const OrdSet& edge)
+DFS::DFS(const WeightedSBGraph& graph, unsigned number_of_partitions)
+    : DFS(graph, number_of_partitions, make_adjacency(graph))
 {
-    const auto edge_map_intersection = intersection(edge, dom(map));
-    if (not isEmpty(edge_map_intersection)) {
-        const auto map_image = image(edge_map_intersection, map);
+}
 
-        for (node_identifier node_idx = 0; node_idx < _graph.V().size(); node_idx++) {
-            if (node_idx == id) {
-                continue;
-            }
 
-            const auto potential_arriving_node = _graph.V()[node_idx];
-            if (intersection(potential_arriving_node, map_image) == potential_arriving_node) {
-                _adjacent[id].insert(node_idx);
-            }
-        }
-    }
+DFS::DFS(const WeightedSBGraph& graph, unsigned number_of_partitions, shared_ptr<const Adjacency> adjacency)
+    : _number_of_partitions(number_of_partitions),
+    _adjacency(move(adjacency)),
+    _graph(graph)
+{
 }
 
 
@@ -141,7 +108,7 @@ void DFS::start()
     _stack.clear();
 
     // let's start with the root node
-    add_it_partially(_root_node_idx);
+    add_it_partially(_adjacency->root_node_idx);
     fill_current_node_stack();
 }
 
@@ -191,7 +158,12 @@ void DFS::add_partition_strategy(PartitionStrategy& strategy, bool pre_order)
 void DFS::fill_current_node_stack()
 {
     node_identifier id = _partially_visited.back();
-    for (const node_identifier adj_node : _adjacent[id]) {
+    auto adjacent = _adjacency->adjacent.find(id);
+    if (adjacent == _adjacency->adjacent.end()) {
+        return;
+    }
+
+    for (const node_identifier adj_node : adjacent->second) {
         if (not was_partially_visited(adj_node) and not was_visited(adj_node)
             and not already_added(adj_node)) {
             _stack.push_back(adj_node);
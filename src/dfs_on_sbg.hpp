@@ -35,11 +35,16 @@ namespace sbg_partitioner {
 
 namespace search {
 
-void initialize_partitioning(WeightedSBGraph& graph, unsigned number_of_partitions);
+/// Set pieces of V adjacent to each set piece of V, and the one the search starts from.
+/// It only depends on the graph, so searches with different numbers of partitions can share it.
+struct Adjacency {
+    std::map<size_t, std::set<size_t>> adjacent;
+    size_t root_node_idx = 0;
+};
+
 
-void add_strategy(PartitionStrategy& strategy, bool pre_order);
+std::shared_ptr<const Adjacency> make_adjacency(const WeightedSBGraph& graph);
 
-std::vector<std::map<unsigned, std::set<SBG::LIB::SetPiece>>> partitionate();
 
 class DFS {
 
@@ -48,7 +53,10 @@ public:
 
     /// pre_order: True means pre-order, False means post-order. In-order is not taken
     /// into account since the graph is not a binary tree.
-    DFS(WeightedSBGraph& graph, unsigned number_of_partitions);
+    DFS(const WeightedSBGraph& graph, unsigned number_of_partitions);
+
+    /// Same as above, but the adjacency is not computed again.
+    DFS(const WeightedSBGraph& graph, unsigned number_of_partitions, std::shared_ptr<const Adjacency> adjacency);
 
     DFS& operator= (const DFS&) = delete;   //deleted copy-assignment operator
     DFS(DFS&&) = default;
@@ -72,23 +80,17 @@ private:
 
     std::vector<node_identifier> _visited;
     std::vector<node_identifier> _partially_visited;
-    std::map<node_identifier, std::set<node_identifier> > _adjacent;
+    std::shared_ptr<const Adjacency> _adjacency;
 
     std::vector<node_identifier> _stack;
 
-    size_t _root_node_idx;
-
     WeightedSBGraph _graph;
 
     std::vector<PartitionStrategy*> _partition_strategy_pre_order;
     std::vector<PartitionStrategy*> _partition_strategy_post_order;
 
-    void initialize_adjacents();
-
     void fill_current_node_stack();
 
-    void add_adjacent_nodes(const node_identifier id, const SBG::LIB::CanonPWMap& map, const SBG::LIB::OrdSet& edge);
-
     bool was_visited(node_identifier id);
     bool was_partially_visited(node_identifier id);
     bool already_added(node_identifier id);
@@ -0,0 +1,124 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include "element_index.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+
+
+namespace sbg_partitioner {
+
+size_t cardinality(const SetPiece& set_piece)
+{
+    if (set_piece.intervals().empty()) {
+        return 0;
+    }
+
+    size_t acc = 1;
+    for (const auto& interval : set_piece.intervals()) {
+        acc *= (interval.end() - interval.begin()) / interval.step() + 1;
+    }
+
+    return acc;
+}
+
+
+size_t cardinality(const OrdSet& set)
+{
+    size_t acc = 0;
+    for (const auto& set_piece : set.pieces()) {
+        acc += cardinality(set_piece);
+    }
+
+    return acc;
+}
+
+
+ElementIndex::ElementIndex(const OrdSet& nodes)
+    : _size(0)
+{
+    _nodes.reserve(nodes.size());
+    for (const auto& set_piece : nodes) {
+        _nodes.push_back(Node{set_piece, 0, cardinality(set_piece), vector<size_t>(set_piece.intervals().size(), 1)});
+    }
+
+    sort(_nodes.begin(), _nodes.end(), [](const Node& a, const Node& b) {
+        return a.set_piece.intervals()[0].begin() < b.set_piece.intervals()[0].begin();
+    });
+
+    for (auto& n : _nodes) {
+        const auto& intervals = n.set_piece.intervals();
+        for (size_t d = intervals.size(); d-- > 1;) {
+            n.strides[d - 1] = n.strides[d] * (intervals[d].end() - intervals[d].begin() + 1);
+        }
+
+        n.offset = _size;
+        _size += n.size;
+    }
+}
+
+
+size_t ElementIndex::find_node(const SetPiece& set_piece) const
+{
+    if (set_piece.intervals().empty()) {
+        return npos;
+    }
+
+    return find_node(set_piece.intervals()[0].begin());
+}
+
+
+size_t ElementIndex::find_node(SBG::Util::INT value) const
+{
+    auto it = upper_bound(_nodes.begin(), _nodes.end(), value, [](auto v, const Node& n) {
+        return v < n.set_piece.intervals()[0].begin();
+    });
+
+    if (it == _nodes.begin()) {
+        return npos;
+    }
+
+    it--;
+    if (value > it->set_piece.intervals()[0].end()) {
+        return npos;
+    }
+
+    return distance(_nodes.begin(), it);
+}
+
+
+size_t ElementIndex::index(size_t node, const vector<SBG::Util::INT>& element) const
+{
+    const Node& n = _nodes[node];
+    const auto& intervals = n.set_piece.intervals();
+
+    size_t idx = n.offset;
+    for (size_t d = 0; d < intervals.size(); d++) {
+        idx += (element[d] - intervals[d].begin()) * n.strides[d];
+    }
+
+    return idx;
+}
+
+}
@@ -0,0 +1,162 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include <sbg/sbg.hpp>
+
+
+namespace sbg_partitioner {
+
+/// Number of elements of a set piece, the product of the number of elements of its intervals.
+size_t cardinality(const SBG::LIB::SetPiece& set_piece);
+
+
+/// Number of elements of a set, the sum of the cardinality of its pieces.
+size_t cardinality(const SBG::LIB::OrdSet& set);
+
+
+/// Numbers each element of a set of nodes with a dense index in [0, size()), so
+/// flattened representations (owner vectors, CSR graphs, partitions of classic
+/// partitioners) can be built without set operations.
+/// Nodes are sorted by their first interval, and elements of multidimensional nodes
+/// are numbered in row-major order. Since sb graph nodes are numbered from 0 without
+/// gaps, the index of an element of a one-dimensional graph is its value.
+class ElementIndex
+{
+public:
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    struct Node {
+        SBG::LIB::SetPiece set_piece;
+        size_t offset;  // index of its first element
+        size_t size;    // number of elements
+        std::vector<size_t> strides;
+    };
+
+    explicit ElementIndex(const SBG::LIB::OrdSet& nodes);
+
+    /// Total number of elements
+    size_t size() const { return _size; }
+
+    size_t number_of_nodes() const { return _nodes.size(); }
+
+    const Node& node(size_t i) const { return _nodes[i]; }
+
+    /// Returns the position of the node that contains set_piece, npos if there is none.
+    /// Only the first interval is checked, since nodes don't overlap in it.
+    size_t find_node(const SBG::LIB::SetPiece& set_piece) const;
+
+    /// Returns the position of the node whose first interval contains value, npos if there is none.
+    size_t find_node(SBG::Util::INT value) const;
+
+    /// Returns the index of an element given its value in each dimension.
+    size_t index(size_t node, const std::vector<SBG::Util::INT>& element) const;
+
+    /// Calls f(first, last) for each range of consecutive indexes that set_piece covers,
+    /// both ends included. Adjacent ranges are merged, so a set piece that takes whole
+    /// rows of a node produces a single range.
+    template<typename F>
+    void for_each_range(const SBG::LIB::SetPiece& set_piece, F f) const;
+
+private:
+    std::vector<Node> _nodes;
+    size_t _size;
+};
+
+
+template<typename F>
+void ElementIndex::for_each_range(const SBG::LIB::SetPiece& set_piece, F f) const
+{
+    size_t node_idx = find_node(set_piece);
+    if (node_idx == npos or set_piece.intervals().empty()) {
+        return;
+    }
+
+    const Node& n = _nodes[node_idx];
+    const auto& intervals = set_piece.intervals();
+    const auto& node_intervals = n.set_piece.intervals();
+    const size_t last = intervals.size() - 1;
+    const bool contiguous_last = intervals[last].step() == 1;
+
+    // current element of the outer dimensions, in a row-major iteration
+    std::vector<SBG::Util::INT> element(intervals.size());
+    for (size_t d = 0; d < intervals.size(); d++) {
+        element[d] = intervals[d].begin();
+    }
+
+    bool pending = false;
+    size_t first = 0, end = 0;
+    while (true) {
+        size_t base = n.offset;
+        for (size_t d = 0; d < last; d++) {
+            base += (element[d] - node_intervals[d].begin()) * n.strides[d];
+        }
+
+        const auto& row = intervals[last];
+        const SBG::Util::INT row_offset = node_intervals[last].begin();
+        if (contiguous_last) {
+            size_t row_first = base + (row.begin() - row_offset);
+            size_t row_last = base + (row.end() - row_offset);
+            if (pending and row_first == end + 1) {
+                end = row_last;
+            } else {
+                if (pending) {
+                    f(first, end);
+                }
+                first = row_first;
+                end = row_last;
+                pending = true;
+            }
+        } else {
+            for (SBG::Util::INT v = row.begin(); v <= row.end(); v += row.step()) {
+                size_t i = base + (v - row_offset);
+                f(i, i);
+            }
+        }
+
+        // next element of the outer dimensions
+        size_t d = last;
+        while (d > 0) {
+            d--;
+            element[d] += intervals[d].step();
+            if (element[d] <= intervals[d].end()) {
+                break;
+            }
+            element[d] = intervals[d].begin();
+            if (d == 0) {
+                d = npos;
+                break;
+            }
+        }
+
+        if (last == 0 or d == npos) {
+            break;
+        }
+    }
+
+    if (pending) {
+        f(first, end);
+    }
+}
+
+}
@@ -16,12 +16,25 @@
 
  ******************************************************************************/
 
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
 #include <getopt.h>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
+#include <map>
+#include <numeric>
 #include <optional>
+#include <rapidjson/document.h>
+#include <rapidjson/filereadstream.h>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <sched.h>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "build_sb_graph.hpp"
 #include "kernighan_lin_partitioner.hpp"
@@ -33,36 +46,239 @@ using namespace std;
 using namespace sbg_partitioner;
 
 
-typedef std::vector<std::string> stringvec;
+namespace {
+
+constexpr size_t buffer_size = 64 * 1024;
+
+/// Exit status when a phase is slower than the baseline beyond the threshold.
+constexpr int regression_status = 2;
+
+
+/// Summary of the samples of a phase, in milliseconds.
+struct PhaseStats {
+    vector<double> samples;
+    double min = 0;
+    double median = 0;
+    double p95 = 0;
+    double mean = 0;
+    double stddev = 0;
+};
+
+
+/// Median of a phase in a baseline, and how the current run compares with it.
+struct Comparison {
+    double baseline_median = 0;
+    double ratio = 0;
+    bool regression = false;
+};
+
 
-struct path_leaf_string
+PhaseStats summarize(const vector<double>& samples)
 {
-    std::string operator()(const std::filesystem::directory_entry& entry) const
-    {
-        return entry.path().string();
+    PhaseStats stats;
+    stats.samples = samples;
+    if (samples.empty()) {
+        return stats;
     }
-};
 
-void read_directory(const std::string& name, stringvec& v)
+    vector<double> sorted = samples;
+    sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+
+    stats.min = sorted.front();
+    stats.median = n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    // nearest rank
+    stats.p95 = sorted[size_t(ceil(0.95 * n)) - 1];
+    stats.mean = accumulate(sorted.begin(), sorted.end(), 0.0) / n;
+
+    if (n > 1) {
+        double sum = 0;
+        for (double sample : sorted) {
+            sum += (sample - stats.mean) * (sample - stats.mean);
+        }
+        stats.stddev = sqrt(sum / (n - 1));
+    }
+
+    return stats;
+}
+
+
+/// Parses a comma separated list of cpus, e.g. 2 or 2,3. Returns false if it is not valid.
+bool parse_cpus(const string& arg, vector<int>& cpus)
+{
+    istringstream items(arg);
+    string item;
+    while (getline(items, item, ',')) {
+        size_t end = 0;
+        try {
+            int cpu = stoi(item, &end);
+            if (end != item.size() or cpu < 0 or cpu >= CPU_SETSIZE) {
+                return false;
+            }
+            cpus.push_back(cpu);
+        } catch (const exception&) {
+            return false;
+        }
+    }
+
+    return not cpus.empty();
+}
+
+
+/// Pins this process, and the threads it starts from now on, to cpus.
+bool pin_to_cpus(const vector<int>& cpus)
 {
-    std::filesystem::path p(name);
-    std::filesystem::directory_iterator start(p);
-    std::filesystem::directory_iterator end;
-    std::transform(start, end, std::back_inserter(v), path_leaf_string());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
 }
 
+
+/// Reads the median of each phase of a json file written by write_results.
+bool read_baseline(const string& filename, map<string, double>& medians)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char buffer[buffer_size];
+    rapidjson::FileReadStream is(file, buffer, sizeof(buffer));
+    rapidjson::Document document;
+    document.ParseStream(is);
+    fclose(file);
+
+    if (document.HasParseError() or not document.IsObject() or not document.HasMember("phases")
+        or not document["phases"].IsObject()) {
+        return false;
+    }
+
+    for (const auto& phase : document["phases"].GetObject()) {
+        if (phase.value.IsObject() and phase.value.HasMember("median") and phase.value["median"].IsNumber()) {
+            medians[phase.name.GetString()] = phase.value["median"].GetDouble();
+        }
+    }
+
+    return true;
+}
+
+
+bool write_results(
+    const string& filename,
+    const string& model,
+    unsigned number_of_partitions,
+    float epsilon,
+    unsigned warmups,
+    const vector<int>& cpus,
+    const vector<pair<string, PhaseStats>>& phases,
+    const map<string, Comparison>& comparisons,
+    float threshold)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char buffer[buffer_size];
+    rapidjson::FileWriteStream os(file, buffer, sizeof(buffer));
+    rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(os);
+    writer.StartObject();
+    writer.Key("model");
+    writer.String(model.c_str());
+    writer.Key("partitions");
+    writer.Uint(number_of_partitions);
+    writer.Key("epsilon");
+    writer.Double(epsilon);
+    writer.Key("warmups");
+    writer.Uint(warmups);
+    writer.Key("repetitions");
+    writer.Uint(phases.front().second.samples.size());
+    writer.Key("cpus");
+    writer.StartArray();
+    for (int cpu : cpus) {
+        writer.Int(cpu);
+    }
+    writer.EndArray();
+
+    writer.Key("phases");
+    writer.StartObject();
+    for (const auto& [name, stats] : phases) {
+        writer.Key(name.c_str());
+        writer.StartObject();
+        writer.Key("min");
+        writer.Double(stats.min);
+        writer.Key("median");
+        writer.Double(stats.median);
+        writer.Key("p95");
+        writer.Double(stats.p95);
+        writer.Key("mean");
+        writer.Double(stats.mean);
+        writer.Key("stddev");
+        writer.Double(stats.stddev);
+        writer.Key("samples");
+        writer.StartArray();
+        for (double sample : stats.samples) {
+            writer.Double(sample);
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndObject();
+
+    if (not comparisons.empty()) {
+        writer.Key("baseline");
+        writer.StartObject();
+        writer.Key("threshold");
+        writer.Double(threshold);
+        for (const auto& [name, comparison] : comparisons) {
+            writer.Key(name.c_str());
+            writer.StartObject();
+            writer.Key("median");
+            writer.Double(comparison.baseline_median);
+            writer.Key("ratio");
+            writer.Double(comparison.ratio);
+            writer.Key("regression");
+            writer.Bool(comparison.regression);
+            writer.EndObject();
+        }
+        writer.EndObject();
+    }
+
+    writer.EndObject();
+    os.Put('\n');
+    os.Flush();
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 and ok;
+
+    return ok;
+}
+
+}
+
+
 void usage()
 {
-    cout << "Usage sbg-partitioner" << endl;
+    cout << "Usage sbg-partitioner-exec-time" << endl;
     cout << endl;
-    cout << "-h, --help       Display this information and exit" << endl;
-    cout << "-v, --version    Display version information and exit" << endl;
-    cout << "-f, --filename   Path to the input file, a json file that represents "
+    cout << "-h, --help        Display this information and exit" << endl;
+    cout << "-v, --version     Display version information and exit" << endl;
+    cout << "-f, --filename    Path to the input file, a json file that represents "
             "the model we want to partitionate." << endl;
-    cout << "-p, --partitions Number of partitions." << endl;
-    cout << "-d,              path to a directory with txt files that indicate the "
-            "model partitioning using other algorithms." << endl;
-    cout << "-e               Imbalance epsilon, a value between 0 and 1." << endl;
+    cout << "-p, --partitions  Number of partitions." << endl;
+    cout << "-e                Imbalance epsilon, a value between 0 and 1." << endl;
+    cout << "-w, --warmups     Runs before the measured ones, 1 by default." << endl;
+    cout << "-n, --repetitions Measured runs, 5 by default." << endl;
+    cout << "-c, --cpus        Pin the partitioner and its threads to these cpus, e.g. 2 or 2,3." << endl;
+    cout << "-o, --output      Output json file, <model>_<partitions>_exec_time.json by default." << endl;
+    cout << "-b, --baseline    Output json file of a previous run. Phases whose median is slower" << endl;
+    cout << "                  than the baseline one beyond the threshold are regressions, and the" << endl;
+    cout << "                  exit status is " << regression_status << "." << endl;
+    cout << "-t, --threshold   Regression threshold, a fraction of the baseline median, 0.1 by default." << endl;
     cout << endl;
     cout << "SBG Partitioner home page: https://github.com/CIFASIS/sbg-partitioner " << endl;
 }
@@ -81,95 +297,173 @@ int main(int argc, char** argv)
 {
     int opt;
     optional<string> filename = nullopt;
-    unsigned iterations = 5;
+    unsigned warmups = 1;
+    unsigned repetitions = 5;
     optional<unsigned> number_of_partitions = nullopt;
     optional<string> output_sb_graph = nullopt;
     optional<float> epsilon = 0.0;
+    vector<int> cpus;
+    optional<string> output_file = nullopt;
+    optional<string> baseline_file = nullopt;
+    float threshold = 0.1;
 
     while (true) {
 
         static struct option long_options[] = {
             {"filename", required_argument, 0, 'f'},
-            // {"directory", required_argument, 0, 'd'},
             {"partitions", required_argument, 0, 'p'},
-            // {"output", required_argument, 0, 'o'},
+            {"warmups", required_argument, 0, 'w'},
+            {"repetitions", required_argument, 0, 'n'},
+            {"cpus", required_argument, 0, 'c'},
+            {"output", required_argument, 0, 'o'},
+            {"baseline", required_argument, 0, 'b'},
+            {"threshold", required_argument, 0, 't'},
             {"version", no_argument, 0, 'v'},
             {"help", no_argument, 0, 'h'}
         };
 
         int option_index = 0;
-        opt = getopt_long(argc, argv, "f:p:e:gvh:", long_options, &option_index);
+        opt = getopt_long(argc, argv, "f:p:e:w:n:c:o:b:t:vh", long_options, &option_index);
         if (opt == EOF) break;
 
         switch (opt) {
         case 'f':
-          if (optarg) {
             filename = string(optarg);
-          }
-          break;
+            break;
 
         case 'p':
-          if (optarg) {
             number_of_partitions = atoi(optarg);
-          }
-          break;
+            break;
 
         case 'e':
-            if (optarg) {
             epsilon = atof(optarg);
+            break;
+
+        case 'w':
+            warmups = atoi(optarg);
+            break;
+
+        case 'n':
+            repetitions = atoi(optarg);
+            break;
+
+        case 'c':
+            if (not parse_cpus(optarg, cpus)) {
+                cerr << "Invalid cpus " << optarg << endl;
+                usage();
+                exit(1);
             }
             break;
 
+        case 'o':
+            output_file = string(optarg);
+            break;
+
+        case 'b':
+            baseline_file = string(optarg);
+            break;
+
+        case 't':
+            threshold = atof(optarg);
+            break;
+
         case 'v':
-          version();
-          exit(0);
+            version();
+            exit(0);
 
         case 'h':
-          usage();
-          exit(0);
+            usage();
+            exit(0);
 
         case '?':
-          usage();
-          exit(-1);
+            usage();
+            exit(-1);
 
         default:
-          abort();
+            abort();
         }
     }
 
-    string partition_str;
-    long double total_time_building_graph = 0;
-    long double total_time_partitioning = 0;
-    for (unsigned i = 0; i < iterations; i++) {
+    if (not filename or not number_of_partitions or repetitions == 0) {
+        usage();
+        exit(1);
+    }
+
+    map<string, double> baseline;
+    if (baseline_file and not read_baseline(*baseline_file, baseline)) {
+        cerr << "Unable to read baseline " << *baseline_file << endl;
+        exit(1);
+    }
+
+    if (not cpus.empty() and not pin_to_cpus(cpus)) {
+        perror("Unable to pin to the given cpus");
+        exit(1);
+    }
+
+    vector<double> build_graph_samples, partitionate_samples, total_samples;
+    for (unsigned i = 0; i < warmups + repetitions; i++) {
         long double time_building_graph;
         long double time_partitioning;
-        partition_str = partitionate_nodes(*filename, *number_of_partitions, *epsilon, output_sb_graph, time_building_graph, time_partitioning);
-        cout << "Time to build sg graph " << time_building_graph << endl;
-        cout << "Time to partitionate " << time_partitioning << endl;
-        total_time_building_graph += time_building_graph;
-        total_time_partitioning += time_partitioning;
+        partitionate_nodes(*filename, *number_of_partitions, *epsilon, output_sb_graph, time_building_graph, time_partitioning);
+
+        if (i < warmups) {
+            continue;
+        }
+
+        build_graph_samples.push_back(time_building_graph);
+        partitionate_samples.push_back(time_partitioning);
+        total_samples.push_back(time_building_graph + time_partitioning);
     }
 
-    long double avg_time_building_graph = total_time_building_graph / double(iterations);
-    long double avg_time_partitioning = total_time_partitioning / double(iterations);
+    const vector<pair<string, PhaseStats>> phases = {
+        {"build_graph", summarize(build_graph_samples)},
+        {"partitionate", summarize(partitionate_samples)},
+        {"total", summarize(total_samples)}
+    };
+
+    map<string, Comparison> comparisons;
+    bool regression = false;
+    for (const auto& [name, stats] : phases) {
+        auto it = baseline.find(name);
+        if (it == baseline.end() or it->second <= 0) {
+            continue;
+        }
 
-    cout << "Average time to build graph after " << iterations << " executions is: " << avg_time_building_graph << " milliseconds" << endl;
-    cout << "Average time to partitionate after " << iterations << " executions is: " << avg_time_partitioning << " milliseconds" << endl;
+        Comparison& comparison = comparisons[name];
+        comparison.baseline_median = it->second;
+        comparison.ratio = stats.median / it->second;
+        comparison.regression = comparison.ratio > 1 + threshold;
+        regression = regression or comparison.regression;
+    }
 
-    cout << "Results: " << partition_str << endl;
+    cout << left << setw(14) << "phase" << right << fixed << setprecision(2)
+         << setw(12) << "min ms" << setw(12) << "median ms" << setw(12) << "p95 ms" << setw(12) << "stddev ms";
+    if (not comparisons.empty()) {
+        cout << setw(14) << "vs baseline";
+    }
+    cout << endl;
+    for (const auto& [name, stats] : phases) {
+        cout << left << setw(14) << name << right
+             << setw(12) << stats.min << setw(12) << stats.median << setw(12) << stats.p95 << setw(12) << stats.stddev;
+        auto comparison = comparisons.find(name);
+        if (comparison != comparisons.end()) {
+            cout << setw(13) << (comparison->second.ratio - 1) * 100 << "%";
+            if (comparison->second.regression) {
+                cout << "  REGRESSION";
+            }
+        }
+        cout << endl;
+    }
 
-    filesystem::path f_path = filesystem::path(*filename);
+    if (not output_file) {
+        output_file = filesystem::path(*filename).replace_extension(filesystem::path("")).string()
+            + "_" + to_string(*number_of_partitions) + "_exec_time.json";
+    }
 
-    auto output_file = filesystem::path(*filename).replace_extension(filesystem::path("")).string();
-    output_file += "_";
-    output_file += to_string(*number_of_partitions);
-    output_file += "_exec_time.txt";
-    ofstream output_stream;
-    output_stream.open(output_file);
-    output_stream << "Average time to build graph after " << iterations << " executions is: " << avg_time_building_graph << " milliseconds" << endl;
-    output_stream << "Average time to partitionate after " << iterations << " executions is: " << avg_time_partitioning << " milliseconds" << endl;
-    output_stream << "Results: " << partition_str << endl;
-    output_stream.close();
+    if (not write_results(*output_file, *filename, *number_of_partitions, *epsilon, warmups, cpus, phases, comparisons, threshold)) {
+        cerr << "Unable to write output file " << *output_file << endl;
+        exit(1);
+    }
 
-    return 0;
-}
\ No newline at end of file
+    return regression ? regression_status : 0;
+}
@@ -0,0 +1,293 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ *****************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <optional>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <csr_graph.hpp>
+#include <element_index.hpp>
+#include <flat_metrics.hpp>
+#include <kernighan_lin_partitioner.hpp>
+#include <memory_usage.hpp>
+#include <owner_vector.hpp>
+
+#include "graph_partitioner.hpp"
+
+constexpr const char *SBG_METHOD = "SBG";
+constexpr const char *DEFAULT_METHODS = "Metis,Scotch,Kahip";
+
+struct BenchmarkRow {
+  std::string model;
+  std::string method;
+  grp_t vertices;
+  grp_t arcs;
+  unsigned partitions;
+  double build_time;      // ms
+  double partition_time;  // ms
+  size_t peak_memory;     // bytes
+  sbg_partitioner::metrics::communication_metrics metrics;
+};
+
+void usage()
+{
+  std::cout << "Usage: benchmark -f <file_name> [-f <file_name> ...] -n <num_partitions> [-e <epsilon>] [-m <methods>] [-o <output>]" << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  -f <file_name>        SBG input JSON file name, it can be repeated to run several model sizes" << std::endl;
+  std::cout << "  -n <num_partitions>   Number of partitions" << std::endl;
+  std::cout << "  -e <epsilon>          Imbalance epsilon, a value between 0 and 1, used by every method" << std::endl;
+  std::cout << "  -m <methods>          Comma separated partition methods to compare with the SBG partitioner, default: "
+            << DEFAULT_METHODS << ". Possible values: " << GraphPartitioner::validPartitionMethodsStr() << std::endl;
+  std::cout << "  -o <output>           Output table, json if it ends with .json, csv otherwise. Default: csv to stdout, with any other output of the partitioners sent to stderr" << std::endl;
+  std::cout << "  -h                    Display this information and exit" << std::endl;
+}
+
+std::vector<std::string> splitMethods(const std::string &methods)
+{
+  std::vector<std::string> result;
+  std::istringstream stream(methods);
+  std::string method;
+  while (std::getline(stream, method, ',')) {
+    if (!method.empty()) {
+      result.push_back(method);
+    }
+  }
+  return result;
+}
+
+double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/// Runs the SBG partitioner on model and adds its row. It returns the flattened graph,
+/// so the classic partitioners run on exactly the same graph, and in build_time the time
+/// it took to get it from the json model.
+sbg_partitioner::CSRGraph<grp_t> benchmarkSBG(const std::string &model, unsigned partitions, float epsilon,
+                                              std::vector<BenchmarkRow> &rows, double &build_time)
+{
+  sbg_partitioner::memory_usage::reset_peak_rss();
+
+  std::optional<std::string> graph_str;
+  sbg_partitioner::WeightedSBGraph sb_graph;
+  sbg_partitioner::PartitionMap partition_map;
+  long double sb_graph_time, partition_time;
+  sbg_partitioner::partitionate_nodes(model, partitions, epsilon, graph_str, sb_graph, partition_map, sb_graph_time, partition_time);
+
+  size_t peak_memory = sbg_partitioner::memory_usage::peak_rss();
+
+  auto start = std::chrono::high_resolution_clock::now();
+  auto csr = sbg_partitioner::build_csr_graph<grp_t>(sb_graph);
+  build_time = double(sb_graph_time) + elapsedMs(start);
+
+  sbg_partitioner::ElementIndex index(sb_graph.V());
+  std::vector<uint32_t> owner(index.size());
+  sbg_partitioner::fill_owner_vector(partition_map, index, owner.data());
+
+  rows.push_back(BenchmarkRow{model, SBG_METHOD, csr.number_of_vertices(), csr.number_of_arcs(), partitions,
+                              double(sb_graph_time), double(partition_time), peak_memory,
+                              sbg_partitioner::metrics::flat_metrics(csr, owner.data(), partitions)});
+
+  return csr;
+}
+
+void benchmarkMethod(const std::string &model, const std::string &method, const sbg_partitioner::CSRGraph<grp_t> &csr,
+                     unsigned partitions, float epsilon, double build_time, std::vector<BenchmarkRow> &rows)
+{
+  GraphPartitioner partitioner(model, csr, epsilon);
+
+  sbg_partitioner::memory_usage::reset_peak_rss();
+  auto start = std::chrono::high_resolution_clock::now();
+  Partition partition = partitioner.createPartition(method, partitions, false);
+  double partition_time = elapsedMs(start);
+  size_t peak_memory = sbg_partitioner::memory_usage::peak_rss();
+
+  if (partition.values.size() != size_t(csr.number_of_vertices())) {
+    std::cerr << method << " did not partition " << model << std::endl;
+    return;
+  }
+
+  rows.push_back(BenchmarkRow{model, method, csr.number_of_vertices(), csr.number_of_arcs(), partitions,
+                              build_time, partition_time, peak_memory,
+                              sbg_partitioner::metrics::flat_metrics(csr, partition.values.data(), partitions)});
+}
+
+/// Sends everything written to stdout, by the partitioners or by processes they run, to
+/// stderr while it is alive, so stdout only carries the table.
+class StdoutToStderr {
+  public:
+  StdoutToStderr() : _stdout(dup(STDOUT_FILENO))
+  {
+    std::cout.flush();
+    if (_stdout >= 0) {
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+  }
+
+  StdoutToStderr(const StdoutToStderr&) = delete;
+  StdoutToStderr& operator=(const StdoutToStderr&) = delete;
+
+  ~StdoutToStderr()
+  {
+    std::cout.flush();
+    fflush(stdout);
+    if (_stdout >= 0) {
+      dup2(_stdout, STDOUT_FILENO);
+      close(_stdout);
+    }
+  }
+
+  private:
+  int _stdout;
+};
+
+void writeCsv(std::ostream &os, const std::vector<BenchmarkRow> &rows)
+{
+  os << "model,method,vertices,arcs,partitions,build_time_ms,partition_time_ms,peak_memory_bytes,"
+        "edge_cut,comm_volume,max_comm_volume,maximum_imbalance" << std::endl;
+  for (const auto &row : rows) {
+    os << row.model << "," << row.method << "," << row.vertices << "," << row.arcs << "," << row.partitions << ","
+       << row.build_time << "," << row.partition_time << "," << row.peak_memory << ","
+       << row.metrics.edge_cut << "," << row.metrics.comm_volume << "," << row.metrics.max_comm_volume << ","
+       << row.metrics.maximum_imbalance << std::endl;
+  }
+}
+
+void writeJson(std::ostream &os, const std::vector<BenchmarkRow> &rows)
+{
+  // model paths are written as they are given, so they are escaped by the writer
+  rapidjson::OStreamWrapper stream(os);
+  rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+  writer.StartArray();
+  for (const auto &row : rows) {
+    writer.StartObject();
+    writer.Key("model");
+    writer.String(row.model.c_str(), row.model.size());
+    writer.Key("method");
+    writer.String(row.method.c_str(), row.method.size());
+    writer.Key("vertices");
+    writer.Int64(row.vertices);
+    writer.Key("arcs");
+    writer.Int64(row.arcs);
+    writer.Key("partitions");
+    writer.Uint(row.partitions);
+    writer.Key("build_time_ms");
+    writer.Double(row.build_time);
+    writer.Key("partition_time_ms");
+    writer.Double(row.partition_time);
+    writer.Key("peak_memory_bytes");
+    writer.Uint64(row.peak_memory);
+    writer.Key("edge_cut");
+    writer.Int64(row.metrics.edge_cut);
+    writer.Key("comm_volume");
+    writer.Int64(row.metrics.comm_volume);
+    writer.Key("max_comm_volume");
+    writer.Int64(row.metrics.max_comm_volume);
+    writer.Key("maximum_imbalance");
+    writer.Double(row.metrics.maximum_imbalance);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  os << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  std::vector<std::string> models;
+  int partitions = 0;
+  float epsilon = 0.0;
+  std::string methods = DEFAULT_METHODS;
+  std::optional<std::string> output;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:n:e:m:o:h")) != -1) {
+    switch (opt) {
+    case 'f':
+      models.push_back(optarg);
+      break;
+    case 'n':
+      partitions = std::stoi(optarg);
+      break;
+    case 'e':
+      epsilon = std::stof(optarg);
+      break;
+    case 'm':
+      methods = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage();
+      exit(EXIT_SUCCESS);
+    }
+  }
+
+  if (models.empty() || partitions <= 0 || epsilon < 0 || epsilon > 1) {
+    usage();
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<BenchmarkRow> rows;
+  {
+    std::optional<StdoutToStderr> redirect;
+    if (!output) {
+      redirect.emplace();
+    }
+
+    for (const auto &model : models) {
+      double build_time;
+      auto csr = benchmarkSBG(model, partitions, epsilon, rows, build_time);
+
+      for (const auto &method : splitMethods(methods)) {
+        benchmarkMethod(model, method, csr, partitions, epsilon, build_time, rows);
+      }
+    }
+  }
+
+  if (!output) {
+    writeCsv(std::cout, rows);
+    return 0;
+  }
+
+  std::ofstream output_file(*output);
+  if (!output_file) {
+    std::cerr << "Error opening file: " << *output << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool json = output->size() >= 5 && output->compare(output->size() - 5, 5, ".json") == 0;
+  if (json) {
+    writeJson(output_file, rows);
+  } else {
+    writeCsv(output_file, rows);
+  }
+
+  return 0;
+}
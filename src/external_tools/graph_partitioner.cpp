@@ -36,6 +36,7 @@
 #include <kahip/kaHIP_interface.h>
 #include <patoh/patoh.h>
 #include <build_sb_graph.hpp>
+#include <csr_graph.hpp>
 
 #include "graph_partitioner.hpp"
 
@@ -50,6 +51,19 @@ static const std::unordered_map<std::string, PartitionMethod> PARTITION_METHOD_M
 
 GraphPartitioner::GraphPartitioner(const std::string &name) : _name(name) { generateInputGraph(); }
 
+GraphPartitioner::GraphPartitioner(const std::string &name, sbg_partitioner::CSRGraph<grp_t> graph, double imbalance)
+    : _name(name),
+      _edges(graph.number_of_arcs()),
+      _nbr_parts(0),
+      _nbr_vtxs(graph.number_of_vertices()),
+      _imbalance(imbalance),
+      _xadj(std::move(graph.xadj)),
+      _adjncy(std::move(graph.adjncy)),
+      _vwgt(std::move(graph.vwgt)),
+      _ewgt(std::move(graph.ewgt))
+{
+}
+
 std::string GraphPartitioner::validPartitionMethodsStr()
 {
     std::ostringstream valid_methods;
@@ -64,7 +78,7 @@ std::string GraphPartitioner::validPartitionMethodsStr()
     return valid_methods.str();
 }
 
-Partition GraphPartitioner::createPartition(const std::string &partition_method_name, unsigned int partitions)
+Partition GraphPartitioner::createPartition(const std::string &partition_method_name, unsigned int partitions, bool save)
 {
   Partition partition;
   PartitionMethod partition_method = partitionMethod(partition_method_name);
@@ -107,9 +121,11 @@ Partition GraphPartitioner::createPartition(const std::string &partition_method_
   auto end = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> duration = end - start;
 
-  std::cout << "Partition Time: " << duration.count() << " seconds." << std::endl;
+  std::cerr << "Partition Time: " << duration.count() << " seconds." << std::endl;
 
-  savePartitionToFile(partition, partition_method_name);
+  if (save) {
+    savePartitionToFile(partition, partition_method_name);
+  }
   return partition;
 }
 
@@ -130,7 +146,14 @@ void GraphPartitioner::generateInputGraph()
 void GraphPartitioner::readGraphFromJson()
 {
   sbg_partitioner::WeightedSBGraph sbg_graph =  sbg_partitioner::build_sb_graph(_name);
-  // @todo: Fill the vectors used by the partitiones from the SBG Graph.
+  sbg_partitioner::CSRGraph<grp_t> csr = sbg_partitioner::build_csr_graph<grp_t>(sbg_graph);
+
+  _nbr_vtxs = csr.number_of_vertices();
+  _edges = csr.number_of_arcs();
+  _xadj = std::move(csr.xadj);
+  _adjncy = std::move(csr.adjncy);
+  _vwgt = std::move(csr.vwgt);
+  _ewgt = std::move(csr.ewgt);
 }
 
 void GraphPartitioner::readGraph()
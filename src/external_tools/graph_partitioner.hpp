@@ -21,6 +21,7 @@
 #include <string>
 #include <metis.h>
 #include <scotch/scotch.h>
+#include <csr_graph.hpp>
 //#include "patoh.h"   // Include PaToH headers
 
 using grp_t = idx_t;
@@ -45,7 +46,13 @@ class GraphPartitioner {
   public:
   explicit GraphPartitioner(const std::string &name);
 
-  Partition createPartition(const std::string& partition_method, unsigned int partitions);
+  /// Takes an already flattened graph, e.g. built with sbg_partitioner::build_csr_graph,
+  /// so it is not read again. name is only used to name the output files.
+  GraphPartitioner(const std::string &name, sbg_partitioner::CSRGraph<grp_t> graph, double imbalance);
+
+  /// The partition time is reported on stderr. If save is true, the partition is also
+  /// written to a file named after the input and the method.
+  Partition createPartition(const std::string& partition_method, unsigned int partitions, bool save = true);
 
   static std::string validPartitionMethodsStr();
 
@@ -0,0 +1,93 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "csr_graph.hpp"
+#include "partition_metrics_api.hpp"
+
+
+namespace sbg_partitioner {
+
+namespace metrics {
+
+/// Computes the same metrics as edge_cut, communication_volume and maximum_imbalance,
+/// on a CSR graph and the owner of each of its vertices, e.g. a dense owner vector of
+/// a PartitionMap or the partition of a classic partitioner. It is linear in the size
+/// of the graph, so the partitions of every tool can be compared on large models.
+template<typename Index, typename Owner>
+communication_metrics flat_metrics(const CSRGraph<Index>& graph, const Owner* owner, unsigned number_of_partitions)
+{
+    std::vector<long long> weights(number_of_partitions, 0);
+    std::vector<int> volumes(number_of_partitions, 0);
+    std::vector<Index> last_seen(number_of_partitions, -1);
+
+    long long cut = 0;
+    long long total_weight = 0;
+    for (Index v = 0; v < graph.number_of_vertices(); v++) {
+        const auto p = owner[v];
+        weights[p] += graph.vwgt[v];
+        total_weight += graph.vwgt[v];
+
+        // each partition adjacent to v, other than its own, receives it once
+        for (Index e = graph.xadj[v]; e < graph.xadj[v + 1]; e++) {
+            const auto q = owner[graph.adjncy[e]];
+            if (q != p) {
+                cut += graph.ewgt[e];
+                if (last_seen[q] != v) {
+                    last_seen[q] = v;
+                    volumes[p]++;
+                }
+            }
+        }
+    }
+
+    communication_metrics comm_metrics;
+    // each edge is stored in both of its ends
+    comm_metrics.edge_cut = cut / 2;
+    comm_metrics.comm_volume = 0;
+    comm_metrics.max_comm_volume = 0;
+    for (int volume : volumes) {
+        comm_metrics.comm_volume += volume;
+        comm_metrics.max_comm_volume = std::max(comm_metrics.max_comm_volume, volume);
+    }
+
+    // partitions without vertices, e.g. ranks of a topology with no partition, are skipped
+    const auto non_empty_partitions = number_of_partitions - std::count(weights.begin(), weights.end(), 0);
+    float expected_imb = total_weight / std::max<long long>(non_empty_partitions, 1);
+    comm_metrics.maximum_imbalance = 0.;
+    for (auto weight : weights) {
+        if (weight == 0) {
+            continue;
+        }
+        float imbalance_p = std::abs(expected_imb - float(weight)) / expected_imb;
+        comm_metrics.maximum_imbalance = std::max(comm_metrics.maximum_imbalance, imbalance_p);
+    }
+
+    return comm_metrics;
+}
+
+}
+
+}
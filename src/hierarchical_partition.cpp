@@ -0,0 +1,167 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <chrono>
+
+#include "build_sb_graph.hpp"
+#include "hierarchical_partition.hpp"
+#include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+/// Splits block into number_of_cores parts of the same weight. Each set piece is cut in
+/// number_of_cores consecutive ranges, so cores get the same range of each equation as
+/// the initial partition would give them, and pieces too small to be cut go whole to
+/// the lightest core.
+vector<OrdSet> split_block(const WeightedSBGraph& graph, const OrdSet& block, unsigned number_of_cores)
+{
+    set_ops::PhaseScope phase(set_ops::Phase::INITIAL_PARTITION);
+
+    const auto node_weights = graph.get_node_weights();
+    vector<OrdSet> cores(number_of_cores);
+    vector<unsigned> weights(number_of_cores, 0);
+
+    for (const SetPiece& set_piece : block.pieces()) {
+        const uint64_t piece_weight = get_node_size(set_piece, node_weights);
+        const unsigned element_weight = get_set_cost(set_piece, node_weights);
+        if (piece_weight < uint64_t(number_of_cores) * element_weight) {
+            unsigned lightest = distance(weights.begin(), min_element(weights.begin(), weights.end()));
+            cores[lightest] = set_ops::cup(cores[lightest], OrdSet(set_piece));
+            weights[lightest] += piece_weight;
+            continue;
+        }
+
+        OrdSet rest(set_piece);
+        for (unsigned c = 0; c + 1 < number_of_cores; c++) {
+            unsigned share = piece_weight * (c + 1) / number_of_cores - piece_weight * c / number_of_cores;
+            OrdSet taken = take_weight(rest, node_weights, share);
+            cores[c] = set_ops::cup(cores[c], taken);
+            weights[c] += get_node_size(taken, node_weights);
+            rest = set_ops::difference(rest, taken);
+        }
+        cores.back() = set_ops::cup(cores.back(), rest);
+        weights.back() += get_node_size(rest, node_weights);
+    }
+
+    for (OrdSet& core : cores) {
+        flatten_set(core, graph);
+    }
+
+    return cores;
+}
+
+}
+
+
+HierarchicalResult hierarchical_partition(
+    const WeightedSBGraph& graph, const PartitionOptions& node_options, const PartitionOptions& core_options)
+{
+    HierarchicalResult result;
+    const unsigned number_of_nodes = node_options.number_of_partitions;
+    const unsigned number_of_cores = core_options.number_of_partitions;
+    result.cores_per_node = number_of_cores;
+
+    // First level, the cut between nodes is minimized on its own
+    PartitionResult node_result = partitionate_graph(graph, node_options);
+    result.nodes = move(node_result.partitions);
+    result.node_statistics = move(node_result.statistics);
+
+    logging::sbg_log << "node partition: " << result.nodes << endl;
+
+    // Second level, each node is split in cores, and cores are refined together but
+    // only swap elements with cores of their own node
+    PartitionOptions options = core_options;
+    options.number_of_partitions = number_of_nodes * number_of_cores;
+    options.targets.clear();
+    options.blocks.clear();
+
+    PartitionStatistics& statistics = result.core_statistics;
+    auto start_partitionate = chrono::high_resolution_clock::now();
+    for (unsigned n = 0; n < number_of_nodes; n++) {
+        const OrdSet& block = result.nodes[n];
+        vector<OrdSet> cores = split_block(graph, block, number_of_cores);
+        for (unsigned c = 0; c < number_of_cores; c++) {
+            result.partitions[n * number_of_cores + c] = move(cores[c]);
+            options.targets.push_back(max(result.node_statistics.weights[n], 1u));
+            options.blocks.push_back(n);
+        }
+    }
+    auto end_partitionate = chrono::high_resolution_clock::now();
+
+    refine_partition(graph, result.partitions, options, statistics);
+    statistics.time_to_initial_partition = chrono::duration<double, std::milli>(end_partitionate - start_partitionate).count();
+
+    compute_balance(graph, result.partitions, statistics, options.targets);
+
+    logging::sbg_log << "hierarchical partition: " << result.partitions << endl;
+    logging::sbg_log << "edge cut between nodes " << result.node_statistics.edge_cut
+                     << ", between cores " << statistics.edge_cut << endl;
+
+    return result;
+}
+
+
+HierarchicalResult hierarchical_partition(
+    const string& filename,
+    const PartitionOptions& node_options,
+    const PartitionOptions& core_options,
+    WeightedSBGraph& sb_graph,
+    long double& time_to_build_graph,
+    const CostProfile& profile)
+{
+    auto start_build_graph = chrono::high_resolution_clock::now();
+    sb_graph = build_sb_graph(filename, profile);
+    auto end_build_graph = chrono::high_resolution_clock::now();
+    time_to_build_graph = chrono::duration<double, std::milli>(end_build_graph - start_build_graph).count();
+
+    logging::sbg_log << sb_graph << endl;
+    logging::sbg_log << "sb graph created!" << endl;
+
+    return hierarchical_partition(sb_graph, node_options, core_options);
+}
+
+
+bool write_hierarchical_output(const HierarchicalResult& result, const string& filename)
+{
+    return write_json_file(filename, [&result] (JsonFileWriter& writer) {
+        writer.StartObject();
+        writer.Key("levels");
+        writer.StartArray();
+        writer.Uint(result.nodes.size());
+        writer.Uint(result.cores_per_node);
+        writer.EndArray();
+        writer.Key("partitions");
+        write_partitions_array(writer, result.partitions, result.cores_per_node);
+        writer.EndObject();
+    });
+}
+
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+
+#include "cost_profile.hpp"
+#include "kernighan_lin_partitioner.hpp"
+
+
+namespace sbg_partitioner {
+
+/// Partition of a graph for a machine of nodes with several cores each, where
+/// communication between nodes is much more expensive than between cores of a node.
+struct HierarchicalResult {
+    PartitionMap nodes;          // partition of each node
+    PartitionMap partitions;     // partition i is core i % cores_per_node of node i / cores_per_node
+    unsigned cores_per_node = 0;
+    PartitionStatistics node_statistics;  // its edge cut is the cut between nodes
+    PartitionStatistics core_statistics;  // its edge cut is the cut between every core
+};
+
+
+/// Partitions graph into node_options.number_of_partitions nodes, and then each node into
+/// core_options.number_of_partitions cores, so the edge cut between nodes is minimized
+/// first. Each level has its own options, e.g. its own epsilon. Cores are bounded around
+/// the weight their node actually got, and KL only swaps elements between cores of the
+/// same node, so the cut between nodes is kept. Pairs of cores of different nodes are
+/// refined in parallel. core_options.targets and core_options.blocks are ignored.
+HierarchicalResult hierarchical_partition(
+    const WeightedSBGraph& graph, const PartitionOptions& node_options, const PartitionOptions& core_options);
+
+
+/// Same as above, but the graph is built from filename.
+HierarchicalResult hierarchical_partition(
+    const std::string& filename,
+    const PartitionOptions& node_options,
+    const PartitionOptions& core_options,
+    WeightedSBGraph& sb_graph,
+    long double& time_to_build_graph,
+    const CostProfile& profile = CostProfile());
+
+
+/// Writes the partition in json format to filename, with the node and core of each
+/// partition: {"levels": [nodes, cores], "partitions": [{"node": n, "core": c, "nodes": [...]}, ...]}
+/// Returns false if the file could not be written.
+bool write_hierarchical_output(const HierarchicalResult& result, const std::string& filename);
+
+}
\ No newline at end of file
@@ -18,6 +18,8 @@
 
 #include <algorithm>
 #include <chrono>
+#include <atomic>
+#include <cmath>
 #include <future>
 #include <map>
 #include <rapidjson/document.h>
@@ -25,11 +27,18 @@
 #include <rapidjson/prettywriter.h>
 #include <rapidjson/writer.h>
 #include <set>
+#include <thread>
 #include <util/logger.hpp>
 
 #include "build_sb_graph.hpp"
+#include "dfs_on_sbg.hpp"
+#include "element_index.hpp"
 #include "kernighan_lin_partitioner.hpp"
+#include "memory_usage.hpp"
+#include "quotient_graph.hpp"
 #include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+#include "trace.hpp"
 
 
 #define PARTITION_IMBALANCE_DEBUG 1
@@ -46,6 +55,58 @@ using namespace SBG::Util;
 
 namespace sbg_partitioner {
 
+size_t get_c_ab(
+    const OrdSet& a, const OrdSet& b,
+    const CanonPWMap& map_1,
+    const CanonPWMap& map_2,
+    const EdgeCost& costs)
+{
+    auto f = [](auto& a, auto& b, const CanonPWMap& map_1, const CanonPWMap& map_2) {
+        OrdSet comm_edges;
+        auto d = set_ops::preImage(a, map_1);
+        auto im = set_ops::image(d, map_2);
+        auto inters = set_ops::intersection(b, im);
+        auto edges = set_ops::preImage(inters, map_2);
+        edges = set_ops::intersection(edges, d);
+        comm_edges = set_ops::cup(edges, comm_edges);
+
+        return comm_edges;
+    };
+
+    auto intersection1 = f(a, b, map_1, map_2);
+    auto intersection2 = f(a, b, map_2, map_1);
+
+    auto communication_edges = set_ops::cup(intersection1, intersection2);
+
+    size_t comm_size = get_edge_set_cost(communication_edges, costs);
+
+    return comm_size;
+}
+
+
+pair<OrdSet, OrdSet> compute_EC_IC(
+    const OrdSet& partition,
+    const OrdSet& nodes,
+    const OrdSet& partition_2,
+    const CanonPWMap& map_1,
+    const CanonPWMap& map_2)
+{
+    OrdSet ec, ic;
+    auto d = set_ops::preImage(nodes, map_1);
+    auto im = set_ops::image(d, map_2);
+    auto ic_nodes = set_ops::intersection(partition, im);
+    ic_nodes = set_ops::difference(ic_nodes, nodes);
+    auto ec_nodes = set_ops::difference(im, ic_nodes);
+    ec_nodes = set_ops::intersection(ec_nodes, partition_2);
+    auto ic_ = set_ops::intersection(set_ops::preImage(ic_nodes, map_2), d);
+    auto ec_ = set_ops::intersection(set_ops::preImage(ec_nodes, map_2), d);
+    ec = set_ops::cup(ec_, ec);
+    ic = set_ops::cup(ic_, ic);
+
+    return make_pair(ec, ic);
+}
+
+
 // Using unnamed namespace to define functions with internal linkage
 namespace {
 
@@ -61,6 +122,7 @@ struct GainObjectImbalance {
     OrdSet ec_nodes_j;
     OrdSet ic_nodes_j;
     size_t size_j;
+    int migration;  // part of gain, see PairMigration
 };
 
 
@@ -108,7 +170,160 @@ struct GainObjectComparatorTemplate {
 };
 
 
-using ec_ic = std::pair<SBG::LIB::OrdPWMDInter , SBG::LIB::OrdPWMDInter>;
+/// Elements of the two partitions of a bipartition, a and b, in the partition the graph
+/// had before its weights changed (see PartitionOptions::previous_partition). Moving an
+/// element away from its previous partition costs migration_cost, and moving it back to
+/// it takes that cost back. cost is 0 if there is no previous partition.
+struct PairMigration {
+    OrdSet previous_a;
+    OrdSet previous_b;
+    float cost = 0;
+};
+
+
+/// Imbalance bounds of the two partitions of a bipartition, a and b. All of them are 0
+/// if imbalance is disabled.
+struct PairBounds {
+    unsigned LMin_a = 0;
+    unsigned LMax_a = 0;
+    unsigned LMin_b = 0;
+    unsigned LMax_b = 0;
+
+    bool enabled() const { return LMin_a > 0 or LMax_a > 0 or LMin_b > 0 or LMax_b > 0; }
+};
+
+
+/// Bounds of the other balance constraints for the two partitions of a bipartition, one
+/// for each of weights (see WeightedSBGraph::get_constraint_weights).
+struct PairConstraints {
+    const vector<NodeWeight>* weights = nullptr;
+    vector<PairBounds> bounds;
+
+    bool enabled() const { return not bounds.empty(); }
+};
+
+
+/// Returns the LMin and LMax bounds of each partition, around its share of total given by
+/// targets (see target_fractions).
+vector<pair<unsigned, unsigned>>
+weight_bounds(unsigned total, unsigned number_of_partitions, const float imbalance_epsilon, const vector<float>& targets)
+{
+    const auto fractions = target_fractions(targets, number_of_partitions);
+
+    vector<pair<unsigned, unsigned>> bounds;
+    for (unsigned i = 0; i < number_of_partitions; i++) {
+        unsigned B = targets.empty() ? ceil(float(total) / number_of_partitions) : ceil(total * fractions[i]);
+        int im = imbalance_epsilon * B;
+        unsigned LMin = B - im;
+        unsigned LMax = B + im;
+        bounds.emplace_back(LMin, LMax);
+    }
+
+    return bounds;
+}
+
+
+/// What a swap between two partitions depends on besides the edge cut: the migration
+/// from a previous partition (see PartitionOptions::previous_partition), the bounds of
+/// the other balance constraints (see WeightedSBGraph::get_constraint_weights) and the
+/// blocks partitions belong to (see PartitionOptions::blocks).
+struct SwapContext {
+    const PartitionMap* previous_partition = nullptr;
+    float migration_cost = 0;
+
+    const vector<NodeWeight>* constraint_weights = nullptr;
+    vector<vector<pair<unsigned, unsigned>>> constraint_bounds;  // LMin and LMax by constraint and partition
+
+    const vector<unsigned>* blocks = nullptr;
+
+    bool can_swap(size_t i, size_t j) const
+    {
+        return blocks == nullptr or blocks->empty() or blocks->at(i) == blocks->at(j);
+    }
+};
+
+
+SwapContext make_swap_context(const WeightedSBGraph& graph, unsigned number_of_partitions, const PartitionOptions& options)
+{
+    SwapContext context{options.previous_partition, options.migration_cost, &graph.get_constraint_weights(), {}, &options.blocks};
+    for (const auto& weights : graph.get_constraint_weights()) {
+        unsigned total = get_node_size(graph.V(), weights);
+        context.constraint_bounds.push_back(weight_bounds(total, number_of_partitions, options.epsilon, options.targets));
+    }
+
+    return context;
+}
+
+
+PairMigration pair_migration(const SwapContext& context, size_t i, size_t j)
+{
+    if (context.previous_partition == nullptr or context.migration_cost == 0) {
+        return PairMigration();
+    }
+
+    const PartitionMap& previous = *context.previous_partition;
+    auto previous_of = [&previous] (size_t p) {
+        auto it = previous.find(p);
+        return it != previous.end() ? it->second : OrdSet();
+    };
+
+    return PairMigration{previous_of(i), previous_of(j), context.migration_cost};
+}
+
+
+/// Returns the migration cost of moving moved_to_b from partition a to b and moved_to_a
+/// from b to a.
+int migration_penalty(const PairMigration& migration, const OrdSet& moved_to_b, const OrdSet& moved_to_a)
+{
+    if (migration.cost == 0) {
+        return 0;
+    }
+
+    long leaving = cardinality(set_ops::intersection(moved_to_b, migration.previous_a))
+        + cardinality(set_ops::intersection(moved_to_a, migration.previous_b));
+    long returning = cardinality(set_ops::intersection(moved_to_b, migration.previous_b))
+        + cardinality(set_ops::intersection(moved_to_a, migration.previous_a));
+
+    return lround(migration.cost * (leaving - returning));
+}
+
+
+PairConstraints pair_constraints(const SwapContext& context, size_t i, size_t j)
+{
+    PairConstraints constraints{context.constraint_weights, {}};
+    for (const auto& bounds : context.constraint_bounds) {
+        constraints.bounds.push_back(PairBounds{bounds[i].first, bounds[i].second, bounds[j].first, bounds[j].second});
+    }
+
+    return constraints;
+}
+
+
+/// A bipartition A, B of partition_a and partition_b is feasible if, for each constraint,
+/// both are within their bounds, or the one furthest from its bounds is not further than
+/// the furthest of partition_a and partition_b.
+bool satisfies_constraints(
+    const PairConstraints& constraints, const OrdSet& A, const OrdSet& B, const OrdSet& partition_a, const OrdSet& partition_b)
+{
+    auto violation = [] (const OrdSet& nodes, const NodeWeight& weights, unsigned LMin, unsigned LMax) {
+        long size = get_node_size(nodes, weights);
+        return max({long(LMin) - size, size - long(LMax), 0l});
+    };
+
+    for (size_t c = 0; c < constraints.bounds.size(); c++) {
+        const auto& weights = (*constraints.weights)[c];
+        const auto& bounds = constraints.bounds[c];
+        long after = max(violation(A, weights, bounds.LMin_a, bounds.LMax_a), violation(B, weights, bounds.LMin_b, bounds.LMax_b));
+        long before = max(
+            violation(partition_a, weights, bounds.LMin_a, bounds.LMax_a), violation(partition_b, weights, bounds.LMin_b, bounds.LMax_b));
+        if (after > before) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 
 using GainObjectImbalanceComparator = GainObjectComparatorTemplate<GainObjectImbalance>;
 
@@ -153,75 +368,21 @@ ostream& operator<<(ostream& os, const GainObjectImbalance& gain)
 }
 
 
-pair<unsigned, unsigned>
-compute_lmin_lmax(const WeightedSBGraph& graph, unsigned number_of_partitions, const float imbalance_epsilon)
+/// Returns the LMin and LMax bounds of each partition, around its share of the total
+/// weight given by targets (see target_fractions).
+vector<pair<unsigned, unsigned>>
+compute_lmin_lmax(
+    const WeightedSBGraph& graph, unsigned number_of_partitions, const float imbalance_epsilon, const vector<float>& targets)
 {
     unsigned w_v = get_node_size(graph.V(), graph.get_node_weights());
-    unsigned B = ceil(w_v / number_of_partitions);
-    int im = imbalance_epsilon * B;
-    unsigned LMin = B - im;
-    unsigned LMax = B + im;
 
-    return make_pair(LMin, LMax);
-}
-
-
-size_t get_c_ab(
-    const OrdSet& a, const OrdSet& b,
-    const CanonPWMap& map_1,
-    const CanonPWMap& map_2,
-    const EdgeCost& costs)
-{
-    auto f = [](auto& a, auto& b, const CanonPWMap& map_1, const CanonPWMap& map_2) {
-        OrdSet comm_edges;
-        auto d = preImage(a, map_1);
-        auto im = image(d, map_2);
-        auto inters = intersection(b, im);
-        auto edges = preImage(inters, map_2);
-        edges = intersection(edges, d);
-        comm_edges = cup(edges, comm_edges);
-
-        return comm_edges;
-    };
-
-    auto intersection1 = f(a, b, map_1, map_2);
-    auto intersection2 = f(a, b, map_2, map_1);
-
-    auto communication_edges = cup(intersection1, intersection2);
-
-    size_t comm_size = get_edge_set_cost(communication_edges, costs);
-
-    return comm_size;
-}
-
-
-
-ec_ic compute_EC_IC(
-    const OrdSet& partition,
-    const OrdSet& nodes,
-    const OrdSet& partition_2,
-    const CanonPWMap& map_1,
-    const CanonPWMap& map_2)
-{
-    OrdSet ec, ic;
-    auto d = preImage(nodes, map_1);
-    auto im = image(d, map_2);
-    auto ic_nodes = intersection(partition, im);
-    ic_nodes = difference(ic_nodes, nodes);
-    auto ec_nodes = difference(im, ic_nodes);
-    ec_nodes = intersection(ec_nodes, partition_2);
-    auto ic_ = intersection(preImage(ic_nodes, map_2), d);
-    auto ec_ = intersection(preImage(ec_nodes, map_2), d);
-    ec = cup(ec_, ec);
-    ic = cup(ic_, ic);
-
-    return make_pair(ec, ic);
+    return weight_bounds(w_v, number_of_partitions, imbalance_epsilon, targets);
 }
 
 
 unsigned get_imbalance_size(unsigned min_imbal_part, unsigned max_imbal_part, unsigned size_node_a, unsigned size_node_b, unsigned current_moved_size)
 {
-    logging::sbg_log << "nodes_imbal_part = " << max_imbal_part << ", " << size_node_a << endl;
+    logging::kl_log << "nodes_imbal_part = " << max_imbal_part << ", " << size_node_a << endl;
     unsigned nodes_imbal_part = size_node_a > 0 ? floor(max_imbal_part / size_node_a) : 0;
 
     unsigned min_nodes_imbal_part = size_node_b > 0 ? floor(min_imbal_part / size_node_b) : 0;
@@ -231,7 +392,7 @@ unsigned get_imbalance_size(unsigned min_imbal_part, unsigned max_imbal_part, un
     }
 
     unsigned remaining_node_a = unsigned(size_node_a - current_moved_size);
-    logging::sbg_log << "min between " << remaining_node_a << " and " << current_moved_size << endl;
+    logging::kl_log << "min between " << remaining_node_a << " and " << current_moved_size << endl;
     nodes_imbal_part = std::min(unsigned(current_moved_size), remaining_node_a);
     unsigned new_size_a = current_moved_size + nodes_imbal_part;
 
@@ -249,7 +410,8 @@ GainObjectImbalance get_gain(
     const OrdSet& partition_b,
     unsigned size_b,
     const WeightedSBGraph& graph,
-    const NodeWeight& node_weight)
+    const NodeWeight& node_weight,
+    const PairMigration& migration)
 {
     OrdSet a, b, rest_a, rest_b;
     tie(a, rest_a) = cut_interval_by_dimension(nodes_a, node_weight, size_a);
@@ -264,10 +426,10 @@ GainObjectImbalance get_gain(
 
     // Get the union between both external and internal costs for both combination of maps
     OrdSet ec_nodes_a, ic_nodes_a;
-    ec_nodes_a = cup(ec_nodes_a_1, ec_nodes_a_2);
-    ic_nodes_a = cup(ic_nodes_a_1, ic_nodes_a_2);
+    ec_nodes_a = set_ops::cup(ec_nodes_a_1, ec_nodes_a_2);
+    ic_nodes_a = set_ops::cup(ic_nodes_a_1, ic_nodes_a_2);
 
-    logging::sbg_log << "Node " << idx_a << ", " << nodes_a << " ec: " << ec_nodes_a << " and ic: " << ic_nodes_a << endl;
+    logging::kl_log << "Node " << idx_a << ", " << nodes_a << " ec: " << ec_nodes_a << " and ic: " << ic_nodes_a << endl;
 
     size_t ec_a = get_edge_set_cost(ec_nodes_a, graph.get_edge_costs());
     size_t ic_a = get_edge_set_cost(ic_nodes_a, graph.get_edge_costs());
@@ -281,10 +443,10 @@ GainObjectImbalance get_gain(
     tie(ec_nodes_b_2, ic_nodes_b_2) = compute_EC_IC(partition_b, b, partition_a, graph.map2(), graph.map1());
 
     OrdSet ec_nodes_b, ic_nodes_b;
-    ec_nodes_b = cup(ec_nodes_b_1, ec_nodes_b_2);
-    ic_nodes_b = cup(ic_nodes_b_1, ic_nodes_b_2);
+    ec_nodes_b = set_ops::cup(ec_nodes_b_1, ec_nodes_b_2);
+    ic_nodes_b = set_ops::cup(ic_nodes_b_1, ic_nodes_b_2);
 
-    // logging::sbg_log << "Node: " << idx_b << ", " << nodes_b << " ec: " << ec_nodes_b << " and ic: " << ic_nodes_b << endl;
+    // logging::kl_log << "Node: " << idx_b << ", " << nodes_b << " ec: " << ec_nodes_b << " and ic: " << ic_nodes_b << endl;
 
     size_t ec_b = get_edge_set_cost(ec_nodes_b, graph.get_edge_costs());
     size_t ic_b = get_edge_set_cost(ic_nodes_b, graph.get_edge_costs());
@@ -293,10 +455,13 @@ GainObjectImbalance get_gain(
     // Get communication between a and b
     size_t c_ab = get_c_ab(a, b, graph.map1(), graph.map2(), graph.get_edge_costs());
 
+    // a goes to partition b and b to partition a, so it may migrate elements
+    int migration_term = migration_penalty(migration, a, b);
+
     // calculate gain
-    int gain = d_a + d_b - 2 * c_ab;
+    int gain = d_a + d_b - 2 * c_ab - migration_term;
 
-    auto gain_obj = GainObjectImbalance{idx_a, idx_b, gain, ec_nodes_a, ic_nodes_a, size_a, ec_nodes_b, ic_nodes_b, size_b};
+    auto gain_obj = GainObjectImbalance{idx_a, idx_b, gain, ec_nodes_a, ic_nodes_a, size_a, ec_nodes_b, ic_nodes_b, size_b, migration_term};
 
     return gain_obj;
 }
@@ -304,7 +469,7 @@ GainObjectImbalance get_gain(
 
 void compute_exchange(unsigned i, unsigned j, OrdSet& partition_a, unsigned current_size_a,
     OrdSet& partition_b, unsigned current_size_b, const WeightedSBGraph& graph, const NodeWeight& node_weight,
-    unsigned LMin, unsigned LMax, CostMatrixImbalance& cost_matrix)
+    const PairBounds& bounds, const PairMigration& migration, CostMatrixImbalance& cost_matrix)
 {
     auto nodes_a = OrdSet(partition_a[i]);
     auto nodes_b = OrdSet(partition_b[j]);
@@ -315,21 +480,21 @@ void compute_exchange(unsigned i, unsigned j, OrdSet& partition_a, unsigned curr
     size_t min_size = min(size_node_a, size_node_b);
 
     // No problem here, a is just a copy of partition_a[i], same for b
-    GainObjectImbalance gain_obj = get_gain(i, nodes_a, partition_a, min_size, j, nodes_b, partition_b, min_size, graph, node_weight);
+    GainObjectImbalance gain_obj = get_gain(i, nodes_a, partition_a, min_size, j, nodes_b, partition_b, min_size, graph, node_weight, migration);
 
     // gain is greater than 0 and we are not moving all elements of node_a
-    bool is_imbalance_enabled = LMin > 0 or LMax > 0;
+    bool is_imbalance_enabled = bounds.enabled();
     bool is_gain_positive = gain_obj.gain > 0;
     if (is_imbalance_enabled and is_gain_positive and size_node_a > min_size) {
-        unsigned max_imbal_part = LMax > current_size_b ? LMax - current_size_b : 0; // this is what we can move to b
+        unsigned max_imbal_part = bounds.LMax_b > current_size_b ? bounds.LMax_b - current_size_b : 0; // this is what we can move to b
 
-        unsigned min_imbal_part = current_size_a > LMin ? current_size_a - LMin : 0; // this is what we can move from a
+        unsigned min_imbal_part = current_size_a > bounds.LMin_a ? current_size_a - bounds.LMin_a : 0; // this is what we can move from a
 
         unsigned new_size_a = get_imbalance_size(min_imbal_part, max_imbal_part, size_node_a, size_node_b, min_size);
 
-        GainObjectImbalance gain_obj_imbalance = get_gain(i, nodes_a, partition_a, new_size_a, j, nodes_b, partition_b, min_size, graph, node_weight);
+        GainObjectImbalance gain_obj_imbalance = get_gain(i, nodes_a, partition_a, new_size_a, j, nodes_b, partition_b, min_size, graph, node_weight, migration);
 
-        logging::sbg_log << "is gain better? " << gain_obj << ", " << gain_obj_imbalance << endl;
+        logging::kl_log << "is gain better? " << gain_obj << ", " << gain_obj_imbalance << endl;
 
         if (gain_obj_imbalance.gain > gain_obj.gain) {
             gain_obj = move(gain_obj_imbalance);
@@ -338,15 +503,15 @@ void compute_exchange(unsigned i, unsigned j, OrdSet& partition_a, unsigned curr
 
     // gain is greater than 0 and we are not moving all elements of node_b
     if (is_imbalance_enabled and is_gain_positive and size_node_b > min_size) {
-        unsigned max_imbal_part = LMax > current_size_a ? LMax - current_size_a : 0; // this is what we can move to a
+        unsigned max_imbal_part = bounds.LMax_a > current_size_a ? bounds.LMax_a - current_size_a : 0; // this is what we can move to a
 
-        unsigned min_imbal_part = current_size_b > LMin ? current_size_b - LMin : 0; // this is what we can move from b
+        unsigned min_imbal_part = current_size_b > bounds.LMin_b ? current_size_b - bounds.LMin_b : 0; // this is what we can move from b
 
         unsigned new_size_b = get_imbalance_size(min_imbal_part, max_imbal_part, size_node_b, size_node_a, min_size);
 
-        GainObjectImbalance gain_obj_imbalance = get_gain(i, nodes_a, partition_a, min_size, j, nodes_b, partition_b, new_size_b, graph, node_weight);
+        GainObjectImbalance gain_obj_imbalance = get_gain(i, nodes_a, partition_a, min_size, j, nodes_b, partition_b, new_size_b, graph, node_weight, migration);
 
-        logging::sbg_log << "is gain better? " << gain_obj << ", " << gain_obj_imbalance << endl;
+        logging::kl_log << "is gain better? " << gain_obj << ", " << gain_obj_imbalance << endl;
 
         if (gain_obj_imbalance.gain > gain_obj.gain) {
             gain_obj = move(gain_obj_imbalance);
@@ -362,9 +527,11 @@ CostMatrixImbalance generate_gain_matrix(
     const NodeWeight& node_weight,
     OrdSet& partition_a,
     OrdSet& partition_b,
-    unsigned LMin,
-    unsigned LMax)
+    const PairBounds& bounds,
+    const PairMigration& migration)
 {
+    trace::Span span("gain_matrix", "kl");
+
     CostMatrixImbalance cost_matrix;
 
     unsigned p_size_a = get_node_size(partition_a, graph.get_node_weights());
@@ -372,7 +539,7 @@ CostMatrixImbalance generate_gain_matrix(
 
     for (size_t i = 0; i < partition_a.pieces().size(); i++) {
         for (size_t j = 0; j < partition_b.pieces().size(); j++) {
-            compute_exchange(i, j, partition_a, p_size_a, partition_b, p_size_b, graph, node_weight, LMin, LMax, cost_matrix);
+            compute_exchange(i, j, partition_a, p_size_a, partition_b, p_size_b, graph, node_weight, bounds, migration, cost_matrix);
         }
     }
 
@@ -395,7 +562,7 @@ pair<pair<OrdSet, OrdSet>, pair<OrdSet, OrdSet>> update_sets(
     OrdSet rest_a;
     if (not node_a_is_fully_used) {
         tie(node_a, rest_a) = cut_interval_by_dimension(node_a, graph.get_node_weights(), gain_object.size_i);
-        logging::sbg_log << "cut_interval_by_dimension " << gain_object.size_i << ": " << node_a << rest_a << endl;
+        logging::kl_log << "cut_interval_by_dimension " << gain_object.size_i << ": " << node_a << rest_a << endl;
     }
 
     auto node_b = OrdSet(partition_b[gain_object.j]);
@@ -404,17 +571,17 @@ pair<pair<OrdSet, OrdSet>, pair<OrdSet, OrdSet>> update_sets(
     OrdSet rest_b;
     if (not node_b_is_fully_used) {
         tie(node_b, rest_b) = cut_interval_by_dimension(node_b, graph.get_node_weights(), gain_object.size_j);
-        logging::sbg_log << "cut_interval_by_dimension " << gain_object.size_j << ": " << node_b << rest_b << endl;
+        logging::kl_log << "cut_interval_by_dimension " << gain_object.size_j << ": " << node_b << rest_b << endl;
     }
-    logging::sbg_log << "we remove " << node_a << " from " << partition_a << " and we get: ";
-    partition_a = difference(partition_a, node_a);
-    logging::sbg_log << partition_a << endl;
-    logging::sbg_log << "we remove " << node_b << " from " << partition_b << " and we get: ";
-    partition_b = difference(partition_b, node_b);
-    logging::sbg_log << partition_b << endl;
+    logging::kl_log << "we remove " << node_a << " from " << partition_a << endl;
+    partition_a = set_ops::difference(partition_a, node_a);
+    logging::kl_log << "and we get: " << partition_a << endl;
+    logging::kl_log << "we remove " << node_b << " from " << partition_b << endl;
+    partition_b = set_ops::difference(partition_b, node_b);
+    logging::kl_log << "and we get: " << partition_b << endl;
 
-    current_moved_partition_a = cup(current_moved_partition_a, node_a);
-    current_moved_partition_b = cup(current_moved_partition_b, node_b);
+    current_moved_partition_a = set_ops::cup(current_moved_partition_a, node_a);
+    current_moved_partition_b = set_ops::cup(current_moved_partition_b, node_b);
 
     return make_pair(make_pair(node_a, rest_a), make_pair(node_b, rest_b));
 }
@@ -431,11 +598,11 @@ void update_diff(
     const WeightedSBGraph& graph,
     const NodeWeight& node_weight,
     const GainObjectImbalance& gain_object,
-    unsigned LMin,
-    unsigned LMax)
+    const PairBounds& bounds,
+    const PairMigration& migration)
 {
-    logging::sbg_log << affected_node_a.first << ", " << affected_node_a.second << endl;
-    logging::sbg_log << affected_node_b.first << ", " << affected_node_b.second << endl;
+    logging::kl_log << affected_node_a.first << ", " << affected_node_a.second << endl;
+    logging::kl_log << affected_node_b.first << ", " << affected_node_b.second << endl;
 
     // Firstly, check if indexes need fixing. Three possible causes.
     size_t affected_node_a_size = get_node_size(affected_node_a.second, node_weight);
@@ -480,7 +647,7 @@ void update_diff(
         CostMatrixImbalance new_cost_matrix;
         for (auto g : cost_matrix) {
             if (g.i == gain_object.i) {
-                compute_exchange(gain_object.i, g.j, remaining_partition_a, size_a, remaining_partition_b, size_b, graph, node_weight, LMin, LMax, new_cost_matrix);
+                compute_exchange(gain_object.i, g.j, remaining_partition_a, size_a, remaining_partition_b, size_b, graph, node_weight, bounds, migration, new_cost_matrix);
             } else {
                 new_cost_matrix.insert(g);
             }
@@ -493,7 +660,7 @@ void update_diff(
         CostMatrixImbalance new_cost_matrix;
         for (auto g : cost_matrix) {
             if (g.j == gain_object.j) {
-                compute_exchange(g.i, gain_object.j, remaining_partition_a, size_a, remaining_partition_b, size_b, graph, node_weight, LMin, LMax, new_cost_matrix);
+                compute_exchange(g.i, gain_object.j, remaining_partition_a, size_a, remaining_partition_b, size_b, graph, node_weight, bounds, migration, new_cost_matrix);
             } else {
                 new_cost_matrix.insert(g);
             }
@@ -505,15 +672,15 @@ void update_diff(
     CostMatrixImbalance new_cost_matrix;
     for (auto g : cost_matrix) {
         bool change = false;
-        if (not isEmpty(intersection(g.ic_nodes_i, gain_object.ic_nodes_i)) or not isEmpty(intersection(g.ec_nodes_i, gain_object.ec_nodes_j))) {
-            g.ic_nodes_i = difference(g.ic_nodes_i, gain_object.ic_nodes_i);
-            g.ec_nodes_i = difference(g.ec_nodes_i, gain_object.ec_nodes_j);
+        if (not isEmpty(set_ops::intersection(g.ic_nodes_i, gain_object.ic_nodes_i)) or not isEmpty(set_ops::intersection(g.ec_nodes_i, gain_object.ec_nodes_j))) {
+            g.ic_nodes_i = set_ops::difference(g.ic_nodes_i, gain_object.ic_nodes_i);
+            g.ec_nodes_i = set_ops::difference(g.ec_nodes_i, gain_object.ec_nodes_j);
             change = true;
         }
 
-        if (not isEmpty(intersection(g.ic_nodes_j, gain_object.ic_nodes_j)) or not isEmpty(intersection(g.ec_nodes_j, gain_object.ec_nodes_i))) {
-            g.ic_nodes_j = difference(g.ic_nodes_j, gain_object.ic_nodes_j);
-            g.ec_nodes_j = difference(g.ec_nodes_j, gain_object.ec_nodes_i);
+        if (not isEmpty(set_ops::intersection(g.ic_nodes_j, gain_object.ic_nodes_j)) or not isEmpty(set_ops::intersection(g.ec_nodes_j, gain_object.ec_nodes_i))) {
+            g.ic_nodes_j = set_ops::difference(g.ic_nodes_j, gain_object.ic_nodes_j);
+            g.ec_nodes_j = set_ops::difference(g.ec_nodes_j, gain_object.ec_nodes_i);
             change = true;
         }
 
@@ -529,8 +696,8 @@ void update_diff(
             // Get communication between a and b
             size_t c_ab = get_c_ab(remaining_partition_a[g.i], remaining_partition_b[g.j], graph.map1(), graph.map2(), graph.get_edge_costs());
 
-            // calculate gain
-            int gain = d_i + d_j - 2 * c_ab;
+            // calculate gain, moved elements are the same so the migration term is too
+            int gain = d_i + d_j - 2 * c_ab - g.migration;
             g.gain = gain;
         }
 
@@ -540,7 +707,7 @@ void update_diff(
     cost_matrix = new_cost_matrix;
 
 #if PARTITION_IMBALANCE_DEBUG
-    logging::sbg_log << remaining_partition_a << ", " << remaining_partition_b << ", " << gain_object << ", " << cost_matrix << endl;
+    logging::kl_log << remaining_partition_a << ", " << remaining_partition_b << ", " << gain_object << ", " << cost_matrix << endl;
 #endif
 }
 
@@ -554,7 +721,7 @@ auto max_diff(M& cost_matrix, SBG::LIB::OrdSet& partition_a, SBG::LIB::OrdSet& p
 
     auto gain_object = *g;
 #if PARTITION_IMBALANCE_DEBUG
-    logging::sbg_log << "The best is " << *g << endl;
+    logging::kl_log << "The best is " << *g << endl;
 #endif
 
     // remove it, we need to update those values that
@@ -570,10 +737,11 @@ void update_sum(
     int& max_par_sum,
     pair<OrdSet, OrdSet>& max_par_sum_set,
     const OrdSet& a_v,
-    const OrdSet& b_v)
+    const OrdSet& b_v,
+    bool feasible)
 {
     par_sum += g;
-    if (par_sum > max_par_sum) {
+    if (feasible and par_sum > max_par_sum) {
         max_par_sum = par_sum;
         max_par_sum_set = make_pair(a_v, b_v);
     }
@@ -584,11 +752,12 @@ int kl_sbg_imbalance(
     const WeightedSBGraph& graph,
     OrdSet& partition_a,
     OrdSet& partition_b,
-    unsigned LMin,
-    unsigned LMax)
+    const PairBounds& bounds,
+    const PairMigration& migration,
+    const PairConstraints& constraints)
 {
 #if PARTITION_IMBALANCE_DEBUG
-    logging::sbg_log << "Algorithm starts with " << partition_a << ", " << partition_b << endl;
+    logging::kl_log << "Algorithm starts with " << partition_a << ", " << partition_b << endl;
 #endif
     auto a_c = partition_a;
     auto b_c = partition_b;
@@ -599,70 +768,87 @@ int kl_sbg_imbalance(
     OrdSet b_v = OrdSet();
     const auto node_weights = graph.get_node_weights();
 
-    CostMatrixImbalance gm = generate_gain_matrix(graph, node_weights, partition_a, partition_b, LMin, LMax);
+    CostMatrixImbalance gm = generate_gain_matrix(graph, node_weights, partition_a, partition_b, bounds, migration);
 
 #if PARTITION_IMBALANCE_DEBUG
-        logging::sbg_log << LMin << ", "
-             << LMax
+        logging::kl_log << bounds.LMin_a << ", " << bounds.LMax_a << ", "
+             << bounds.LMin_b << ", " << bounds.LMax_b
              << gm << endl;
 #endif
 
     while ((not isEmpty(a_c)) and (not isEmpty(b_c))) {
-        logging::sbg_log << "inside the while " << a_c << b_c << endl;
-        logging::sbg_log << gm << endl;
+        logging::kl_log << "inside the while " << a_c << b_c << endl;
+        logging::kl_log << gm << endl;
         GainObjectImbalance g = max_diff(gm, a_c, b_c, graph);
-        logging::sbg_log << g << endl;
+        logging::kl_log << g << endl;
         pair<OrdSet, OrdSet> a_, b_;
         tie(a_, b_) = update_sets(a_c, b_c, a_v, b_v, g, graph);
-        update_diff(gm, a_c, a_v, a_, b_c, b_v, b_, graph, node_weights, g, LMin, LMax);
-        update_sum(par_sum, g.gain, max_par_sum, max_par_sum_set, a_v, b_v);
+        update_diff(gm, a_c, a_v, a_, b_c, b_v, b_, graph, node_weights, g, bounds, migration);
+
+        // the best prefix is the one with the maximum gain among those within the bounds
+        // of the other constraints
+        bool feasible = not constraints.enabled() or satisfies_constraints(
+            constraints,
+            set_ops::cup(set_ops::difference(partition_a, a_v), b_v),
+            set_ops::cup(set_ops::difference(partition_b, b_v), a_v),
+            partition_a,
+            partition_b);
+        update_sum(par_sum, g.gain, max_par_sum, max_par_sum_set, a_v, b_v, feasible);
     }
 
     if (max_par_sum > 0) {
 
-        partition_a = cup(difference(partition_a, max_par_sum_set.first), max_par_sum_set.second);
-        partition_b = cup(difference(partition_b, max_par_sum_set.second), max_par_sum_set.first);
+        partition_a = set_ops::cup(set_ops::difference(partition_a, max_par_sum_set.first), max_par_sum_set.second);
+        partition_b = set_ops::cup(set_ops::difference(partition_b, max_par_sum_set.second), max_par_sum_set.first);
 
         flatten_set(partition_a, graph);
         flatten_set(partition_b, graph);
     }
 
 #if PARTITION_IMBALANCE_DEBUG
-    logging::sbg_log << "so it ends with " << max_par_sum << ", " << partition_a << ", " << partition_b << endl;
+    logging::kl_log << "so it ends with " << max_par_sum << ", " << partition_a << ", " << partition_b << endl;
 #endif
     return max_par_sum;
 }
 
 
 KLBipartResult kl_sbg_bipart_imbalance(const WeightedSBGraph& graph, OrdSet& partition_a,
-    OrdSet& partition_b, unsigned LMin, unsigned LMax)
+    OrdSet& partition_b, const PairBounds& bounds, const PairMigration& migration, const PairConstraints& constraints)
 {
-    int gain = kl_sbg_imbalance(graph, partition_a, partition_b, LMin, LMax);
+    int gain = kl_sbg_imbalance(graph, partition_a, partition_b, bounds, migration, constraints);
 
 #if PARTITION_IMBALANCE_DEBUG
-    logging::sbg_log << "Final: " << partition_a << ", " << partition_b << endl;
+    logging::kl_log << "Final: " << partition_a << ", " << partition_b << endl;
 #endif
 
     return KLBipartResult{partition_a, partition_b, gain};
 }
 
 
+PairBounds pair_bounds(const vector<pair<unsigned, unsigned>>& bounds, size_t i, size_t j)
+{
+    if (bounds.empty()) {
+        return PairBounds();
+    }
+
+    return PairBounds{bounds[i].first, bounds[i].second, bounds[j].first, bounds[j].second};
+}
+
+
 kl_sbg_partitioner_result kl_sbg_partitioner_function(
-    const WeightedSBGraph& graph, PartitionMap& partitions, unsigned LMin, unsigned LMax,
-    vector<kl_sbg_partitioner_result>& gains)
+    const WeightedSBGraph& graph, PartitionMap& partitions, const QuotientGraph& quotient_graph,
+    const vector<pair<unsigned, unsigned>>& bounds, const SwapContext& swap_context, vector<kl_sbg_partitioner_result>& gains)
 {
-    map<size_t, OrdSet> adjacents;
     kl_sbg_partitioner_result best_gain = kl_sbg_partitioner_result{ 0, 0, -1, OrdSet(), OrdSet()};
     for (size_t i = 0; i < partitions.size(); i++) {
-
-        if (adjacents.find(i) == adjacents.end()) {
-            adjacents[i] = get_adjacents(graph, partitions[i]);
-        }
-
         for (size_t j = i + 1; j < partitions.size(); j++) {
 
-            if (isEmpty(intersection(adjacents[i], partitions[j]))) {
-                logging::sbg_log << "No connections between " << partitions[i] << " and " << partitions[j] << " is empty" << endl;
+            if (not quotient_graph.connected(i, j)) {
+                logging::kl_log << "No connections between " << partitions[i] << " and " << partitions[j] << " is empty" << endl;
+                continue;
+            }
+
+            if (not swap_context.can_swap(i, j)) {
                 continue;
             }
 
@@ -672,15 +858,21 @@ kl_sbg_partitioner_result kl_sbg_partitioner_function(
 
             auto gain_it = find_if(gains.begin(), gains.end(), gain_comp);
             if (gain_it != gains.end()) {
-                logging::sbg_log << "Between " << i << " and " << j << " was already computed, " << *gain_it  << endl;
+                logging::kl_log << "Between " << i << " and " << j << " was already computed, " << *gain_it  << endl;
                 continue;
             }
 
+            trace::Span span("kl_bipartition", "kl");
+            span.arg("i", i);
+            span.arg("j", j);
+
             auto p_1_copy = partitions[i];
             auto p_2_copy = partitions[j];
-            KLBipartResult current_gain = kl_sbg_bipart_imbalance(graph, p_1_copy, p_2_copy, LMin, LMax);
+            KLBipartResult current_gain = kl_sbg_bipart_imbalance(
+                graph, p_1_copy, p_2_copy, pair_bounds(bounds, i, j),
+                pair_migration(swap_context, i, j), pair_constraints(swap_context, i, j));
     #if PARTITION_IMBALANCE_DEBUG
-            logging::sbg_log << "current_gain " << current_gain << endl;
+            logging::kl_log << "current_gain " << current_gain << endl;
     #endif
             gains.emplace_back(kl_sbg_partitioner_result{ i, j, current_gain.gain, current_gain.A, current_gain.B });
         }
@@ -697,22 +889,20 @@ kl_sbg_partitioner_result kl_sbg_partitioner_function(
 
 
 kl_sbg_partitioner_result kl_sbg_partitioner_multithreading(
-    const WeightedSBGraph& graph, PartitionMap& partitions, unsigned LMin, unsigned LMax,
-    vector<kl_sbg_partitioner_result>& gains)
+    const WeightedSBGraph& graph, PartitionMap& partitions, const QuotientGraph& quotient_graph,
+    const vector<pair<unsigned, unsigned>>& bounds, const SwapContext& swap_context, vector<kl_sbg_partitioner_result>& gains, unsigned threads)
 {
     kl_sbg_partitioner_result best_gain = kl_sbg_partitioner_result{ 0, 0, -1, OrdSet(), OrdSet()};
-    vector<future<kl_sbg_partitioner_result>> workers;
-    map<size_t, OrdSet> adjacents;
+    vector<pair<size_t, size_t>> pairs;
     for (size_t i = 0; i < partitions.size(); i++) {
-
-        if (adjacents.find(i) == adjacents.end()) {
-            adjacents[i] = get_adjacents(graph, partitions[i]);
-        }
-
         for (size_t j = i + 1; j < partitions.size(); j++) {
 
-            if (isEmpty(intersection(adjacents[i], partitions[j]))) {
-                logging::sbg_log << "No connections between " << partitions[i] << " and " << partitions[j] << " is empty" << endl;
+            if (not quotient_graph.connected(i, j)) {
+                logging::kl_log << "No connections between " << partitions[i] << " and " << partitions[j] << " is empty" << endl;
+                continue;
+            }
+
+            if (not swap_context.can_swap(i, j)) {
                 continue;
             }
 
@@ -722,26 +912,47 @@ kl_sbg_partitioner_result kl_sbg_partitioner_multithreading(
 
             auto gain_it = find_if(gains.begin(), gains.end(), gain_comp);
             if (gain_it != gains.end()) {
-                logging::sbg_log << "Between " << i << " and " << j << " was already computed, " << *gain_it  << endl;
+                logging::kl_log << "Between " << i << " and " << j << " was already computed, " << *gain_it  << endl;
                 continue;
             }
 
-            auto th = async([&graph, &partitions, i, j, LMin, LMax] () {
-                OrdSet p_1_copy = partitions[i];
-                OrdSet p_2_copy = partitions[j];
-                KLBipartResult results = kl_sbg_bipart_imbalance(graph, p_1_copy, p_2_copy, LMin, LMax);
-                return kl_sbg_partitioner_result{i, j, results.gain, results.A, results.B};
-            });
-            workers.push_back(move(th));
+            pairs.emplace_back(i, j);
         }
     }
 
-    for_each(workers.begin(), workers.end(), [&best_gain, &gains] (future<kl_sbg_partitioner_result>& th) {
-        // here we wait for each thread to finish and get its results
-        auto current_gain = th.get();
-        gains.emplace_back(current_gain);
+    // A fixed amount of workers takes the pairs one at a time, results are stored in
+    // the order of the pairs so the chosen swap doesn't depend on scheduling
+    vector<kl_sbg_partitioner_result> results(pairs.size());
+    atomic<size_t> next(0);
+    auto worker = [&graph, &partitions, &pairs, &results, &next, &swap_context, &bounds] () {
+        set_ops::PhaseScope phase(set_ops::Phase::KL);
+        for (size_t p = next++; p < pairs.size(); p = next++) {
+            auto [i, j] = pairs[p];
+            trace::Span span("kl_bipartition", "kl");
+            span.arg("i", i);
+            span.arg("j", j);
+
+            OrdSet p_1_copy = partitions.at(i);
+            OrdSet p_2_copy = partitions.at(j);
+            KLBipartResult result = kl_sbg_bipart_imbalance(
+                graph, p_1_copy, p_2_copy, pair_bounds(bounds, i, j),
+                pair_migration(swap_context, i, j), pair_constraints(swap_context, i, j));
+            results[p] = kl_sbg_partitioner_result{i, j, result.gain, result.A, result.B};
+        }
+    };
+
+    vector<future<void>> workers;
+    for (size_t t = 0; t < min(size_t(threads), pairs.size()); t++) {
+        workers.push_back(async(launch::async, worker));
+    }
+
+    for_each(workers.begin(), workers.end(), [] (future<void>& th) {
+        // here we wait for each thread to finish
+        th.get();
     });
 
+    gains.insert(gains.end(), results.begin(), results.end());
+
     for_each(gains.begin(), gains.end(), [&best_gain] (const kl_sbg_partitioner_result& current_gain) {
         if (current_gain.gain > best_gain.gain) {
             best_gain = current_gain;
@@ -753,25 +964,57 @@ kl_sbg_partitioner_result kl_sbg_partitioner_multithreading(
 
 
 void kl_sbg_imbalance_partitioner(
-    const WeightedSBGraph& graph, PartitionMap& partitions, const float imbalance_epsilon)
+    const WeightedSBGraph& graph, PartitionMap& partitions, const PartitionOptions& options, PartitionStatistics& statistics)
 {
-    auto [LMin, LMax] = imbalance_epsilon > 0.0 ? compute_lmin_lmax(graph, partitions.size(), imbalance_epsilon) : make_pair<unsigned, unsigned>(0, 0);
+    trace::Span span("kl_refinement", "kl");
+    span.arg("partitions", partitions.size());
+    set_ops::PhaseScope phase(set_ops::Phase::KL);
+
+    const float imbalance_epsilon = options.epsilon;
+    const auto bounds = imbalance_epsilon > 0.0
+        ? compute_lmin_lmax(graph, partitions.size(), imbalance_epsilon, options.targets)
+        : vector<pair<unsigned, unsigned>>();
     bool change = true;
     int counter = 0;
 
+    const unsigned threads = options.threads > 0 ? options.threads : max(thread::hardware_concurrency(), 1u);
+    const auto start = chrono::high_resolution_clock::now();
+    auto budget_exhausted = [&options, &counter, &start] () {
+        if (options.max_iterations > 0 and unsigned(counter) >= options.max_iterations) {
+            return true;
+        }
+
+        auto elapsed = chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start).count();
+        return options.time_budget > 0 and elapsed >= options.time_budget;
+    };
+
+    // Connections between partitions, it is updated each time a pair of partitions changes
+    QuotientGraph quotient_graph(graph, partitions);
+
+    const SwapContext swap_context = make_swap_context(graph, partitions.size(), options);
+
     vector<kl_sbg_partitioner_result> gains;
     while (change) {
-        cout << "*****ITERATION NUMBER " << counter++ << endl;
+        if (budget_exhausted()) {
+            logging::kl_log << "KL budget exhausted after " << counter << " iterations" << endl;
+            statistics.budget_exhausted = true;
+            break;
+        }
+
+        trace::Span iteration_span("kl_iteration", "kl");
+        iteration_span.arg("iteration", counter);
+
+        logging::kl_log(logging::Level::INFO) << "KL iteration " << counter++ << endl;
         change = false;
 
         kl_sbg_partitioner_result best_gain;
-        if (multithreading_enabled) {
-            best_gain = kl_sbg_partitioner_multithreading(graph, partitions, LMin, LMax, gains);
+        if (threads > 1) {
+            best_gain = kl_sbg_partitioner_multithreading(graph, partitions, quotient_graph, bounds, swap_context, gains, threads);
         } else {
-            best_gain = kl_sbg_partitioner_function(graph, partitions, LMin, LMax, gains);
+            best_gain = kl_sbg_partitioner_function(graph, partitions, quotient_graph, bounds, swap_context, gains);
         }
 
-        logging::sbg_log << "Best gain results is: " << best_gain << endl;
+        logging::kl_log << "Best gain results is: " << best_gain << endl;
 
         auto gain_comp = [&best_gain](const kl_sbg_partitioner_result& g) {
             return g.i == best_gain.i or g.j == best_gain.j
@@ -788,6 +1031,7 @@ void kl_sbg_imbalance_partitioner(
                 change = true;
                 partitions[best_gain.i] = best_gain.A;
                 partitions[best_gain.j] = best_gain.B;
+                quotient_graph.update(partitions, best_gain.i, best_gain.j);
 
                 gains.erase(std::remove_if(gains.begin(), gains.end(), gain_comp), gains.end());
             }
@@ -797,20 +1041,21 @@ void kl_sbg_imbalance_partitioner(
 
             int it_counter = 0;
             while (not gains.empty() and best_gain.gain > 0) {
-                logging::sbg_log << "change number " << it_counter << " changing " << best_gain.i << ", " << best_gain.j << endl;
+                logging::kl_log << "change number " << it_counter << " changing " << best_gain.i << ", " << best_gain.j << endl;
                 it_counter++;
                 change = true;
                 partitions[best_gain.i] = best_gain.A;
                 partitions[best_gain.j] = best_gain.B;
+                quotient_graph.update(partitions, best_gain.i, best_gain.j);
 
                 gains.erase(std::remove_if(gains.begin(), gains.end(), gain_comp), gains.end());
 
-                logging::sbg_log << "best gain is " << best_gain << endl;
-                logging::sbg_log << "and vector is ";
-                #ifdef SBG_PARTITIONER_LOGGING
-                for_each(gains.begin(), gains.end(), [](const kl_sbg_partitioner_result& g) { logging::sbg_log << g << " "; });
-                #endif
-                logging::sbg_log << endl;
+                logging::kl_log << "best gain is " << best_gain << endl;
+                if (logging::enabled(logging::Category::KL, logging::Level::TRACE)) {
+                    auto message = logging::kl_log(logging::Level::TRACE);
+                    message << "and vector is ";
+                    for_each(gains.begin(), gains.end(), [&message](const kl_sbg_partitioner_result& g) { message << g << " "; });
+                }
 
                 if (not gains.empty()){
                     auto max_gain_it = max_element(gains.begin(), gains.end(),
@@ -829,12 +1074,28 @@ void kl_sbg_imbalance_partitioner(
         }
     }
 
+    statistics.iterations = counter;
+    statistics.edge_cut = quotient_graph.edge_cut();
+
     for (size_t i = 0; i < partitions.size(); i++) {
         SBG_LOG << i << ": " << partitions[i] << endl;
     }
 }
 
 
+void kl_sbg_imbalance_partitioner(
+    const WeightedSBGraph& graph, PartitionMap& partitions, const float imbalance_epsilon)
+{
+    PartitionOptions options;
+    options.number_of_partitions = partitions.size();
+    options.epsilon = imbalance_epsilon;
+    options.threads = multithreading_enabled ? 0 : 1;
+
+    PartitionStatistics statistics;
+    kl_sbg_imbalance_partitioner(graph, partitions, options, statistics);
+}
+
+
 string get_pretty_sb_graph(const SBG::LIB::CanonSBG& g)
 {
     rapidjson::Document json_doc;
@@ -947,20 +1208,57 @@ string partitionate_nodes(
     optional<string>& graph_str,
     long double& time_to_build_graph,
     long double& time_to_partitionate)
+{
+    WeightedSBGraph sb_graph;
+    PartitionMap partitions;
+    partitionate_nodes(filename, number_of_partitions, epsilon, graph_str, sb_graph, partitions, time_to_build_graph, time_to_partitionate);
+
+    string output = get_output(partitions);
+
+    return output;
+}
+
+
+void partitionate_nodes(
+    const std::string& filename,
+    const unsigned number_of_partitions,
+    const float epsilon,
+    optional<string>& graph_str,
+    WeightedSBGraph& sb_graph,
+    PartitionMap& partitions,
+    long double& time_to_build_graph,
+    long double& time_to_partitionate,
+    const CostProfile& profile,
+    const vector<float>& targets)
 {
     auto start_build_graph = chrono::high_resolution_clock::now();
-    auto sb_graph = build_sb_graph(filename.c_str());
+    {
+        memory_usage::PhaseScope phase("build_graph");
+        sb_graph = build_sb_graph(filename, profile);
+    }
     auto end_build_graph = chrono::high_resolution_clock::now();
     time_to_build_graph = chrono::duration<double, std::milli>(end_build_graph - start_build_graph).count();
 
-    logging::sbg_log << sb_graph << endl;
-    logging::sbg_log << "sb graph created!" << endl;
+    logging::kl_log << sb_graph << endl;
+    logging::kl_log << "sb graph created!" << endl;
 
     auto start_partitionate = chrono::high_resolution_clock::now();
 
-    auto partitions = best_initial_partition(sb_graph, number_of_partitions);
+    {
+        memory_usage::PhaseScope phase("initial_partition");
+        partitions = best_initial_partition(sb_graph, number_of_partitions, nullptr, targets);
+    }
 
-    kl_sbg_imbalance_partitioner(sb_graph, partitions, epsilon);
+    PartitionOptions options;
+    options.number_of_partitions = number_of_partitions;
+    options.epsilon = epsilon;
+    options.threads = multithreading_enabled ? 0 : 1;
+    options.targets = targets;
+    PartitionStatistics statistics;
+    {
+        memory_usage::PhaseScope phase("refinement");
+        kl_sbg_imbalance_partitioner(sb_graph, partitions, options, statistics);
+    }
 
     auto end_partitionate = chrono::high_resolution_clock::now();
     time_to_partitionate = chrono::duration<double, std::milli>(end_partitionate - start_partitionate).count();
@@ -970,10 +1268,212 @@ string partitionate_nodes(
     if (graph_str){
         graph_str = get_pretty_sb_graph(sb_graph);
     }
+}
 
-    string output = get_output(partitions);
 
-    return output;
+map<unsigned, PartitionMap> partitionate_nodes(
+    const string& filename,
+    const vector<unsigned>& numbers_of_partitions,
+    const float epsilon,
+    optional<string>& graph_str,
+    WeightedSBGraph& sb_graph,
+    long double& time_to_build_graph,
+    long double& time_to_partitionate,
+    const CostProfile& profile,
+    const vector<float>& targets)
+{
+    auto start_build_graph = chrono::high_resolution_clock::now();
+    {
+        memory_usage::PhaseScope phase("build_graph");
+        sb_graph = build_sb_graph(filename, profile);
+    }
+    auto end_build_graph = chrono::high_resolution_clock::now();
+    time_to_build_graph = chrono::duration<double, std::milli>(end_build_graph - start_build_graph).count();
+
+    logging::kl_log << sb_graph << endl;
+    logging::kl_log << "sb graph created!" << endl;
+
+    auto start_partitionate = chrono::high_resolution_clock::now();
+    // initial partitions and refinements of different k overlap, so they are a single phase
+    optional<memory_usage::PhaseScope> partition_phase;
+    partition_phase.emplace("partition");
+
+    // The adjacency only depends on the graph, so every search shares it
+    const auto adjacency = search::make_adjacency(sb_graph);
+
+    // Each k takes a worker, and KL threads are split among the workers
+    const unsigned hardware_threads = max(thread::hardware_concurrency(), 1u);
+    const size_t workers_size = multithreading_enabled ? min(size_t(hardware_threads), numbers_of_partitions.size()) : 1;
+    const unsigned kl_threads = multithreading_enabled ? max(hardware_threads / unsigned(numbers_of_partitions.size()), 1u) : 1;
+
+    vector<PartitionMap> results(numbers_of_partitions.size());
+    atomic<size_t> next(0);
+    auto worker = [&] () {
+        for (size_t i = next++; i < numbers_of_partitions.size(); i = next++) {
+            const unsigned number_of_partitions = numbers_of_partitions[i];
+            const auto& partition_targets = targets.size() == number_of_partitions ? targets : vector<float>();
+            PartitionMap partitions = best_initial_partition(sb_graph, number_of_partitions, adjacency, partition_targets);
+
+            PartitionOptions options;
+            options.number_of_partitions = number_of_partitions;
+            options.epsilon = epsilon;
+            options.threads = kl_threads;
+            options.targets = partition_targets;
+            PartitionStatistics statistics;
+            kl_sbg_imbalance_partitioner(sb_graph, partitions, options, statistics);
+
+            sanity_check(sb_graph, partitions, number_of_partitions);
+
+            results[i] = move(partitions);
+        }
+    };
+
+    vector<future<void>> workers;
+    for (size_t t = 0; t < workers_size; t++) {
+        workers.push_back(async(launch::async, worker));
+    }
+
+    for_each(workers.begin(), workers.end(), [] (future<void>& th) { th.get(); });
+    partition_phase.reset();
+
+    auto end_partitionate = chrono::high_resolution_clock::now();
+    time_to_partitionate = chrono::duration<double, std::milli>(end_partitionate - start_partitionate).count();
+
+    map<unsigned, PartitionMap> partitions;
+    for (size_t i = 0; i < numbers_of_partitions.size(); i++) {
+        partitions[numbers_of_partitions[i]] = move(results[i]);
+    }
+
+    if (graph_str){
+        graph_str = get_pretty_sb_graph(sb_graph);
+    }
+
+    return partitions;
+}
+
+
+PartitionResult partitionate_graph(const WeightedSBGraph& graph, const PartitionOptions& options)
+{
+    PartitionResult result;
+    PartitionStatistics& statistics = result.statistics;
+
+    auto start_partitionate = chrono::high_resolution_clock::now();
+    result.partitions = initial_partition(graph, options.number_of_partitions, options.strategy, options.targets);
+    auto end_partitionate = chrono::high_resolution_clock::now();
+    statistics.time_to_initial_partition = chrono::duration<double, std::milli>(end_partitionate - start_partitionate).count();
+
+    kl_sbg_imbalance_partitioner(graph, result.partitions, options, statistics);
+    auto end_refine = chrono::high_resolution_clock::now();
+    statistics.time_to_refine = chrono::duration<double, std::milli>(end_refine - end_partitionate).count();
+
+    sanity_check(graph, result.partitions, options.number_of_partitions);
+
+    compute_balance(graph, result.partitions, statistics, options.targets);
+
+    return result;
+}
+
+
+void compute_balance(
+    const WeightedSBGraph& graph, const PartitionMap& partitions, PartitionStatistics& statistics, const vector<float>& targets)
+{
+    const auto fractions = target_fractions(targets, partitions.size());
+
+    // imbalance as metrics::maximum_imbalance computes it
+    auto imbalance = [&graph, &partitions, &targets, &fractions] (const NodeWeight& node_weights, vector<unsigned>& weights) {
+        const unsigned total_weight = get_node_size(graph.V(), node_weights);
+        float maximum_imbalance = 0;
+        for (const auto& [i, partition] : partitions) {
+            float expected_weight = targets.empty() ? float(total_weight) / partitions.size() : total_weight * fractions[i];
+            unsigned weight = get_node_size(partition, node_weights);
+            weights.push_back(weight);
+            maximum_imbalance = max(maximum_imbalance, abs(expected_weight - weight) / expected_weight);
+        }
+
+        return maximum_imbalance;
+    };
+
+    statistics.weights.clear();
+    statistics.maximum_imbalance = imbalance(graph.get_node_weights(), statistics.weights);
+
+    statistics.constraint_imbalance.clear();
+    for (const auto& node_weights : graph.get_constraint_weights()) {
+        vector<unsigned> weights;
+        statistics.constraint_imbalance.push_back(imbalance(node_weights, weights));
+    }
+}
+
+
+void refine_partition(const WeightedSBGraph& graph, PartitionMap& partitions, const float epsilon)
+{
+    logging::kl_log << "refining initial partition " << partitions << endl;
+
+    kl_sbg_imbalance_partitioner(graph, partitions, epsilon);
+
+    sanity_check(graph, partitions, partitions.size());
+}
+
+
+void refine_partition(
+    const WeightedSBGraph& graph, PartitionMap& partitions, const PartitionOptions& options, PartitionStatistics& statistics)
+{
+    auto start_refine = chrono::high_resolution_clock::now();
+    kl_sbg_imbalance_partitioner(graph, partitions, options, statistics);
+    auto end_refine = chrono::high_resolution_clock::now();
+    statistics.time_to_refine = chrono::duration<double, std::milli>(end_refine - start_refine).count();
+
+    sanity_check(graph, partitions, partitions.size());
+}
+
+
+bool refine_partition(
+    const string& filename,
+    const string& initial_partition_filename,
+    const float epsilon,
+    optional<string>& graph_str,
+    WeightedSBGraph& sb_graph,
+    PartitionMap& partitions,
+    long double& time_to_build_graph,
+    long double& time_to_partitionate,
+    const CostProfile& profile,
+    const vector<float>& targets)
+{
+    auto start_build_graph = chrono::high_resolution_clock::now();
+    {
+        memory_usage::PhaseScope phase("build_graph");
+        sb_graph = build_sb_graph(filename, profile);
+    }
+    auto end_build_graph = chrono::high_resolution_clock::now();
+    time_to_build_graph = chrono::duration<double, std::milli>(end_build_graph - start_build_graph).count();
+
+    logging::kl_log << sb_graph << endl;
+    logging::kl_log << "sb graph created!" << endl;
+
+    if (not read_partition(initial_partition_filename, sb_graph, partitions)) {
+        return false;
+    }
+
+    auto start_partitionate = chrono::high_resolution_clock::now();
+
+    PartitionOptions options;
+    options.number_of_partitions = partitions.size();
+    options.epsilon = epsilon;
+    options.threads = multithreading_enabled ? 0 : 1;
+    options.targets = targets.size() == partitions.size() ? targets : vector<float>();
+    PartitionStatistics statistics;
+    {
+        memory_usage::PhaseScope phase("refinement");
+        refine_partition(sb_graph, partitions, options, statistics);
+    }
+
+    auto end_partitionate = chrono::high_resolution_clock::now();
+    time_to_partitionate = chrono::duration<double, std::milli>(end_partitionate - start_partitionate).count();
+
+    if (graph_str){
+        graph_str = get_pretty_sb_graph(sb_graph);
+    }
+
+    return true;
 }
 
 
@@ -985,8 +1485,8 @@ pair<WeightedSBGraph, PartitionMap> partitionate_nodes_for_metrics(
     auto sb_graph = build_sb_graph(filename.c_str());
     // auto sb_graph = create_air_conditioners_graph();
 
-    logging::sbg_log << sb_graph << endl;
-    logging::sbg_log << "sb graph created!" << endl;
+    logging::kl_log << sb_graph << endl;
+    logging::kl_log << "sb graph created!" << endl;
 
     auto partitions = best_initial_partition(sb_graph, number_of_partitions);
 
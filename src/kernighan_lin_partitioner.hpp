@@ -18,12 +18,86 @@
 
 #pragma once
 
+#include <map>
+#include <optional>
 #include <string>
+#include <vector>
 
+#include "cost_profile.hpp"
 #include "partition_graph.hpp"
 
 namespace sbg_partitioner {
 
+/// Options of partitionate_graph.
+struct PartitionOptions {
+    unsigned number_of_partitions = 2;
+
+    /// Imbalance epsilon, a value between 0 and 1.
+    float epsilon = 0.0;
+
+    /// Strategy used by the DFS to make the initial partition.
+    PartitionAlgorithm strategy = DISTRIBUTED;
+
+    /// Threads used to compute the gains of each pair of partitions, 0 means all the
+    /// hardware threads and 1 computes them sequentially.
+    unsigned threads = 0;
+
+    /// Budget of the KL refinement, it stops after this amount of iterations or once
+    /// this time (in ms) is elapsed, even if the partition can still be improved.
+    /// 0 means no limit.
+    unsigned max_iterations = 0;
+    double time_budget = 0;
+
+    /// Partition the graph had before its weights changed, see repartition. If it is set,
+    /// the gain of a swap is reduced by migration_cost for each element it moves away from
+    /// its previous partition, and increased for each element it moves back to it.
+    /// @note it should live while the partitioning runs
+    const PartitionMap* previous_partition = nullptr;
+    float migration_cost = 0;
+
+    /// Relative target weight of each partition, e.g. the speed of the core each one runs
+    /// on, so {1, 1, 2, 2} gives twice the load to the last two partitions. Epsilon bounds
+    /// are applied around each target. Empty means the same target for every partition.
+    std::vector<float> targets;
+
+    /// Block of each partition, e.g. the node of each core. If it is set, KL only swaps
+    /// elements between partitions of the same block, so the edge cut between blocks is
+    /// kept. Empty means any pair of partitions can swap.
+    std::vector<unsigned> blocks;
+};
+
+
+struct PartitionStatistics {
+    long double time_to_initial_partition = 0;  // ms, initial partition
+    long double time_to_refine = 0;             // ms, KL refinement
+    unsigned iterations = 0;               // KL iterations
+    bool budget_exhausted = false;         // KL stopped before converging
+    unsigned edge_cut = 0;
+    std::vector<unsigned> weights;         // sum of node weights of each partition
+    float maximum_imbalance = 0;
+    std::vector<float> constraint_imbalance;  // maximum imbalance of each other constraint
+};
+
+
+struct PartitionResult {
+    PartitionMap partitions;
+    PartitionStatistics statistics;
+};
+
+
+/// Partitions an sb graph that is already in memory, without reading nor writing any file.
+/// If graph has several balance constraints, each one is kept within its own bounds.
+PartitionResult partitionate_graph(const WeightedSBGraph& graph, const PartitionOptions& options);
+
+
+/// Fills the weights, maximum_imbalance and constraint_imbalance of statistics. Imbalance
+/// is measured against the target weight of each partition (see PartitionOptions::targets).
+void compute_balance(
+    const WeightedSBGraph& graph,
+    const PartitionMap& partitions,
+    PartitionStatistics& statistics,
+    const std::vector<float>& targets = std::vector<float>());
+
 
 std::string partitionate_nodes(
     const std::string& filename,
@@ -40,6 +114,90 @@ std::string partitionate_nodes(
     long double& time_to_partitionate);
 
 
+/// Same as above, but the resulting partition is returned in partitions instead of
+/// its json representation, along with the sb graph it was computed from. If profile is
+/// not empty, node weights are taken from it (see build_sb_graph), and targets are the
+/// relative target weights of the partitions (see PartitionOptions::targets).
+/// time_to_partitionate covers both the initial partition and the KL refinement, while
+/// PartitionStatistics times them apart.
+void partitionate_nodes(
+    const std::string& filename,
+    const unsigned number_of_partitions,
+    const float epsilon,
+    std::optional<std::string>& graph_str,
+    WeightedSBGraph& sb_graph,
+    PartitionMap& partitions,
+    long double& time_to_build_graph,
+    long double& time_to_partitionate,
+    const CostProfile& profile = CostProfile(),
+    const std::vector<float>& targets = std::vector<float>());
+
+
+/// Partitions the graph of filename once for each number of partitions, e.g. to sweep k.
+/// The sb graph and the DFS adjacency are built only once, and the partitions for the
+/// different numbers of partitions are computed in parallel.
+/// time_to_partitionate is the wall time of all of them. targets are only used for the
+/// number of partitions they have a target for.
+std::map<unsigned, PartitionMap> partitionate_nodes(
+    const std::string& filename,
+    const std::vector<unsigned>& numbers_of_partitions,
+    const float epsilon,
+    std::optional<std::string>& graph_str,
+    WeightedSBGraph& sb_graph,
+    long double& time_to_build_graph,
+    long double& time_to_partitionate,
+    const CostProfile& profile = CostProfile(),
+    const std::vector<float>& targets = std::vector<float>());
+
+
+/// Refines partitions, an existing partition of graph, e.g. of a classic partitioner or
+/// of a previous run, with KL. The initial partitioning is skipped.
+void refine_partition(const WeightedSBGraph& graph, PartitionMap& partitions, const float epsilon);
+
+
+/// Same as above, with the KL options of partitionate_graph. Only the refinement fields of
+/// statistics are filled.
+void refine_partition(
+    const WeightedSBGraph& graph, PartitionMap& partitions, const PartitionOptions& options, PartitionStatistics& statistics);
+
+
+/// Same as partitionate_nodes, but it starts from the partition read from
+/// initial_partition_filename (see read_partition) instead of computing one.
+/// Returns false if the initial partition can not be read.
+bool refine_partition(
+    const std::string& filename,
+    const std::string& initial_partition_filename,
+    const float epsilon,
+    std::optional<std::string>& graph_str,
+    WeightedSBGraph& sb_graph,
+    PartitionMap& partitions,
+    long double& time_to_build_graph,
+    long double& time_to_partitionate,
+    const CostProfile& profile = CostProfile(),
+    const std::vector<float>& targets = std::vector<float>());
+
+
+/// Cost of the edges between the nodes a and b, in either direction. map_1 and map_2 are
+/// the maps of the graph, e.g. CanonSBG::map1() and CanonSBG::map2().
+size_t get_c_ab(
+    const SBG::LIB::OrdSet& a,
+    const SBG::LIB::OrdSet& b,
+    const SBG::LIB::CanonPWMap& map_1,
+    const SBG::LIB::CanonPWMap& map_2,
+    const EdgeCost& costs);
+
+
+/// Returns the external and the internal edges of nodes, that is, the edges of map_1 from
+/// nodes whose other end, by map_2, is in partition_2 and in the rest of partition. The
+/// KL gain of moving nodes is computed from their costs.
+std::pair<SBG::LIB::OrdSet, SBG::LIB::OrdSet> compute_EC_IC(
+    const SBG::LIB::OrdSet& partition,
+    const SBG::LIB::OrdSet& nodes,
+    const SBG::LIB::OrdSet& partition_2,
+    const SBG::LIB::CanonPWMap& map_1,
+    const SBG::LIB::CanonPWMap& map_2);
+
+
 std::pair<WeightedSBGraph, PartitionMap> partitionate_nodes_for_metrics(
     const std::string& filename,
     const unsigned number_of_partitions,
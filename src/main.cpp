@@ -17,15 +17,28 @@
 
  ******************************************************************************/
 
+#include <algorithm>
+#include <cassert>
 #include <chrono>
+#include <csignal>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "hierarchical_partition.hpp"
 #include "kernighan_lin_partitioner.hpp"
+#include "memory_usage.hpp"
+#include "owner_vector.hpp"
+#include "partition_server.hpp"
+#include "process_mapping.hpp"
+#include "repartition.hpp"
 #include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+#include "trace.hpp"
 
 
 using namespace std;
@@ -38,15 +51,123 @@ void usage()
   cout << endl;
   cout << "-f, --filename   Path to the input file, a json file that represents "
           "the model we want to partitionate." << endl;
-  cout << "-p, --partitions Number of partitions." << endl;
+  cout << "-p, --partitions Number of partitions. It can be a list, 2,4,8, or a range, 2:64 or 2:64:2," << endl;
+  cout << "                 and then each output file name gets a _<k> suffix. At most 65536." << endl;
+  cout << "-i, --initial-partition" << endl;
+  cout << "                 Refine this partition instead of computing an initial one: a json (-g)" << endl;
+  cout << "                 or binary (-b) output, or one partition per element and line (e.g. Metis)." << endl;
+  cout << "                 The number of partitions is taken from it." << endl;
+  cout << "-r, --repartition" << endl;
+  cout << "                 Previous partition of the model, before its weights changed. It is" << endl;
+  cout << "                 rebalanced moving as few elements as possible, see --migration-cost." << endl;
+  cout << "-d, --moves-file Output file path of the elements that moved from the previous partition (-r)." << endl;
+  cout << "--migration-cost KL gain lost for each element that leaves its previous partition (-r), 1 by default." << endl;
+  cout << "-c, --cost-profile" << endl;
+  cout << "                 Measured cost of each equation range (csv id,begin,end,cost or json)," << endl;
+  cout << "                 used as node weights instead of the weights of the model." << endl;
+  cout << "-H, --hierarchy  NxC, partition for N nodes of C cores each, e.g. 4x16. The edge cut" << endl;
+  cout << "                 between nodes is minimized first, and then each node is split in cores." << endl;
+  cout << "                 -e bounds the cores, see --node-epsilon, and -t the nodes." << endl;
+  cout << "--node-epsilon   Imbalance epsilon of the nodes (-H), -e by default." << endl;
+  cout << "-t, --targets    Relative target weight of each partition, e.g. 1,1,2,2 for two cores twice" << endl;
+  cout << "                 as fast as the others, or a file with one value per line." << endl;
+  cout << "-m, --topology   Machine topology, partitions are renumbered so the ones that communicate" << endl;
+  cout << "                 the most are on close ranks. A \"name arity cost\" line for each level," << endl;
+  cout << "                 from the innermost one. It can not be used with -H nor -r, whose node" << endl;
+  cout << "                 and core numbers and moves refer to the partition numbers." << endl;
+  cout << "--trace          Write a Chrome trace of the partitioning stages to this file." << endl;
+  cout << "--set-ops-stats  Print the calls, time and operand sizes of the set operations of each stage." << endl;
+  cout << "--memory-stats   Print the time, RSS, peak RSS and heap allocations of each stage." << endl;
+  cout << "--log-level      Level of the log messages, error, warning (default), info, debug or trace," << endl;
+  cout << "                 and then levels by category, e.g. info,kl=debug. The categories are" << endl;
+  cout << "                 general, build, dfs, strategy, kl, repartition and service." << endl;
+  cout << "--log-file       Write the log messages to this file instead of the standard output." << endl;
   cout << "-h, --help       Display this information and exit." << endl;
   cout << "-v, --version    Display version information and exit." << endl;
   cout << "-g               Output file path." << endl;
+  cout << "-b               Binary output file path, see partition_binary_format.hpp." << endl;
+  cout << "-w               Owner vector file path, the partition of each element as a raw array." << endl;
+  cout << "-W               Owner vector width in bits: 8, 16 or 32 (default)." << endl;
   cout << "-e               Imbalance epsilon, a value between 0 and 1." << endl;
+  cout << "-s, --serve      Run as a service listening on this Unix domain socket, -f and -p" << endl;
+  cout << "                 are given by each request instead." << endl;
+  cout << "--cache-size     Number of sb graphs the service keeps in memory, 16 by default." << endl;
   cout << endl;
   cout << "SBG Partitioner home page: https://github.com/CIFASIS/sbg-partitioner " << endl;
 }
 
+namespace {
+
+PartitionServer* running_server = nullptr;
+
+
+/// Parses the -H argument, NxC. Returns false if it is not valid.
+bool parse_hierarchy(const string& arg, pair<unsigned, unsigned>& hierarchy)
+{
+  istringstream input(arg);
+  char separator;
+  if (not (input >> hierarchy.first >> separator >> hierarchy.second) or separator != 'x') {
+    return false;
+  }
+  input >> ws;
+
+  return input.eof() and hierarchy.first > 0 and hierarchy.second > 0;
+}
+
+
+/// Parses the -t argument: a comma separated list of positive values, or a file with
+/// one value per line. Returns false if it is not valid.
+bool parse_targets(const string& arg, vector<float>& targets)
+{
+  ifstream file(arg);
+  istringstream list(arg);
+  istream& input = file.is_open() ? static_cast<istream&>(file) : list;
+  const char separator = file.is_open() ? '\n' : ',';
+
+  string item;
+  while (getline(input, item, separator)) {
+    if (file.is_open() and item.find_first_not_of(" \t\r") == string::npos) {
+      continue;
+    }
+
+    istringstream value(item);
+    float target;
+    if (not (value >> target) or target <= 0) {
+      return false;
+    }
+    value >> ws;
+    if (not value.eof()) {
+      return false;
+    }
+    targets.push_back(target);
+  }
+
+  return not targets.empty();
+}
+
+
+/// Adds _<k> to filename, before its extension if it has one.
+string with_partitions_suffix(const string& filename, unsigned number_of_partitions)
+{
+  const string suffix = "_" + to_string(number_of_partitions);
+  size_t dot = filename.find_last_of('.');
+  size_t slash = filename.find_last_of('/');
+  if (dot == string::npos or (slash != string::npos and dot < slash)) {
+    return filename + suffix;
+  }
+
+  return filename.substr(0, dot) + suffix + filename.substr(dot);
+}
+
+void stop_server(int)
+{
+  if (running_server != nullptr) {
+    running_server->stop();
+  }
+}
+
+}
+
 void version()
 {
   cout << "SBG Partitioner 1.0.0" << endl;
@@ -60,24 +181,60 @@ int main(int argc, char** argv)
 {
   int opt;
   optional<string> filename = nullopt;
-  optional<unsigned> number_of_partitions = nullopt;
+  optional<vector<unsigned>> numbers_of_partitions = nullopt;
+  optional<string> initial_partition_file = nullopt;
   optional<string> output_file;
+  optional<string> binary_output_file = nullopt;
+  optional<string> owner_vector_file = nullopt;
+  unsigned owner_vector_width = 32;
   optional<string> output_sb_graph = nullopt;
   optional<float> epsilon = nullopt;
+  optional<string> socket_path = nullopt;
+  optional<string> previous_partition_file = nullopt;
+  optional<string> moves_file = nullopt;
+  float migration_cost = 1.0;
+  optional<string> cost_profile_file = nullopt;
+  vector<float> targets;
+  optional<pair<unsigned, unsigned>> hierarchy = nullopt;
+  optional<float> node_epsilon = nullopt;
+  optional<string> topology_file = nullopt;
+  optional<string> trace_file = nullopt;
+  bool set_ops_stats = false;
+  bool memory_stats = false;
+  size_t cache_size = 16;
 
   while (true) {
 
     static struct option long_options[] = {
       {"filename", required_argument, 0, 'f'},
       {"partitions", required_argument, 0, 'p'},
+      {"initial-partition", required_argument, 0, 'i'},
       {"output-file", required_argument, 0, 'g'},
+      {"binary-output-file", required_argument, 0, 'b'},
+      {"owner-vector-file", required_argument, 0, 'w'},
+      {"owner-vector-width", required_argument, 0, 'W'},
       {"output-graph", required_argument, 0, 'o'},
+      {"serve", required_argument, 0, 's'},
+      {"cache-size", required_argument, 0, 'C'},
+      {"repartition", required_argument, 0, 'r'},
+      {"moves-file", required_argument, 0, 'd'},
+      {"migration-cost", required_argument, 0, 'M'},
+      {"cost-profile", required_argument, 0, 'c'},
+      {"targets", required_argument, 0, 't'},
+      {"hierarchy", required_argument, 0, 'H'},
+      {"node-epsilon", required_argument, 0, 'E'},
+      {"topology", required_argument, 0, 'm'},
+      {"trace", required_argument, 0, 'T'},
+      {"set-ops-stats", no_argument, 0, 'O'},
+      {"memory-stats", no_argument, 0, 'A'},
+      {"log-level", required_argument, 0, 'L'},
+      {"log-file", required_argument, 0, 'F'},
       {"version", no_argument, 0, 'v'},
       {"help", no_argument, 0, 'h'}
     };
 
     int option_index = 0;
-    opt = getopt_long(argc, argv, "f:p:e:o:g:vh:", long_options, &option_index);
+    opt = getopt_long(argc, argv, "f:p:i:e:o:g:b:w:W:s:r:d:c:t:H:m:vh:", long_options, &option_index);
     if (opt == EOF) break;
 
     switch (opt) {
@@ -89,7 +246,18 @@ int main(int argc, char** argv)
 
     case 'p':
       if (optarg) {
-        number_of_partitions = atoi(optarg);
+        numbers_of_partitions = vector<unsigned>();
+        if (not parse_partitions(optarg, *numbers_of_partitions)) {
+          cerr << "Invalid number of partitions " << optarg << ", they should be between 1 and " << max_number_of_partitions << endl;
+          usage();
+          exit(1);
+        }
+      }
+      break;
+
+    case 'i':
+      if (optarg) {
+        initial_partition_file = string(optarg);
       }
       break;
 
@@ -105,12 +273,132 @@ int main(int argc, char** argv)
     }
     break;
 
+    case 'b':
+    if (optarg){
+      binary_output_file = string(optarg);
+    }
+    break;
+
+    case 'w':
+    if (optarg){
+      owner_vector_file = string(optarg);
+    }
+    break;
+
+    case 'W':
+    if (optarg){
+      owner_vector_width = atoi(optarg);
+    }
+    break;
+
     case 'e':
     if (optarg) {
       epsilon = atof(optarg);
     }
     break;
 
+    case 's':
+    if (optarg) {
+      socket_path = string(optarg);
+    }
+    break;
+
+    case 'C':
+    if (optarg) {
+      cache_size = atoi(optarg);
+    }
+    break;
+
+    case 'r':
+    if (optarg) {
+      previous_partition_file = string(optarg);
+    }
+    break;
+
+    case 'd':
+    if (optarg) {
+      moves_file = string(optarg);
+    }
+    break;
+
+    case 'M':
+    if (optarg) {
+      migration_cost = atof(optarg);
+    }
+    break;
+
+    case 'c':
+    if (optarg) {
+      cost_profile_file = string(optarg);
+    }
+    break;
+
+    case 't':
+    if (optarg) {
+      if (not parse_targets(optarg, targets)) {
+        cerr << "Invalid targets " << optarg << endl;
+        usage();
+        exit(1);
+      }
+    }
+    break;
+
+    case 'H':
+    if (optarg) {
+      hierarchy = pair<unsigned, unsigned>();
+      if (not parse_hierarchy(optarg, *hierarchy)) {
+        cerr << "Invalid hierarchy " << optarg << endl;
+        usage();
+        exit(1);
+      }
+    }
+    break;
+
+    case 'E':
+    if (optarg) {
+      node_epsilon = atof(optarg);
+    }
+    break;
+
+    case 'm':
+    if (optarg) {
+      topology_file = string(optarg);
+    }
+    break;
+
+    case 'T':
+    if (optarg) {
+      trace_file = string(optarg);
+    }
+    break;
+
+    case 'O':
+      set_ops_stats = true;
+      break;
+
+    case 'A':
+      memory_stats = true;
+      break;
+
+    case 'L':
+    if (optarg) {
+      if (not logging::configure(optarg)) {
+        cerr << "Invalid log level " << optarg << endl;
+        usage();
+        exit(1);
+      }
+    }
+    break;
+
+    case 'F':
+    if (optarg) {
+      if (not logging::set_output(optarg)) {
+        cerr << "Unable to open log file " << optarg << endl;
+        exit(1);
+      }
+    }
+    break;
+
     case 'v':
       version();
       exit(0);
@@ -129,35 +417,194 @@ int main(int argc, char** argv)
     }
   }
 
-  if (not filename or not number_of_partitions) {
+  if (trace_file) {
+    trace::enable();
+  }
+
+  if (set_ops_stats) {
+    set_ops::enable_counters();
+  }
+
+  if (memory_stats) {
+    memory_usage::enable_report();
+  }
+
+  if (socket_path) {
+    PartitionServer server(*socket_path, cache_size);
+    running_server = &server;
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+
+    bool ok = server.run();
+    running_server = nullptr;
+
+    if (trace_file and not trace::write_trace(*trace_file)) {
+      cerr << "Unable to write trace file " << *trace_file << endl;
+      ok = false;
+    }
+
+    if (set_ops_stats) {
+      set_ops::print_counters(cout);
+    }
+
+    logging::flush();
+
+    return ok ? 0 : 1;
+  }
+
+  if (not filename or (not numbers_of_partitions and not initial_partition_file and not previous_partition_file and not hierarchy)) {
     usage();
     exit(1);
   }
 
+  if ((initial_partition_file or previous_partition_file) and numbers_of_partitions and numbers_of_partitions->size() > 1) {
+    cerr << "Only one number of partitions can be given with an initial or previous partition" << endl;
+    exit(1);
+  }
+
+  if (initial_partition_file and previous_partition_file) {
+    cerr << "-i and -r can not be used together" << endl;
+    exit(1);
+  }
+
+  if (previous_partition_file and output_sb_graph) {
+    cerr << "-o can not be used with -r" << endl;
+    exit(1);
+  }
+
+  if (hierarchy and (numbers_of_partitions or initial_partition_file or previous_partition_file or output_sb_graph)) {
+    cerr << "-H can not be used with -p, -i, -r or -o" << endl;
+    exit(1);
+  }
+
+  if (topology_file and (hierarchy or previous_partition_file)) {
+    cerr << "-m can not be used with -H or -r, their node numbers and moves would not match the renumbered partitions" << endl;
+    exit(1);
+  }
+
+  if (hierarchy and not targets.empty() and targets.size() != hierarchy->first) {
+    cerr << "There are " << targets.size() << " targets, one for each node is expected" << endl;
+    exit(1);
+  }
+
+  if (not targets.empty() and numbers_of_partitions
+      and find(numbers_of_partitions->begin(), numbers_of_partitions->end(), targets.size()) == numbers_of_partitions->end()) {
+    cerr << "There are " << targets.size() << " targets, one for each partition is expected" << endl;
+    exit(1);
+  }
+
   if (not epsilon) {
     epsilon = 0.0;
   }
 
-  if (*epsilon < 0 or *epsilon > 1) {
+  if (not node_epsilon) {
+    node_epsilon = epsilon;
+  }
+
+  if (*epsilon < 0 or *epsilon > 1 or *node_epsilon < 0 or *node_epsilon > 1) {
     usage();
     exit(1);
   }
 
   logging::sbg_log << "filename is " << *filename << endl;
-  logging::sbg_log << "number of partitions is " << *number_of_partitions << endl;
+  if (initial_partition_file) {
+    logging::sbg_log << "initial partition is " << *initial_partition_file << endl;
+  } else if (previous_partition_file) {
+    logging::sbg_log << "previous partition is " << *previous_partition_file << endl;
+  } else if (hierarchy) {
+    logging::sbg_log << "hierarchy is " << hierarchy->first << "x" << hierarchy->second << endl;
+  } else {
+    for (unsigned number_of_partitions : *numbers_of_partitions) {
+      logging::sbg_log << "number of partitions is " << number_of_partitions << endl;
+    }
+  }
+
+  Topology topology;
+  if (topology_file and not read_topology(*topology_file, topology)) {
+    cerr << "Unable to read topology " << *topology_file << endl;
+    exit(1);
+  }
+
+  CostProfile cost_profile;
+  if (cost_profile_file and not read_cost_profile(*cost_profile_file, cost_profile)) {
+    cerr << "Unable to read cost profile " << *cost_profile_file << endl;
+    exit(1);
+  }
 
   auto start = chrono::high_resolution_clock::now();
   optional<string> s;
   if (output_sb_graph) {
     s = "";
   }
-  auto partition_str = partitionate_nodes(*filename, *number_of_partitions, *epsilon, s);
+  WeightedSBGraph sb_graph;
+  map<unsigned, PartitionMap> partitions_by_k;
+  long double time_to_build_graph;
+  long double time_to_partitionate;
+  optional<RepartitionResult> repartition_result;
+  optional<HierarchicalResult> hierarchical_result;
+  try {
+    if (hierarchy) {
+      PartitionOptions node_options;
+      node_options.number_of_partitions = hierarchy->first;
+      node_options.epsilon = *node_epsilon;
+      node_options.targets = targets;
+      PartitionOptions core_options;
+      core_options.number_of_partitions = hierarchy->second;
+      core_options.epsilon = *epsilon;
+      hierarchical_result = hierarchical_partition(*filename, node_options, core_options, sb_graph, time_to_build_graph, cost_profile);
+
+      partitions_by_k[hierarchical_result->partitions.size()] = hierarchical_result->partitions;
+    } else if (previous_partition_file) {
+      PartitionOptions options;
+      options.epsilon = *epsilon;
+      options.migration_cost = migration_cost;
+      options.targets = targets;
+      repartition_result = RepartitionResult();
+      if (not repartition(*filename, *previous_partition_file, options, sb_graph, *repartition_result, time_to_build_graph, cost_profile)) {
+        cerr << "Unable to read previous partition " << *previous_partition_file << endl;
+        exit(1);
+      }
+
+      const auto& partitions = repartition_result->partitions;
+      if (numbers_of_partitions and numbers_of_partitions->front() != partitions.size()) {
+        cerr << "Previous partition has " << partitions.size() << " partitions, not " << numbers_of_partitions->front() << endl;
+        exit(1);
+      }
+      if (not targets.empty() and targets.size() != partitions.size()) {
+        cerr << "Previous partition has " << partitions.size() << " partitions, not " << targets.size() << " targets" << endl;
+        exit(1);
+      }
+      partitions_by_k[partitions.size()] = partitions;
+    } else if (initial_partition_file) {
+      PartitionMap partitions;
+      if (not refine_partition(*filename, *initial_partition_file, *epsilon, s, sb_graph, partitions, time_to_build_graph, time_to_partitionate, cost_profile, targets)) {
+        cerr << "Unable to read initial partition " << *initial_partition_file << endl;
+        exit(1);
+      }
+
+      if (numbers_of_partitions and numbers_of_partitions->front() != partitions.size()) {
+        cerr << "Initial partition has " << partitions.size() << " partitions, not " << numbers_of_partitions->front() << endl;
+        exit(1);
+      }
+      if (not targets.empty() and targets.size() != partitions.size()) {
+        cerr << "Initial partition has " << partitions.size() << " partitions, not " << targets.size() << " targets" << endl;
+        exit(1);
+      }
+      partitions_by_k[partitions.size()] = move(partitions);
+    } else if (numbers_of_partitions->size() == 1) {
+      auto& partitions = partitions_by_k[numbers_of_partitions->front()];
+      partitionate_nodes(*filename, numbers_of_partitions->front(), *epsilon, s, sb_graph, partitions, time_to_build_graph, time_to_partitionate, cost_profile, targets);
+    } else {
+      partitions_by_k = partitionate_nodes(*filename, *numbers_of_partitions, *epsilon, s, sb_graph, time_to_build_graph, time_to_partitionate, cost_profile, targets);
+    }
+  } catch (const invalid_argument& e) {
+    cerr << "Invalid model " << *filename << ": " << e.what() << endl;
+    exit(1);
+  }
   auto end = chrono::high_resolution_clock::now();
   auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
   logging::sbg_log << "total time: " << duration.count() << endl;
 
-  logging::sbg_log << "final results " << partition_str << endl;
-
   if (output_sb_graph) {
     ofstream output_sb_graph_file(*output_sb_graph);
     logging::sbg_log << "output_sb_graph " << *s << endl;
@@ -165,10 +612,94 @@ int main(int argc, char** argv)
     output_sb_graph_file << *s;
   }
 
-  if (output_file) {
-    ofstream output_file_stream(*output_file);
-    output_file_stream << partition_str << endl;
+  if (moves_file and repartition_result
+      and not write_moves(repartition_result->moves, repartition_result->migrated, *moves_file)) {
+    cerr << "Unable to write moves file " << *moves_file << endl;
+    exit(1);
+  }
+
+  // With several balance constraints, the imbalance of each one is printed
+  if (not sb_graph.get_constraint_weights().empty()) {
+    for (const auto& [number_of_partitions, partitions] : partitions_by_k) {
+      PartitionStatistics statistics;
+      if (repartition_result) {
+        statistics = repartition_result->statistics;
+      } else if (hierarchical_result) {
+        statistics = hierarchical_result->core_statistics;
+      } else {
+        compute_balance(sb_graph, partitions, statistics, targets);
+      }
+
+      cout << "Maximum imbalance of " << number_of_partitions << " partitions: " << statistics.maximum_imbalance
+           << ", of each other constraint:";
+      for (float imbalance : statistics.constraint_imbalance) {
+        cout << " " << imbalance;
+      }
+      cout << endl;
+    }
+  }
+
+  // Partitions are renumbered to be placed on the ranks of the topology. Only
+  // partitions_by_k is renumbered, which is all the output there is since -m is
+  // rejected with -H and -r above
+  if (topology_file) {
+    assert(not hierarchical_result and not repartition_result);
+    for (auto& [number_of_partitions, partitions] : partitions_by_k) {
+      if (topology.size() < partitions.size()) {
+        cerr << "Topology has " << topology.size() << " ranks, not enough for " << partitions.size() << " partitions" << endl;
+        exit(1);
+      }
+
+      QuotientGraph quotient_graph(sb_graph, partitions);
+      ProcessMapping mapping = map_processes(quotient_graph, topology);
+      cout << "Communication cost of " << number_of_partitions << " partitions on the topology: "
+           << mapping.communication_cost << ", it was " << mapping.initial_communication_cost << endl;
+      partitions = renumber_partitions(partitions, mapping, topology.size());
+    }
+  }
+
+  // With several numbers of partitions, each one is written to its own files
+  const bool many = partitions_by_k.size() > 1;
+  for (const auto& [number_of_partitions, partitions] : partitions_by_k) {
+    logging::sbg_log << "final results " << partitions << endl;
+
+    auto name = [many, k = number_of_partitions] (const string& file) { return many ? with_partitions_suffix(file, k) : file; };
+
+    if (output_file and hierarchical_result and not write_hierarchical_output(*hierarchical_result, *output_file)) {
+      cerr << "Unable to write output file " << *output_file << endl;
+      exit(1);
+    }
+
+    if (output_file and not hierarchical_result and not write_output(partitions, name(*output_file))) {
+      cerr << "Unable to write output file " << name(*output_file) << endl;
+      exit(1);
+    }
+
+    if (binary_output_file and not write_binary_output(partitions, name(*binary_output_file))) {
+      cerr << "Unable to write binary output file " << name(*binary_output_file) << endl;
+      exit(1);
+    }
+
+    if (owner_vector_file and not write_owner_vector(partitions, sb_graph, name(*owner_vector_file), owner_vector_width)) {
+      cerr << "Unable to write owner vector file " << name(*owner_vector_file) << endl;
+      exit(1);
+    }
+  }
+
+  if (trace_file and not trace::write_trace(*trace_file)) {
+    cerr << "Unable to write trace file " << *trace_file << endl;
+    exit(1);
+  }
+
+  if (set_ops_stats) {
+    set_ops::print_counters(cout);
   }
 
+  if (memory_stats) {
+    memory_usage::print_report(cout);
+  }
+
+  logging::flush();
+
   return 0;
 }
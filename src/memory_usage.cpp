@@ -0,0 +1,264 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "memory_usage.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+namespace memory_usage {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+/// Reads a field in kB from /proc/self/status, returns it in bytes or 0 if it is not there.
+size_t read_status_field(const string& field)
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, field.size(), field) == 0 and line.size() > field.size() and line[field.size()] == ':') {
+            return stoull(line.substr(field.size() + 1)) * 1024;
+        }
+    }
+
+    return 0;
+}
+
+
+atomic<bool> recording(false);
+mutex report_mutex;
+vector<PhaseMemory> phases;
+
+// Peak RSS before the last reset_peak_rss
+atomic<size_t> saved_peak_rss(0);
+
+atomic<bool> counting(false);
+atomic<size_t> allocation_count(0);
+atomic<size_t> allocated_bytes(0);
+atomic<long> live_bytes(0);
+atomic<long> peak_bytes(0);
+
+}
+
+
+size_t current_rss()
+{
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+
+    return read_status_field("VmRSS");
+}
+
+
+size_t peak_rss()
+{
+    size_t peak = read_status_field("VmHWM");
+    if (peak != 0) {
+        return peak;
+    }
+
+    // ru_maxrss is in kB in Linux
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return size_t(usage.ru_maxrss) * 1024;
+}
+
+
+bool reset_peak_rss()
+{
+    // the peak is lost once it is reset, so the one of the process is kept first
+    const size_t peak = peak_rss();
+    size_t saved = saved_peak_rss.load(memory_order_relaxed);
+    while (peak > saved and not saved_peak_rss.compare_exchange_weak(saved, peak, memory_order_relaxed)) {}
+
+    ofstream clear_refs("/proc/self/clear_refs");
+    if (not clear_refs) {
+        return false;
+    }
+
+    // writing 5 resets the peak resident set size
+    clear_refs << "5" << endl;
+
+    return bool(clear_refs);
+}
+
+
+size_t process_peak_rss()
+{
+    return max(saved_peak_rss.load(memory_order_relaxed), peak_rss());
+}
+
+
+void count_allocations()
+{
+    counting.store(true, memory_order_relaxed);
+}
+
+
+Allocations allocations()
+{
+    Allocations result;
+    result.count = allocation_count.load(memory_order_relaxed);
+    result.bytes = allocated_bytes.load(memory_order_relaxed);
+    result.live_bytes = live_bytes.load(memory_order_relaxed);
+    result.peak_bytes = peak_bytes.load(memory_order_relaxed);
+
+    return result;
+}
+
+
+void reset_peak_heap()
+{
+    peak_bytes.store(live_bytes.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+
+namespace detail {
+
+bool counting_allocations()
+{
+    return counting.load(memory_order_relaxed);
+}
+
+
+void record_allocation(size_t bytes)
+{
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    allocated_bytes.fetch_add(bytes, memory_order_relaxed);
+
+    const long live = live_bytes.fetch_add(bytes, memory_order_relaxed) + long(bytes);
+    long peak = peak_bytes.load(memory_order_relaxed);
+    while (live > peak and not peak_bytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+}
+
+
+void record_deallocation(size_t bytes)
+{
+    live_bytes.fetch_sub(bytes, memory_order_relaxed);
+}
+
+}
+
+
+void enable_report()
+{
+    count_allocations();
+    recording.store(true, memory_order_relaxed);
+}
+
+
+bool report_enabled()
+{
+    return recording.load(memory_order_relaxed);
+}
+
+
+vector<PhaseMemory> report()
+{
+    lock_guard<mutex> lock(report_mutex);
+    return phases;
+}
+
+
+void reset_report()
+{
+    lock_guard<mutex> lock(report_mutex);
+    phases.clear();
+}
+
+
+void print_report(ostream& os)
+{
+    const auto result = report();
+    const auto flags = os.flags();
+    constexpr double mb = 1024 * 1024;
+
+    os << left << setw(20) << "phase" << right
+       << setw(12) << "ms" << setw(14) << "rss delta MB" << setw(13) << "peak rss MB"
+       << setw(14) << "allocations" << setw(14) << "allocated MB" << setw(15) << "peak heap MB" << endl;
+    for (const PhaseMemory& phase : result) {
+        os << left << setw(20) << phase.phase << right << fixed << setprecision(2)
+           << setw(12) << double(phase.time) << setw(14) << phase.rss_delta / mb << setw(13) << phase.peak_rss / mb
+           << setw(14) << phase.allocations << setw(14) << phase.allocated_bytes / mb
+           << setw(15) << phase.peak_heap_delta / mb << endl;
+    }
+    os << "peak rss of the process " << fixed << setprecision(2) << process_peak_rss() / mb << " MB" << endl;
+
+    os.flags(flags);
+}
+
+
+PhaseScope::PhaseScope(const string& phase)
+    : _enabled(report_enabled())
+{
+    if (not _enabled) {
+        return;
+    }
+
+    _memory.phase = phase;
+    reset_peak_rss();
+    reset_peak_heap();
+    _start_rss = current_rss();
+    _start_allocations = allocations();
+    _start = chrono::steady_clock::now();
+}
+
+
+PhaseScope::~PhaseScope()
+{
+    if (not _enabled) {
+        return;
+    }
+
+    auto end = chrono::steady_clock::now();
+    const Allocations end_allocations = allocations();
+
+    _memory.time = chrono::duration<double, std::milli>(end - _start).count();
+    _memory.rss_delta = long(current_rss()) - _start_rss;
+    _memory.peak_rss = peak_rss();
+    _memory.allocations = end_allocations.count - _start_allocations.count;
+    _memory.allocated_bytes = end_allocations.bytes - _start_allocations.bytes;
+    _memory.peak_heap_delta = end_allocations.peak_bytes - _start_allocations.live_bytes;
+
+    lock_guard<mutex> lock(report_mutex);
+    phases.push_back(move(_memory));
+}
+
+}
+
+}
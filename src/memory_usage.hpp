@@ -0,0 +1,132 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace sbg_partitioner {
+
+namespace memory_usage {
+
+/// Resident set size of this process, in bytes.
+size_t current_rss();
+
+/// Maximum resident set size of this process since it started or since the last
+/// call to reset_peak_rss, in bytes.
+size_t peak_rss();
+
+/// Resets the peak resident set size to the current one, so the peak of a single
+/// phase can be measured. Returns false if the kernel does not support it, in which
+/// case peak_rss keeps reporting the peak since the process started.
+bool reset_peak_rss();
+
+/// Maximum resident set size of this process since it started, in bytes, even if
+/// reset_peak_rss was called since then.
+size_t process_peak_rss();
+
+
+/// Allocations made through the global operator new. They are only counted in programs
+/// that link allocation_hook.o, which replaces it, like sbg-partitioner. It is not part of
+/// the library, so other programs keep their own operator new and count nothing. Only the
+/// allocations made once count_allocations is called are counted, and so are their frees.
+struct Allocations {
+    size_t count = 0;      // calls to operator new
+    size_t bytes = 0;      // bytes allocated by them
+    long live_bytes = 0;   // bytes allocated and not freed yet, since counting started
+    long peak_bytes = 0;   // maximum of live_bytes since counting started or reset_peak_heap
+};
+
+void count_allocations();
+
+Allocations allocations();
+
+/// Resets the peak of the live heap bytes to the current ones.
+void reset_peak_heap();
+
+
+namespace detail {
+
+/// Used by the operator new of allocation_hook.cpp to record its allocations.
+bool counting_allocations();
+
+void record_allocation(size_t bytes);
+
+void record_deallocation(size_t bytes);
+
+}
+
+
+/// Memory used by a phase of the partitioner, see PhaseScope.
+struct PhaseMemory {
+    std::string phase;
+    long double time = 0;          // ms
+    long rss_delta = 0;            // bytes, RSS at the end of the phase minus RSS at its start
+    size_t peak_rss = 0;           // bytes, high-water mark of the RSS during the phase
+    size_t allocations = 0;        // calls to operator new during the phase
+    size_t allocated_bytes = 0;
+    long peak_heap_delta = 0;      // bytes, peak of the live heap during the phase minus at its start
+};
+
+
+/// Starts recording the phases, and counting allocations. Until it is called PhaseScope
+/// only checks a flag.
+void enable_report();
+
+bool report_enabled();
+
+/// Returns the phases recorded so far, in the order they ended.
+std::vector<PhaseMemory> report();
+
+void reset_report();
+
+/// Prints a table with the recorded phases and the peak RSS of the process (see
+/// process_peak_rss).
+void print_report(std::ostream& os);
+
+
+/// Records the time and the memory used from its construction to its destruction as
+/// a phase of the report. Phases are not meant to be nested, the peak RSS of a phase is
+/// reset when another one starts.
+class PhaseScope
+{
+public:
+    PhaseScope(const std::string& phase);
+    ~PhaseScope();
+
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    bool _enabled;
+    PhaseMemory _memory;
+    long _start_rss = 0;
+    Allocations _start_allocations;
+    std::chrono::steady_clock::time_point _start;
+};
+
+}
+
+}
@@ -0,0 +1,358 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "owner_vector.hpp"
+#include "sbg_partitioner_log.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+// Below this amount of elements per thread, spawning threads costs more than filling.
+constexpr size_t min_elements_per_thread = 1 << 16;
+
+struct OwnerRange {
+    size_t first;
+    size_t last;
+    unsigned owner;
+};
+
+
+vector<OwnerRange> get_owner_ranges(const PartitionMap& partitions, const ElementIndex& index)
+{
+    vector<OwnerRange> ranges;
+    for (const auto& [i, partition] : partitions) {
+        for (const auto& set_piece : partition.pieces()) {
+            index.for_each_range(set_piece, [&ranges, i = i](size_t first, size_t last) {
+                ranges.push_back(OwnerRange{first, last, i});
+            });
+        }
+    }
+
+    return ranges;
+}
+
+
+template<typename T>
+void fill_ranges(const vector<OwnerRange>& ranges, const vector<size_t>& accumulated, size_t from, size_t to, T* owner)
+{
+    // accumulated[r] is the amount of elements before range r, so we look for the
+    // range that contains the element number from
+    size_t r = distance(accumulated.begin(), upper_bound(accumulated.begin(), accumulated.end(), from)) - 1;
+    for (; r < ranges.size() and accumulated[r] < to; r++) {
+        size_t skip = from > accumulated[r] ? from - accumulated[r] : 0;
+        size_t length = min(accumulated[r + 1], to) - accumulated[r];
+        fill(owner + ranges[r].first + skip, owner + ranges[r].first + length, T(ranges[r].owner));
+    }
+}
+
+
+/// Run of consecutive elements of a row with the same owner, and the row where the
+/// rectangle it belongs to starts.
+template<typename T>
+struct OwnerRun {
+    SBG::Util::INT first;
+    SBG::Util::INT last;
+    T owner;
+    SBG::Util::INT first_row;
+};
+
+
+template<typename T>
+void get_row_runs(const T* row, const Interval& columns, vector<OwnerRun<T>>& runs, SBG::Util::INT current_row)
+{
+    runs.clear();
+    const size_t size = columns.end() - columns.begin() + 1;
+    size_t start = 0;
+    for (size_t c = 1; c <= size; c++) {
+        if (c == size or row[c] != row[start]) {
+            runs.push_back(OwnerRun<T>{columns.begin() + SBG::Util::INT(start), columns.begin() + SBG::Util::INT(c - 1), row[start], current_row});
+            start = c;
+        }
+    }
+}
+
+
+/// Compresses the elements of a node whose leading dimensions (all but the last two)
+/// are fixed to prefix, so it is a set of rows.
+template<typename T>
+void compress_block(
+    const T* owner,
+    const ElementIndex::Node& node,
+    const vector<SBG::Util::INT>& prefix,
+    vector<vector<SetPiece>>& pieces)
+{
+    const auto& intervals = node.set_piece.intervals();
+    const size_t dimensions = intervals.size();
+
+    auto emit = [&](const OwnerRun<T>& run, SBG::Util::INT last_row) {
+        SetPiece set_piece;
+        for (auto v : prefix) {
+            set_piece.emplaceBack(Interval(v, 1, v));
+        }
+        if (dimensions > 1) {
+            set_piece.emplaceBack(Interval(run.first_row, 1, last_row));
+        }
+        set_piece.emplaceBack(Interval(run.first, 1, run.last));
+        pieces[run.owner].push_back(set_piece);
+    };
+
+    size_t base = node.offset;
+    for (size_t d = 0; d < prefix.size(); d++) {
+        base += (prefix[d] - intervals[d].begin()) * node.strides[d];
+    }
+
+    const Interval& columns = intervals.back();
+    if (dimensions == 1) {
+        vector<OwnerRun<T>> runs;
+        get_row_runs(owner + base, columns, runs, 0);
+        for (const auto& run : runs) {
+            emit(run, 0);
+        }
+        return;
+    }
+
+    // open rectangles, sorted by their first column since runs partition each row
+    const Interval& rows = intervals[dimensions - 2];
+    const size_t row_stride = node.strides[dimensions - 2];
+    vector<OwnerRun<T>> open, current, next_open;
+    for (SBG::Util::INT r = rows.begin(); r <= rows.end(); r++) {
+        get_row_runs(owner + base + (r - rows.begin()) * row_stride, columns, current, r);
+
+        next_open.clear();
+        size_t o = 0;
+        for (auto& run : current) {
+            while (o < open.size() and open[o].first < run.first) {
+                emit(open[o++], r - 1);
+            }
+
+            if (o < open.size() and open[o].first == run.first and open[o].last == run.last and open[o].owner == run.owner) {
+                run.first_row = open[o++].first_row;
+            }
+
+            next_open.push_back(run);
+        }
+
+        while (o < open.size()) {
+            emit(open[o++], r - 1);
+        }
+
+        swap(open, next_open);
+    }
+
+    for (const auto& run : open) {
+        emit(run, rows.end());
+    }
+}
+
+
+template<typename T>
+bool write_owner_vector_mmap(const PartitionMap& partitions, const ElementIndex& index, const string& filename, unsigned threads)
+{
+    if (partitions.size() > size_t(numeric_limits<T>::max()) + 1) {
+        cerr << partitions.size() << " partitions do not fit in a " << 8 * sizeof(T) << " bits owner vector" << endl;
+        return false;
+    }
+
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    const size_t size = index.size() * sizeof(T);
+    if (size == 0) {
+        return close(fd) == 0;
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    fill_owner_vector(partitions, index, static_cast<T*>(data), threads);
+
+    bool ok = msync(data, size, MS_SYNC) == 0;
+    ok = munmap(data, size) == 0 and ok;
+
+    return ok;
+}
+
+}
+
+
+template<typename T>
+void fill_owner_vector(const PartitionMap& partitions, const ElementIndex& index, T* owner, unsigned threads)
+{
+    auto ranges = get_owner_ranges(partitions, index);
+
+    vector<size_t> accumulated(ranges.size() + 1, 0);
+    for (size_t r = 0; r < ranges.size(); r++) {
+        accumulated[r + 1] = accumulated[r] + (ranges[r].last - ranges[r].first + 1);
+    }
+    const size_t total = accumulated.back();
+
+    if (threads == 0) {
+        threads = max(thread::hardware_concurrency(), 1u);
+    }
+    threads = unsigned(min(size_t(threads), max(total / min_elements_per_thread, size_t(1))));
+
+    logging::sbg_log << "filling owner vector of " << total << " elements in " << ranges.size()
+                     << " ranges with " << threads << " threads" << endl;
+
+    // Each thread fills the same amount of elements, whatever the ranges they belong to
+    vector<future<void>> futures;
+    for (unsigned t = 1; t < threads; t++) {
+        size_t from = total * t / threads;
+        size_t to = total * (t + 1) / threads;
+        futures.push_back(async(launch::async, fill_ranges<T>, cref(ranges), cref(accumulated), from, to, owner));
+    }
+
+    fill_ranges(ranges, accumulated, 0, total / threads, owner);
+
+    for (auto& f : futures) {
+        f.get();
+    }
+}
+
+
+template void fill_owner_vector<uint8_t>(const PartitionMap&, const ElementIndex&, uint8_t*, unsigned);
+template void fill_owner_vector<uint16_t>(const PartitionMap&, const ElementIndex&, uint16_t*, unsigned);
+template void fill_owner_vector<uint32_t>(const PartitionMap&, const ElementIndex&, uint32_t*, unsigned);
+
+
+template<typename T>
+PartitionMap compress_owner_vector(const T* owner, const ElementIndex& index, unsigned number_of_partitions)
+{
+    // owners index pieces, so they are checked before any of them is written
+    for (size_t i = 0; i < index.size(); i++) {
+        bool negative = false;
+        if constexpr (is_signed_v<T>) {
+            negative = owner[i] < 0;
+        }
+        if (negative or uint64_t(owner[i]) >= number_of_partitions) {
+            cerr << "Element " << i << " has partition " << int64_t(owner[i]) << ", it should be in [0, "
+                 << number_of_partitions << ")" << endl;
+            return PartitionMap();
+        }
+    }
+
+    vector<vector<SetPiece>> pieces(number_of_partitions);
+    for (size_t i = 0; i < index.number_of_nodes(); i++) {
+        const auto& node = index.node(i);
+        const auto& intervals = node.set_piece.intervals();
+        const size_t leading = intervals.size() > 2 ? intervals.size() - 2 : 0;
+
+        // every combination of the leading dimensions, in row-major order
+        vector<SBG::Util::INT> prefix(leading);
+        for (size_t d = 0; d < leading; d++) {
+            prefix[d] = intervals[d].begin();
+        }
+
+        while (true) {
+            compress_block(owner, node, prefix, pieces);
+
+            size_t d = leading;
+            while (d > 0) {
+                d--;
+                if (++prefix[d] <= intervals[d].end()) {
+                    break;
+                }
+                prefix[d] = intervals[d].begin();
+                if (d == 0) {
+                    d = ElementIndex::npos;
+                    break;
+                }
+            }
+
+            if (leading == 0 or d == ElementIndex::npos) {
+                break;
+            }
+        }
+    }
+
+    PartitionMap partitions;
+    for (unsigned p = 0; p < number_of_partitions; p++) {
+        sort(pieces[p].begin(), pieces[p].end());
+
+        OrdSet& partition = partitions[p];
+        for (const auto& set_piece : pieces[p]) {
+            partition.emplace_hint(partition.end(), set_piece);
+        }
+    }
+
+    return partitions;
+}
+
+
+template PartitionMap compress_owner_vector<uint8_t>(const uint8_t*, const ElementIndex&, unsigned);
+template PartitionMap compress_owner_vector<uint16_t>(const uint16_t*, const ElementIndex&, unsigned);
+template PartitionMap compress_owner_vector<uint32_t>(const uint32_t*, const ElementIndex&, unsigned);
+template PartitionMap compress_owner_vector<int32_t>(const int32_t*, const ElementIndex&, unsigned);
+template PartitionMap compress_owner_vector<int64_t>(const int64_t*, const ElementIndex&, unsigned);
+
+
+bool write_owner_vector(
+    const PartitionMap& partitions,
+    const WeightedSBGraph& graph,
+    const string& filename,
+    unsigned width,
+    unsigned threads)
+{
+    ElementIndex index(graph.V());
+
+    switch (width) {
+    case 8:
+        return write_owner_vector_mmap<uint8_t>(partitions, index, filename, threads);
+    case 16:
+        return write_owner_vector_mmap<uint16_t>(partitions, index, filename, threads);
+    case 32:
+        return write_owner_vector_mmap<uint32_t>(partitions, index, filename, threads);
+    default:
+        cerr << "Unsupported owner vector width " << width << ", it should be 8, 16 or 32" << endl;
+        return false;
+    }
+}
+
+}
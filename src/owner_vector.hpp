@@ -0,0 +1,64 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <string>
+
+#include "element_index.hpp"
+#include "partition_graph.hpp"
+#include "weighted_sb_graph.hpp"
+
+
+namespace sbg_partitioner {
+
+/// Fills owner, an array of index.size() elements, with the partition each element
+/// belongs to. Elements are numbered as index does. Each set piece is written with a
+/// range fill, split among threads by number of elements. If threads is 0, all the
+/// hardware threads are used.
+/// Instantiated for uint8_t, uint16_t and uint32_t.
+template<typename T>
+void fill_owner_vector(const PartitionMap& partitions, const ElementIndex& index, T* owner, unsigned threads = 0);
+
+
+/// Inverse of fill_owner_vector: takes the partition of each element, as numbered by
+/// index, and returns it as set pieces. Each node is split in maximal runs of elements
+/// with the same owner and, for multidimensional nodes, runs that repeat in consecutive
+/// rows are merged into rectangular blocks. It takes a single pass over owner, with no
+/// set operations, so partitions of classic partitioners can be used as our own.
+/// Partitions 0 to number_of_partitions - 1 are always in the returned map. If an owner
+/// is not one of them, it returns an empty map, printing why.
+/// Instantiated for uint8_t, uint16_t, uint32_t, int32_t and int64_t.
+template<typename T>
+PartitionMap compress_owner_vector(const T* owner, const ElementIndex& index, unsigned number_of_partitions);
+
+
+/// Writes the dense owner vector of the partition to filename, as a raw array of
+/// unsigned integers of width bits (8, 16 or 32) with the byte order of this machine.
+/// The file is memory-mapped and filled in place. Returns false if width is not
+/// supported, the number of partitions does not fit in it, or the file could not
+/// be written.
+bool write_owner_vector(
+    const PartitionMap& partitions,
+    const WeightedSBGraph& graph,
+    const std::string& filename,
+    unsigned width = 32,
+    unsigned threads = 0);
+
+}
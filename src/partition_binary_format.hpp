@@ -0,0 +1,215 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#pragma once
+
+// This header only depends on the standard library and POSIX, so it can be copied
+// as it is into the simulator, or any other program that needs to read partitions.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace sbg_partitioner {
+
+namespace binary_output {
+
+/// Binary partition format, version 1. All values are stored with the byte order
+/// of the machine that wrote the file:
+///
+///   Header                                          16 bytes
+///   uint64_t pieces[number_of_partitions]           set pieces of each partition
+///   Range ranges[total_pieces * dimensions]         packed (begin, end) of each interval
+///
+/// Set pieces are stored partition by partition, in the same order as the json
+/// output, with one range per dimension. If a set piece has less intervals than
+/// dimensions, the remaining ranges are empty (begin > end). There is at least one
+/// dimension.
+
+constexpr char MAGIC[4] = {'S', 'B', 'G', 'P'};
+
+constexpr uint32_t VERSION = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t number_of_partitions;
+    uint32_t dimensions;
+};
+
+struct Range {
+    int64_t begin;
+    int64_t end;
+
+    bool empty() const { return begin > end; }
+};
+
+static_assert(sizeof(Header) == 16, "Unexpected header size");
+static_assert(sizeof(Range) == 16, "Unexpected range size");
+
+
+/// Zero-copy view of the set pieces of a partition, it points into the mapped file.
+class PartitionView
+{
+public:
+    PartitionView(const Range* ranges, uint64_t pieces, uint32_t dimensions)
+        : _ranges(ranges), _pieces(pieces), _dimensions(dimensions)
+    {}
+
+    /// Number of set pieces
+    uint64_t size() const { return _pieces; }
+
+    uint32_t dimensions() const { return _dimensions; }
+
+    /// Returns the ranges of set piece i, one for each dimension.
+    const Range* piece(uint64_t i) const { return _ranges + i * _dimensions; }
+
+    const Range& range(uint64_t i, uint32_t dimension) const { return piece(i)[dimension]; }
+
+private:
+    const Range* _ranges;
+    uint64_t _pieces;
+    uint32_t _dimensions;
+};
+
+
+/// Memory-maps a binary partition file, so each rank can access its own set pieces
+/// without reading nor parsing the whole file.
+class Reader
+{
+public:
+    Reader() = default;
+
+    explicit Reader(const std::string& filename) { open(filename); }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    ~Reader() { close(); }
+
+    /// Returns false if the file can not be mapped or it is not a valid partition file.
+    bool open(const std::string& filename)
+    {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 or size_t(file_stat.st_size) < sizeof(Header)) {
+            ::close(fd);
+            return false;
+        }
+
+        _size = file_stat.st_size;
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            _size = 0;
+            return false;
+        }
+        _data = static_cast<const char*>(data);
+
+        if (not validate()) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if (_data != nullptr) {
+            munmap(const_cast<char*>(_data), _size);
+        }
+
+        _data = nullptr;
+        _size = 0;
+        _offsets.clear();
+    }
+
+    bool is_open() const { return _data != nullptr; }
+
+    uint32_t number_of_partitions() const { return header().number_of_partitions; }
+
+    uint32_t dimensions() const { return header().dimensions; }
+
+    PartitionView partition(uint32_t i) const
+    {
+        const Range* ranges = first_range() + _offsets[i] * dimensions();
+        return PartitionView(ranges, _offsets[i + 1] - _offsets[i], dimensions());
+    }
+
+private:
+    const Header& header() const { return *reinterpret_cast<const Header*>(_data); }
+
+    const uint64_t* pieces() const { return reinterpret_cast<const uint64_t*>(_data + sizeof(Header)); }
+
+    const Range* first_range() const
+    {
+        return reinterpret_cast<const Range*>(_data + sizeof(Header) + number_of_partitions() * sizeof(uint64_t));
+    }
+
+    bool validate()
+    {
+        if (memcmp(header().magic, MAGIC, sizeof(MAGIC)) != 0 or header().version != VERSION
+            or dimensions() == 0) {
+            return false;
+        }
+
+        const size_t counts_size = sizeof(Header) + size_t(number_of_partitions()) * sizeof(uint64_t);
+        if (_size < counts_size) {
+            return false;
+        }
+
+        // offset of each partition, in set pieces. Each count is checked against the
+        // bytes left before it is added, so crafted counts can not overflow the sums.
+        const uint64_t piece_size = uint64_t(dimensions()) * sizeof(Range);
+        uint64_t remaining_bytes = _size - counts_size;
+        _offsets.resize(number_of_partitions() + 1);
+        _offsets[0] = 0;
+        for (uint32_t i = 0; i < number_of_partitions(); i++) {
+            if (pieces()[i] > remaining_bytes / piece_size) {
+                return false;
+            }
+            remaining_bytes -= pieces()[i] * piece_size;
+            _offsets[i + 1] = _offsets[i] + pieces()[i];
+        }
+
+        return remaining_bytes == 0;
+    }
+
+    const char* _data = nullptr;
+    size_t _size = 0;
+    std::vector<uint64_t> _offsets;
+};
+
+}
+
+}
@@ -17,20 +17,31 @@
 
  ******************************************************************************/
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
 #include <rapidjson/document.h>
+#include <rapidjson/filereadstream.h>
 #include <rapidjson/filewritestream.h>
-#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include <set>
 #include <util/logger.hpp>
 
 #include "build_sb_graph.hpp"
 #include "dfs_on_sbg.hpp"
+#include "element_index.hpp"
+#include "owner_vector.hpp"
+#include "partition_binary_format.hpp"
 #include "partition_graph.hpp"
 #include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+#include "trace.hpp"
 
 
-#define TRY_MULTIPLE_SRATEGIES 0
+#define TRY_MULTIPLE_STRATEGIES 0
 
 using namespace std;
 
@@ -45,23 +56,26 @@ namespace sbg_partitioner {
 // Using an unnamed manespace to define functions with internal linkage
 namespace {
 
-OrdSet get_communication_edges(OrdSet partition, const CanonPWMap& map_1, const CanonPWMap& map_2)
+/// Returns the edges that leave the partition, that is, those edges with exactly one
+/// end inside it. The first set contains the edges whose map 2 end is outside the
+/// partition, the second one those edges whose map 1 end is outside.
+pair<OrdSet, OrdSet> get_boundary_edges(const OrdSet& partition, const CanonPWMap& map_1, const CanonPWMap& map_2)
 {
-    auto pre_image = preImage(partition, map_1);
-    auto image_map_2 = image(pre_image, map_2);
-    auto outside_partition = difference(image_map_2, partition);
-    auto comm_edges = preImage(outside_partition, map_2);
+    auto pre_image_1 = set_ops::preImage(partition, map_1);
+    auto pre_image_2 = set_ops::preImage(partition, map_2);
+    auto leaving_by_map_2 = set_ops::difference(pre_image_1, pre_image_2);
+    auto leaving_by_map_1 = set_ops::difference(pre_image_2, pre_image_1);
 
-    return comm_edges;
+    return make_pair(leaving_by_map_2, leaving_by_map_1);
 }
 
 
-[[maybe_unused]]size_t get_partition_communication(WeightedSBGraph& graph, const PartitionMap& partitions)
+[[maybe_unused]]size_t get_partition_communication(const WeightedSBGraph& graph, const PartitionMap& partitions)
 {
     SBG::LIB::OrdSet s;
     for (auto& [i, _] : partitions) {
         auto ss = get_connectivity_set(graph, partitions, i);
-        s = SBG::LIB::cup(ss, s);
+        s = set_ops::cup(ss, s);
         logging::sbg_log << "current connectivity set " << s << ", cardinality " << get_OrdSet_size(s) << ", partition " << i << endl;
     }
 
@@ -70,29 +84,152 @@ OrdSet get_communication_edges(OrdSet partition, const CanonPWMap& map_1, const
     return size;
 }
 
-constexpr bool using_many_initial_partitions = false;
+
+template<typename Writer>
+void write_partitions(Writer& writer, const PartitionMap& partition_map)
+{
+    writer.StartObject();
+    writer.Key("partitions");
+    write_partitions_array(writer, partition_map);
+    writer.EndObject();
 }
 
-vector<PartitionMap> make_initial_partitions(WeightedSBGraph& graph, unsigned number_of_partitions)
+
+constexpr size_t output_buffer_size = 64 * 1024;
+
+
+bool ends_with(const string& s, const string& suffix)
 {
-    vector<PartitionMap> partitions_sets;
-    initialize_partitioning(graph, number_of_partitions);
+    return s.size() >= suffix.size() and s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
 
-    constexpr bool pre_order = true;
-    auto s1 = PartitionStrategyDistributive(number_of_partitions, graph);
-    add_strategy(s1, pre_order);
-#if TRY_MULTIPLE_STRATEGIES
-    auto s2 = PartitionStrategyDistributive(number_of_partitions, graph);
-    add_strategy(s2, not pre_order);
-    auto s3 = PartitionStrategyGreedy(number_of_partitions, graph);
-    add_strategy(s3, pre_order);
-    auto s4 = PartitionStrategyGreedy(number_of_partitions, graph);
-    add_strategy(s4, not pre_order);
-#endif
 
-    vector<map<unsigned, set<SetPiece>>> partitions = partitionate();
+bool read_json_partition(const string& filename, PartitionMap& partitions)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        cerr << "Unable to open file! " << filename << endl;
+        return false;
+    }
+
+    char buffer[output_buffer_size];
+    rapidjson::FileReadStream is(file, buffer, sizeof(buffer));
+    rapidjson::Document document;
+    document.ParseStream(is);
+    fclose(file);
+
+    if (document.HasParseError() or not document.IsObject() or not document.HasMember("partitions")
+        or not document["partitions"].IsArray()) {
+        cerr << filename << " is not a partition file" << endl;
+        return false;
+    }
+
+    const auto& partitions_array = document["partitions"].GetArray();
+    for (rapidjson::SizeType i = 0; i < partitions_array.Size(); i++) {
+        OrdSet& partition = partitions[i];
+        const auto& p = partitions_array[i];
+        if (not p.IsObject() or not p.HasMember("nodes") or not p["nodes"].IsArray()) {
+            cerr << filename << ": partition " << i << " has no nodes" << endl;
+            return false;
+        }
+
+        for (const auto& node : p["nodes"].GetArray()) {
+            if (not node.IsArray() or node.Empty()) {
+                cerr << filename << ": partition " << i << " has an invalid node" << endl;
+                return false;
+            }
 
-    for (const auto& partition : partitions) {
+            SetPiece set_piece;
+            for (const auto& interval : node.GetArray()) {
+                if (not interval.IsArray() or interval.Size() != 2 or not interval[0].IsInt64()
+                    or not interval[1].IsInt64() or interval[0].GetInt64() > interval[1].GetInt64()) {
+                    cerr << filename << ": partition " << i << " has an invalid interval" << endl;
+                    return false;
+                }
+                set_piece.emplaceBack(Interval(interval[0].GetInt64(), 1, interval[1].GetInt64()));
+            }
+            partition.emplace(set_piece);
+        }
+    }
+
+    return true;
+}
+
+
+bool read_binary_partition(const string& filename, PartitionMap& partitions)
+{
+    binary_output::Reader reader;
+    if (not reader.open(filename)) {
+        cerr << filename << " is not a binary partition file" << endl;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < reader.number_of_partitions(); i++) {
+        OrdSet& partition = partitions[i];
+        const auto view = reader.partition(i);
+        for (uint64_t j = 0; j < view.size(); j++) {
+            SetPiece set_piece;
+            for (uint32_t d = 0; d < view.dimensions() and not view.range(j, d).empty(); d++) {
+                set_piece.emplaceBack(Interval(view.range(j, d).begin, 1, view.range(j, d).end));
+            }
+            partition.emplace_hint(partition.end(), set_piece);
+        }
+    }
+
+    return true;
+}
+
+
+bool read_flat_partition(const string& filename, const WeightedSBGraph& graph, PartitionMap& partitions)
+{
+    ifstream file(filename);
+    if (not file.is_open()) {
+        cerr << "Unable to open file! " << filename << endl;
+        return false;
+    }
+
+    ElementIndex index(graph.V());
+    vector<uint32_t> owner;
+    owner.reserve(index.size());
+
+    uint32_t number_of_partitions = 0;
+    long long value;
+    while (file >> value) {
+        // there can not be more partitions than elements, which also keeps ids in uint32_t
+        if (value < 0 or static_cast<size_t>(value) >= index.size()) {
+            cerr << filename << ": invalid partition " << value << ", it should be in [0, " << index.size() << ")" << endl;
+            return false;
+        }
+        owner.push_back(value);
+        number_of_partitions = max(number_of_partitions, owner.back() + 1);
+    }
+
+    if (owner.size() != index.size()) {
+        cerr << filename << " has " << owner.size() << " elements, but the graph has " << index.size() << endl;
+        return false;
+    }
+
+    partitions = compress_owner_vector(owner.data(), index, number_of_partitions);
+
+    return true;
+}
+
+
+/// Runs the search with the strategies already added to dfs, and returns the partition
+/// each of them made.
+vector<PartitionMap> run_initial_partitioning(const WeightedSBGraph& graph, unsigned number_of_partitions, DFS& dfs)
+{
+    set_ops::PhaseScope phase(set_ops::Phase::INITIAL_PARTITION);
+
+    {
+        trace::Span span("dfs_traversal", "initial partition");
+        span.arg("partitions", number_of_partitions);
+        dfs.start();
+        dfs.iterate();
+    }
+
+    vector<PartitionMap> partitions_sets;
+    for (const auto& partition : dfs.partitions()) {
         PartitionMap partition_set;
         for (const auto& [id, set] : partition) {
             SBG::LIB::OrdSet set_piece;
@@ -121,12 +258,132 @@ vector<PartitionMap> make_initial_partitions(WeightedSBGraph& graph, unsigned nu
 }
 
 
+constexpr bool using_many_initial_partitions = TRY_MULTIPLE_STRATEGIES;
+
+}
+
+vector<float> target_fractions(const vector<float>& targets, unsigned number_of_partitions)
+{
+    float total = 0;
+    for (float target : targets) {
+        total += target;
+    }
+
+    if (targets.size() != number_of_partitions or total <= 0) {
+        return vector<float>(number_of_partitions, 1.0 / number_of_partitions);
+    }
+
+    vector<float> fractions;
+    for (float target : targets) {
+        fractions.push_back(target / total);
+    }
+
+    return fractions;
+}
+
+
+bool parse_partitions(const string& arg, vector<unsigned>& numbers_of_partitions)
+{
+    set<unsigned> added(numbers_of_partitions.begin(), numbers_of_partitions.end());
+    istringstream items(arg);
+    string item;
+    while (getline(items, item, ',')) {
+        // streams take a sign, and "-2" would wrap around as an unsigned
+        if (item.empty() or item.find_first_not_of("0123456789:") != string::npos) {
+            return false;
+        }
+
+        unsigned first = 0, last = 0, step = 1;
+        char separator;
+        istringstream range(item);
+        if (not (range >> first)) {
+            return false;
+        }
+        last = first;
+        if (range >> separator and (separator != ':' or not (range >> last))) {
+            return false;
+        }
+        if (range >> separator and (separator != ':' or not (range >> step))) {
+            return false;
+        }
+        if (not range.eof() or first == 0 or last < first or step == 0 or last > max_number_of_partitions) {
+            return false;
+        }
+
+        for (unsigned k = first; ; k += step) {
+            if (added.insert(k).second) {
+                numbers_of_partitions.push_back(k);
+            }
+
+            // stop before k + step goes past last, or wraps around with a large step
+            if (last - k < step) {
+                break;
+            }
+        }
+    }
+
+    return not numbers_of_partitions.empty();
+}
+
+
+vector<PartitionMap> make_initial_partitions(
+    const WeightedSBGraph& graph,
+    unsigned number_of_partitions,
+    shared_ptr<const search::Adjacency> adjacency,
+    const vector<float>& targets)
+{
+    if (not adjacency) {
+        adjacency = search::make_adjacency(graph);
+    }
+
+    // Each call has its own search, so several graphs can be partitioned at the same time
+    DFS dfs(graph, number_of_partitions, adjacency);
+
+    constexpr bool pre_order = true;
+    auto s1 = PartitionStrategyDistributive(number_of_partitions, graph, targets);
+    dfs.add_partition_strategy(s1, pre_order);
+#if TRY_MULTIPLE_STRATEGIES
+    auto s2 = PartitionStrategyDistributive(number_of_partitions, graph, targets);
+    dfs.add_partition_strategy(s2, not pre_order);
+    auto s3 = PartitionStrategyGreedy(number_of_partitions, graph, targets);
+    dfs.add_partition_strategy(s3, pre_order);
+    auto s4 = PartitionStrategyGreedy(number_of_partitions, graph, targets);
+    dfs.add_partition_strategy(s4, not pre_order);
+#endif
+
+    return run_initial_partitioning(graph, number_of_partitions, dfs);
+}
+
+
+PartitionMap initial_partition(
+    const WeightedSBGraph& graph,
+    unsigned number_of_partitions,
+    PartitionAlgorithm strategy,
+    const vector<float>& targets)
+{
+    DFS dfs(graph, number_of_partitions);
+
+    constexpr bool pre_order = true;
+    unique_ptr<PartitionStrategy> partition_strategy;
+    if (strategy == GREEDY) {
+        partition_strategy = make_unique<PartitionStrategyGreedy>(number_of_partitions, graph, targets);
+    } else {
+        partition_strategy = make_unique<PartitionStrategyDistributive>(number_of_partitions, graph, targets);
+    }
+    dfs.add_partition_strategy(*partition_strategy, pre_order);
+
+    return run_initial_partitioning(graph, number_of_partitions, dfs).front();
+}
+
+
 PartitionMap
 best_initial_partition(
-    WeightedSBGraph& graph,
-    unsigned number_of_partitions)
+    const WeightedSBGraph& graph,
+    unsigned number_of_partitions,
+    shared_ptr<const search::Adjacency> adjacency,
+    const vector<float>& targets)
 {
-    std::vector<sbg_partitioner::PartitionMap> partition_maps = make_initial_partitions(graph, number_of_partitions);
+    std::vector<sbg_partitioner::PartitionMap> partition_maps = make_initial_partitions(graph, number_of_partitions, adjacency, targets);
 
     auto& best_initial_partitions = partition_maps.front();
     if (using_many_initial_partitions) {
@@ -151,23 +408,46 @@ best_initial_partition(
 
 
 OrdSet get_connectivity_set(
-    CanonSBG& graph,
+    const CanonSBG& graph,
+    const PartitionMap& partitions,
+    size_t partition_index)
+{
+    const auto& partition = partitions.at(partition_index);
+
+    auto [leaving_by_map_2, leaving_by_map_1] = get_boundary_edges(partition, graph.map1(), graph.map2());
+
+    return set_ops::cup(leaving_by_map_2, leaving_by_map_1);
+}
+
+
+map<unsigned, OrdSet> get_connectivity_set_by_partition(
+    const CanonSBG& graph,
     const PartitionMap& partitions,
     size_t partition_index)
 {
     const auto& partition = partitions.at(partition_index);
 
-    OrdSet edges;
+    auto [leaving_by_map_2, leaving_by_map_1] = get_boundary_edges(partition, graph.map1(), graph.map2());
 
+    // nodes at the other end of the boundary edges
+    auto outside_nodes_2 = set_ops::image(leaving_by_map_2, graph.map2());
+    auto outside_nodes_1 = set_ops::image(leaving_by_map_1, graph.map1());
+
+    map<unsigned, OrdSet> edges;
     for (const auto& [i, p] : partitions) {
         if (i == partition_index) {
             continue;
         }
 
-        auto comm_edges_1 = get_communication_edges(partition, graph.map1(), graph.map2());
-        auto comm_edges_2 = get_communication_edges(partition, graph.map2(), graph.map1());
-        auto comm_edges = cup (comm_edges_1, comm_edges_2);
-        edges = cup(edges, comm_edges);
+        auto arriving_nodes_2 = set_ops::intersection(p, outside_nodes_2);
+        auto arriving_nodes_1 = set_ops::intersection(p, outside_nodes_1);
+        if (isEmpty(arriving_nodes_2) and isEmpty(arriving_nodes_1)) {
+            continue;
+        }
+
+        auto edges_2 = set_ops::intersection(set_ops::preImage(arriving_nodes_2, graph.map2()), leaving_by_map_2);
+        auto edges_1 = set_ops::intersection(set_ops::preImage(arriving_nodes_1, graph.map1()), leaving_by_map_1);
+        edges[i] = set_ops::cup(edges_1, edges_2);
     }
 
     return edges;
@@ -193,10 +473,10 @@ void sanity_check(const WeightedSBGraph &graph, PartitionMap& partitions_set, un
     // This is just a sanity check
     OrdSet nodes_to_check;
     for (unsigned i = 0; i < number_of_partitions; i++) {
-        nodes_to_check = cup(nodes_to_check, partitions_set[i]);
+        nodes_to_check = set_ops::cup(nodes_to_check, partitions_set[i]);
     }
-    OrdSet diff_1 = difference(graph.V(), nodes_to_check);
-    OrdSet diff_2 = difference(nodes_to_check, graph.V());
+    OrdSet diff_1 = set_ops::difference(graph.V(), nodes_to_check);
+    OrdSet diff_2 = set_ops::difference(nodes_to_check, graph.V());
     assert(get_node_size(diff_1, graph.get_node_weights()) == 0 and "The intial partition has less elements than the graph");
     assert(get_node_size(diff_2, graph.get_node_weights()) == 0 and "The intial partition has more elements than the graph");
     for (unsigned i = 0; i < number_of_partitions; i++) {
@@ -205,7 +485,7 @@ void sanity_check(const WeightedSBGraph &graph, PartitionMap& partitions_set, un
             auto p_2 = partitions_set[j];
             stringstream error_msg;
             error_msg << "Intersection between " << i << " and " << j << " is not empty." << endl;
-            assert(intersection(p_1, p_2).pieces().empty() and error_msg.str().c_str());
+            assert(set_ops::intersection(p_1, p_2).pieces().empty() and error_msg.str().c_str());
         }
     }
 #endif //PARTITION_SANITY_CHECK
@@ -214,47 +494,145 @@ void sanity_check(const WeightedSBGraph &graph, PartitionMap& partitions_set, un
 
 string get_output(const PartitionMap& partition_map)
 {
-    rapidjson::Document json_doc;
-    rapidjson::Document::AllocatorType& allocator = json_doc.GetAllocator();
-    json_doc.SetObject();
+    rapidjson::StringBuffer s;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(s);
+    write_partitions(writer, partition_map);
+
+    return string(s.GetString(), s.GetSize());
+}
 
-    rapidjson::Value obj_partitions(rapidjson::kArrayType);
+
+bool write_json_file(const string& filename, const function<void(JsonFileWriter&)>& write)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char buffer[output_buffer_size];
+    rapidjson::FileWriteStream os(file, buffer, sizeof(buffer));
+    JsonFileWriter writer(os);
+    write(writer);
+    os.Put('\n');
+    os.Flush();
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 and ok;
+
+    return ok;
+}
+
+
+bool write_output(const PartitionMap& partition_map, const string& filename)
+{
+    return write_json_file(filename, [&partition_map] (JsonFileWriter& writer) {
+        write_partitions(writer, partition_map);
+    });
+}
+
+
+bool write_binary_output(const PartitionMap& partition_map, const string& filename)
+{
+    binary_output::Header header;
+    memcpy(header.magic, binary_output::MAGIC, sizeof(binary_output::MAGIC));
+    header.version = binary_output::VERSION;
+    header.number_of_partitions = partition_map.size();
+    // readers reject 0 dimensions, even if every partition is empty
+    header.dimensions = 1;
+
+    vector<uint64_t> pieces;
+    pieces.reserve(partition_map.size());
     for (size_t i = 0; i < partition_map.size(); i++) {
-        rapidjson::Value obj_partition(rapidjson::kArrayType);
         const auto& partition = partition_map.at(i);
+        pieces.push_back(partition.pieces().size());
         for (const SetPiece& set_piece : partition.pieces()) {
-            rapidjson::Value obj_intervals(rapidjson::kArrayType);
-            obj_intervals.SetArray();
+            header.dimensions = max(header.dimensions, uint32_t(set_piece.intervals().size()));
+        }
+    }
+
+    ofstream output(filename, ios::binary);
+    if (not output) {
+        return false;
+    }
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(pieces.data()), pieces.size() * sizeof(uint64_t));
+
+    const binary_output::Range empty_range{1, 0};
+    for (size_t i = 0; i < partition_map.size(); i++) {
+        for (const SetPiece& set_piece : partition_map.at(i).pieces()) {
             for (const Interval& interval : set_piece.intervals()) {
-                rapidjson::Value obj_interval(rapidjson::kArrayType);
-                rapidjson::Value begin(rapidjson::kNumberType);
-                begin.SetUint(interval.begin());
-                obj_interval.PushBack(begin, allocator);
-                rapidjson::Value end(rapidjson::kNumberType);
-                end.SetUint(interval.end());
-                obj_interval.PushBack(end, allocator);
-
-                obj_intervals.PushBack(obj_interval, allocator);
+                binary_output::Range range{static_cast<int64_t>(interval.begin()), static_cast<int64_t>(interval.end())};
+                output.write(reinterpret_cast<const char*>(&range), sizeof(range));
             }
 
-            obj_partition.PushBack(obj_intervals, allocator);
+            for (size_t d = set_piece.intervals().size(); d < header.dimensions; d++) {
+                output.write(reinterpret_cast<const char*>(&empty_range), sizeof(empty_range));
+            }
         }
+    }
+
+    output.close();
+
+    return not output.fail();
+}
 
-        rapidjson::Value obj_nodes(rapidjson::kObjectType);
-        obj_nodes.AddMember("nodes", obj_partition, allocator);
 
-        obj_partitions.PushBack(obj_nodes, allocator);
+bool read_partition(const string& filename, const WeightedSBGraph& graph, PartitionMap& partitions)
+{
+    partitions.clear();
+
+    bool ok;
+    if (ends_with(filename, ".json")) {
+        ok = read_json_partition(filename, partitions);
+    } else if (ends_with(filename, ".bin")) {
+        ok = read_binary_partition(filename, partitions);
+    } else {
+        ok = read_flat_partition(filename, graph, partitions);
     }
 
-    json_doc.AddMember("partitions", obj_partitions, allocator);
+    if (not ok) {
+        return false;
+    }
 
-    // Write the JSON data to the file
-    rapidjson::StringBuffer s;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(s);
-    json_doc.Accept(writer);
-    string json_data = string(s.GetString());
+    // each element of the graph should be in exactly one partition: partitions must not
+    // overlap, and their union must be the node set of the graph
+    OrdSet covered;
+    size_t elements = 0;
+    for (const auto& [i, partition] : partitions) {
+        if (not isEmpty(set_ops::intersection(covered, partition))) {
+            cerr << filename << ": partition " << i << " overlaps with a previous partition" << endl;
+            return false;
+        }
+        covered = set_ops::cup(covered, partition);
+
+        for (const auto& set_piece : partition.pieces()) {
+            elements += cardinality(set_piece);
+        }
+    }
+
+    if (not isEmpty(set_ops::difference(graph.V(), covered))) {
+        cerr << filename << " does not cover every element of the graph" << endl;
+        return false;
+    }
+
+    if (not isEmpty(set_ops::difference(covered, graph.V()))) {
+        cerr << filename << " has elements that are not in the graph" << endl;
+        return false;
+    }
+
+    // once the union is the node set, a larger count means that set pieces of the same
+    // partition overlap
+    size_t graph_elements = 0;
+    for (const auto& set_piece : graph.V().pieces()) {
+        graph_elements += cardinality(set_piece);
+    }
+    if (elements != graph_elements) {
+        cerr << filename << " has " << elements << " elements, but the graph has " << graph_elements << endl;
+        return false;
+    }
 
-    return json_data;
+    return true;
 }
 
 
@@ -19,8 +19,14 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
+#include <memory>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/writer.h>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <sbg/interval.hpp>
 #include <sbg/sbg.hpp>
@@ -38,36 +44,148 @@ enum PartitionAlgorithm
     DISTRIBUTED = 1
 };
 
+namespace search {
+struct Adjacency;
+}
+
+
+/// Fraction of the total weight each partition should take, given the relative target
+/// weight of each partition, e.g. the speed of the cores of each rank. If targets is
+/// empty, or it doesn't have a target for each partition, they all take the same.
+std::vector<float> target_fractions(const std::vector<float>& targets, unsigned number_of_partitions);
+
+
+/// Largest number of partitions parse_partitions accepts.
+constexpr unsigned max_number_of_partitions = 1 << 16;
+
+/// Parses a list of numbers of partitions, as the -p argument: a number, a comma
+/// separated list of numbers, or a range first:last[:step], which can be mixed, e.g.
+/// 2,3,4:64:4. Repeated numbers are added once. Returns false if it is not valid, e.g.
+/// it has a sign, or a number is 0 or greater than max_number_of_partitions.
+bool parse_partitions(const std::string& arg, std::vector<unsigned>& numbers_of_partitions);
+
 // I wish this was a separate function, not part of PartitionGraph but there were a lot of
 // compile problems if partitions map object is created locally and OrdSet objects are added.
 std::vector<PartitionMap>
 make_initial_partitions(
-    WeightedSBGraph& graph,
-    unsigned number_of_partitions);
+    const WeightedSBGraph& graph,
+    unsigned number_of_partitions,
+    std::shared_ptr<const search::Adjacency> adjacency = nullptr,
+    const std::vector<float>& targets = std::vector<float>());
 
 
+/// adjacency is the DFS adjacency of graph (see search::make_adjacency), so it can be
+/// computed once for several numbers of partitions. It is computed here if it is null.
+/// targets are the relative target weights of the partitions (see target_fractions).
 PartitionMap
 best_initial_partition(
-    WeightedSBGraph& graph,
-    unsigned number_of_partitions);
+    const WeightedSBGraph& graph,
+    unsigned number_of_partitions,
+    std::shared_ptr<const search::Adjacency> adjacency = nullptr,
+    const std::vector<float>& targets = std::vector<float>());
 
 
-/// Returns the connectivity set of a set of edges contained in map1 and map2 of
-/// the graph (I mean, edges in CanonSBG::map1()[edge_index] and CanonSBG::map2()[edge_index]).
-/// So that, we consider the graph as an undirected graph.
+/// Initial partition of graph made by a DFS with a single strategy, Greedy or Distributive.
+PartitionMap initial_partition(
+    const WeightedSBGraph& graph,
+    unsigned number_of_partitions,
+    PartitionAlgorithm strategy,
+    const std::vector<float>& targets = std::vector<float>());
+
+
+/// Returns the connectivity set of a partition, that is, the set of edges with one end
+/// in the partition and the other one outside it. Edges are those in
+/// CanonSBG::map1()[edge_index] and CanonSBG::map2()[edge_index], so we consider the
+/// graph as an undirected graph.
+/// The boundary of the partition is computed once, regardless of the number of partitions.
 SBG::LIB::OrdSet get_connectivity_set(
-    SBG::LIB::CanonSBG& graph,
+    const SBG::LIB::CanonSBG& graph,
+    const PartitionMap& partitions,
+    size_t partition_index);
+
+
+/// Same as get_connectivity_set, but the edges are split according to the partition
+/// their other end belongs to. Partitions not connected to partition_index are not
+/// included in the result.
+std::map<unsigned, SBG::LIB::OrdSet> get_connectivity_set_by_partition(
+    const SBG::LIB::CanonSBG& graph,
     const PartitionMap& partitions,
-    size_t edge_index);
+    size_t partition_index);
 
 
 /// This function returns the cardinality of a OrdSet.
 size_t get_OrdSet_size(const SBG::LIB::OrdSet& set);
 
 
+/// Writes each partition as an array of set pieces, and each set piece as an array
+/// of intervals, straight to the writer's stream. Writer is a rapidjson SAX writer.
+/// This is the "partitions" member of the json output. If cores_per_node is not 0,
+/// partition i is written along with its node, i / cores_per_node, and its core,
+/// i % cores_per_node (see hierarchical_partition).
+template<typename Writer>
+void write_partitions_array(Writer& writer, const PartitionMap& partition_map, unsigned cores_per_node = 0)
+{
+    writer.StartArray();
+    for (size_t i = 0; i < partition_map.size(); i++) {
+        writer.StartObject();
+        if (cores_per_node > 0) {
+            writer.Key("node");
+            writer.Uint(i / cores_per_node);
+            writer.Key("core");
+            writer.Uint(i % cores_per_node);
+        }
+        writer.Key("nodes");
+        writer.StartArray();
+        for (const SBG::LIB::SetPiece& set_piece : partition_map.at(i).pieces()) {
+            writer.StartArray();
+            for (const SBG::LIB::Interval& interval : set_piece.intervals()) {
+                writer.StartArray();
+                writer.Uint(interval.begin());
+                writer.Uint(interval.end());
+                writer.EndArray();
+            }
+            writer.EndArray();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+}
+
+
+/// Returns the partition in json format.
 std::string get_output(const PartitionMap& partition_map);
 
 
+/// Writer of the json output files, it streams straight to a buffered file.
+using JsonFileWriter = rapidjson::Writer<rapidjson::FileWriteStream>;
+
+/// Creates filename and calls write to write a json value to it with a JsonFileWriter,
+/// followed by a new line. Returns false if the file could not be written.
+bool write_json_file(const std::string& filename, const std::function<void(JsonFileWriter&)>& write);
+
+
+/// Writes the partition in json format to filename. The output is streamed to the
+/// file while the partition is traversed, so no intermediate document or string is
+/// built. Returns false if the file could not be written.
+bool write_output(const PartitionMap& partition_map, const std::string& filename);
+
+
+/// Writes the partition to filename in the binary format described in
+/// partition_binary_format.hpp, which can be memory-mapped by binary_output::Reader.
+/// Returns false if the file could not be written.
+bool write_binary_output(const PartitionMap& partition_map, const std::string& filename);
+
+
+/// Reads a partition of graph from filename, to be used as an initial partition. The
+/// format is given by the extension: .json for write_output files, .bin for
+/// write_binary_output files, and otherwise a text file with the partition of each
+/// element per line, as classic partitioners write them (see ElementIndex for the order
+/// of the elements). Returns false, printing why, if it can not be read, its partitions
+/// or set pieces overlap, or their union is not the node set of graph.
+bool read_partition(const std::string& filename, const WeightedSBGraph& graph, PartitionMap& partitions);
+
+
 void sanity_check(const WeightedSBGraph& graph, PartitionMap& partitions_set, unsigned number_of_partitions);
 
 
@@ -151,6 +151,9 @@ int main(int argc, char** argv)
         auto wg = build_sb_graph(*filename);
         cout << "graph created " << wg << endl;
         auto partitions = metrics::read_partition_from_file(f, wg);
+        if (partitions.empty()) {
+          continue;
+        }
 
         int edge_cut = metrics::edge_cut(partitions, wg);
 
@@ -17,12 +17,17 @@
  ******************************************************************************/
 
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
 #include <set>
 
 #include <sbg/sbg.hpp>
 
 #include "build_sb_graph.hpp"
+#include "element_index.hpp"
+#include "owner_vector.hpp"
 #include "partition_metrics_api.hpp"
 #include "weighted_sb_graph.hpp"
 
@@ -217,13 +222,27 @@ pair<int, int> communication_volume(const PartitionMap& partitions, const Weight
 }
 
 
-float maximum_imbalance(const PartitionMap& partitions, const WeightedSBGraph& sb_graph)
+float maximum_imbalance(const PartitionMap& partitions, const WeightedSBGraph& sb_graph, const vector<float>& targets)
 {
     unsigned number_of_nodes = get_node_size(sb_graph.V(), sb_graph.get_node_weights());
-    float expected_imb = number_of_nodes / partitions.size();
+    const auto fractions = target_fractions(targets, partitions.size());
+
+    // Empty partitions, e.g. of the ranks of a topology with no partition mapped to them,
+    // don't take any load
+    unsigned non_empty_partitions = 0;
+    for (const auto& [i, p] : partitions) {
+        if (not p.pieces().empty()) {
+            non_empty_partitions++;
+        }
+    }
 
     float max_imbalance = 0.;
     for (const auto& [i, p] : partitions) {
+        if (p.pieces().empty()) {
+            continue;
+        }
+
+        float expected_imb = targets.empty() ? number_of_nodes / non_empty_partitions : number_of_nodes * fractions[i];
         unsigned size_of_p = get_node_size(p, sb_graph.get_node_weights());
         float imbalance_p = abs(expected_imb - float(size_of_p)) / expected_imb;
         max_imbalance = max(max_imbalance, imbalance_p);
@@ -243,16 +262,28 @@ PartitionMap read_partition_from_file(const string& name, const WeightedSBGraph&
 
     PartitionMap partitions;
     if (file.is_open()) {
-        // Read each line from the file and store it in the
-        // 'line' variable.
-        int node_counter = 0;
+        // Read each line from the file, the partition of each element in the order
+        // of ElementIndex, and compress them back into set pieces.
+        ElementIndex index(sb_graph.V());
+        vector<uint32_t> owner;
+        uint32_t number_of_partitions = 0;
         while (getline(file, line)) {
-            partitions[stoi(line)].emplaceBack(Interval(node_counter, 1, node_counter));
-            node_counter++;
+            // a partition id, below the number of elements as there can not be more partitions
+            const char* end = line.data() + line.size();
+            unsigned long long value = 0;
+            auto [last, error] = from_chars(line.data(), end, value);
+            if (error != errc() or last != end or value >= index.size()) {
+                cerr << name << ": invalid partition \"" << line << "\" in line " << owner.size() + 1 << endl;
+                return PartitionMap();
+            }
+            owner.push_back(value);
+            number_of_partitions = max(number_of_partitions, owner.back() + 1);
         }
 
-        for (auto& [i, s] : partitions) {
-            flatten_set(s, sb_graph);
+        if (owner.size() == index.size()) {
+            partitions = compress_owner_vector(owner.data(), index, number_of_partitions);
+        } else {
+            cerr << name << " has " << owner.size() << " elements, but the graph has " << index.size() << endl;
         }
 
         // Close the file stream once all lines have been
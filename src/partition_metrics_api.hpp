@@ -37,8 +37,13 @@ int edge_cut(const PartitionMap& partitions, const WeightedSBGraph& sb_graph);
 
 std::pair<int, int> communication_volume(const PartitionMap& partitions, const WeightedSBGraph& sb_graph);
 
-float maximum_imbalance(const PartitionMap& partitions, const WeightedSBGraph& sb_graph);
+/// Imbalance of each partition relative to its target weight, see PartitionOptions::targets.
+/// If targets is empty, every partition expects the same weight.
+float maximum_imbalance(
+    const PartitionMap& partitions, const WeightedSBGraph& sb_graph, const std::vector<float>& targets = std::vector<float>());
 
+/// Reads a partition with the partition of each element in a line, e.g. of Metis.
+/// Returns an empty map, printing why, if it can not be read.
 PartitionMap read_partition_from_file(const std::string& name, const WeightedSBGraph& sb_graph);
 
 std::ostream& operator<<(std::ostream& os, const communication_metrics& comm_metrics);
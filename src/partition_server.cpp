@@ -0,0 +1,477 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <poll.h>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "build_sb_graph.hpp"
+#include "kernighan_lin_partitioner.hpp"
+#include "partition_server.hpp"
+#include "sbg_partitioner_log.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+// How often, in ms, blocked calls wake up to check if the server was stopped
+constexpr int poll_timeout = 200;
+
+constexpr size_t receive_buffer_size = 64 * 1024;
+
+// Requests are lines, a connection sending more than this without a new line is closed
+constexpr size_t max_request_size = 64 * 1024 * 1024;
+
+
+using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+
+string error_response(const rapidjson::Value* id, const string& error)
+{
+    rapidjson::StringBuffer s;
+    Writer writer(s);
+    writer.StartObject();
+    if (id != nullptr) {
+        writer.Key("id");
+        id->Accept(writer);
+    }
+    writer.Key("error");
+    writer.String(error.c_str(), error.size());
+    writer.EndObject();
+
+    return string(s.GetString(), s.GetSize());
+}
+
+
+bool send_all(int fd, const string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += n;
+    }
+
+    return true;
+}
+
+
+/// Reads the unsigned member name of request into value, if it is there.
+/// Returns false if it is there but it is not an unsigned number.
+bool read_unsigned(const rapidjson::Value& request, const char* name, unsigned& value)
+{
+    if (not request.HasMember(name)) {
+        return true;
+    }
+
+    if (not request[name].IsUint()) {
+        return false;
+    }
+
+    value = request[name].GetUint();
+
+    return true;
+}
+
+
+bool read_number(const rapidjson::Value& request, const char* name, double& value)
+{
+    if (not request.HasMember(name)) {
+        return true;
+    }
+
+    if (not request[name].IsNumber()) {
+        return false;
+    }
+
+    value = request[name].GetDouble();
+
+    return true;
+}
+
+}
+
+
+GraphCache::GraphCache(size_t capacity)
+    : _capacity(max(capacity, size_t(1)))
+{
+}
+
+
+GraphCache::GraphPtr GraphCache::get(const string& key, const function<WeightedSBGraph()>& build)
+{
+    promise<GraphPtr> graph_promise;
+    shared_future<GraphPtr> graph;
+    bool cached = true;
+    {
+        lock_guard<mutex> lock(_mutex);
+
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            // move it to the front, it is the most recently used now
+            _entries.splice(_entries.begin(), _entries, it->second);
+            graph = it->second->second;
+        } else {
+            graph = graph_promise.get_future().share();
+            cached = false;
+            _entries.emplace_front(key, graph);
+            _index[key] = _entries.begin();
+
+            if (_entries.size() > _capacity) {
+                _index.erase(_entries.back().first);
+                _entries.pop_back();
+            }
+        }
+    }
+
+    // build it out of the lock, so other graphs can be used meanwhile
+    if (not cached) {
+        try {
+            graph_promise.set_value(make_shared<const WeightedSBGraph>(build()));
+        } catch (...) {
+            graph_promise.set_exception(current_exception());
+
+            // don't keep failures, the next request tries to build it again
+            lock_guard<mutex> lock(_mutex);
+            auto it = _index.find(key);
+            if (it != _index.end()) {
+                _entries.erase(it->second);
+                _index.erase(it);
+            }
+        }
+    }
+
+    return graph.get();
+}
+
+
+size_t GraphCache::size() const
+{
+    lock_guard<mutex> lock(_mutex);
+
+    return _entries.size();
+}
+
+
+PartitionServer::PartitionServer(const string& socket_path, size_t cache_capacity, size_t max_connections)
+    : _socket_path(socket_path),
+      _cache(cache_capacity),
+      _listen_fd(-1),
+      _stopped(false),
+      _connections(0),
+      _max_connections(max(max_connections, size_t(1)))
+{
+}
+
+
+PartitionServer::~PartitionServer()
+{
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+        unlink(_socket_path.c_str());
+    }
+}
+
+
+bool PartitionServer::run()
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (_socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path " << _socket_path << " is too long" << endl;
+        return false;
+    }
+    strncpy(address.sun_path, _socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_listen_fd < 0) {
+        cerr << "Unable to create socket: " << strerror(errno) << endl;
+        return false;
+    }
+
+    // remove the socket of a previous run, if any
+    unlink(_socket_path.c_str());
+    if (bind(_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 or listen(_listen_fd, SOMAXCONN) != 0) {
+        cerr << "Unable to listen on " << _socket_path << ": " << strerror(errno) << endl;
+        close(_listen_fd);
+        _listen_fd = -1;
+        return false;
+    }
+
+    logging::service_log << "listening on " << _socket_path << endl;
+
+    while (not _stopped) {
+        // once there are max_connections, new ones wait in the listen queue
+        {
+            unique_lock<mutex> lock(_connections_mutex);
+            auto has_room = [this] () { return _connections < _max_connections; };
+            if (not _connections_done.wait_for(lock, chrono::milliseconds(poll_timeout), has_room)) {
+                continue;
+            }
+        }
+
+        pollfd listen_poll{_listen_fd, POLLIN, 0};
+        if (poll(&listen_poll, 1, poll_timeout) <= 0) {
+            continue;
+        }
+
+        int fd = accept(_listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        {
+            lock_guard<mutex> lock(_connections_mutex);
+            _connections++;
+        }
+
+        thread([this, fd] () {
+            serve_connection(fd);
+            close(fd);
+
+            lock_guard<mutex> lock(_connections_mutex);
+            _connections--;
+            _connections_done.notify_all();
+        }).detach();
+    }
+
+    unique_lock<mutex> lock(_connections_mutex);
+    _connections_done.wait(lock, [this] () { return _connections == 0; });
+
+    close(_listen_fd);
+    _listen_fd = -1;
+    unlink(_socket_path.c_str());
+
+    return true;
+}
+
+
+void PartitionServer::stop()
+{
+    _stopped = true;
+}
+
+
+void PartitionServer::serve_connection(int fd)
+{
+    string pending;
+    char buffer[receive_buffer_size];
+    while (not _stopped) {
+        pollfd connection_poll{fd, POLLIN, 0};
+        int ready = poll(&connection_poll, 1, poll_timeout);
+        if (ready == 0 or (ready < 0 and errno == EINTR)) {
+            continue;
+        }
+
+        ssize_t n = ready > 0 ? recv(fd, buffer, sizeof(buffer), 0) : -1;
+        if (n <= 0) {
+            return;
+        }
+        pending.append(buffer, n);
+
+        // answer every complete line received so far
+        size_t start = 0;
+        for (size_t end = pending.find('\n'); end != string::npos; end = pending.find('\n', start)) {
+            string request = pending.substr(start, end - start);
+            start = end + 1;
+            if (request.find_first_not_of(" \t\r") == string::npos) {
+                continue;
+            }
+
+            if (not send_all(fd, handle_request(request) + "\n")) {
+                return;
+            }
+        }
+        pending.erase(0, start);
+
+        if (pending.size() > max_request_size) {
+            send_all(fd, error_response(nullptr, "request is larger than " + to_string(max_request_size) + " bytes") + "\n");
+            return;
+        }
+    }
+}
+
+
+string PartitionServer::handle_request(const string& request_str)
+{
+    rapidjson::Document request;
+    request.Parse(request_str.c_str(), request_str.size());
+    if (request.HasParseError() or not request.IsObject()) {
+        return error_response(nullptr, "request is not a json object");
+    }
+
+    const rapidjson::Value* id = request.HasMember("id") ? &request["id"] : nullptr;
+
+    PartitionOptions options;
+    options.threads = 1;
+    double epsilon = 0.0;
+    if (not request.HasMember("k") or not read_unsigned(request, "k", options.number_of_partitions)
+        or options.number_of_partitions == 0) {
+        return error_response(id, "k should be a positive integer");
+    }
+
+    if (not read_number(request, "epsilon", epsilon) or epsilon < 0 or epsilon > 1) {
+        return error_response(id, "epsilon should be a number between 0 and 1");
+    }
+    options.epsilon = epsilon;
+
+    if (not read_unsigned(request, "threads", options.threads) or not read_unsigned(request, "max_iterations", options.max_iterations)
+        or not read_number(request, "time_budget", options.time_budget) or options.time_budget < 0) {
+        return error_response(id, "threads, max_iterations and time_budget should be non-negative numbers");
+    }
+
+    // requests are served concurrently, so none of them takes more than the hardware threads
+    options.threads = min(options.threads, max(thread::hardware_concurrency(), 1u));
+
+    if (request.HasMember("strategy")) {
+        const string strategy = request["strategy"].IsString() ? request["strategy"].GetString() : "";
+        if (strategy == "greedy") {
+            options.strategy = GREEDY;
+        } else if (strategy == "distributive") {
+            options.strategy = DISTRIBUTED;
+        } else {
+            return error_response(id, "strategy should be greedy or distributive");
+        }
+    }
+
+    if (request.HasMember("targets")) {
+        const rapidjson::Value& targets = request["targets"];
+        bool valid = targets.IsArray() and targets.Size() == options.number_of_partitions;
+        for (rapidjson::SizeType i = 0; valid and i < targets.Size(); i++) {
+            valid = targets[i].IsNumber() and targets[i].GetDouble() > 0;
+            if (valid) {
+                options.targets.push_back(targets[i].GetDouble());
+            }
+        }
+        if (not valid) {
+            return error_response(id, "targets should be an array of k positive numbers");
+        }
+    }
+
+    // Graphs are cached by path and modification time, or by contents if they are inline
+    string key;
+    function<WeightedSBGraph()> build;
+    if (request.HasMember("model") and request["model"].IsString()) {
+        const string model = request["model"].GetString();
+        struct stat model_stat;
+        if (stat(model.c_str(), &model_stat) != 0) {
+            return error_response(id, "unable to open " + model);
+        }
+
+        key = "model:" + model + ":" + to_string(model_stat.st_mtime);
+        build = [model] () { return build_sb_graph(model); };
+    } else if (request.HasMember("graph") and request["graph"].IsObject()) {
+        const auto& graph = request["graph"];
+        if (not graph.HasMember("nodes") or not graph["nodes"].IsArray()) {
+            return error_response(id, "graph has no nodes");
+        }
+
+        rapidjson::StringBuffer s;
+        Writer writer(s);
+        graph.Accept(writer);
+        string json(s.GetString(), s.GetSize());
+
+        string error;
+        if (not validate_model(json, error)) {
+            return error_response(id, "invalid graph: " + error);
+        }
+
+        // the whole contents are the key, so different graphs never share an entry
+        key = "graph:" + json;
+        build = [json = move(json)] () { return build_sb_graph_from_json(json); };
+    } else {
+        return error_response(id, "either model or graph should be given");
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    GraphCache::GraphPtr graph;
+    try {
+        graph = _cache.get(key, build);
+    } catch (const exception& e) {
+        return error_response(id, string("unable to build the graph: ") + e.what());
+    } catch (...) {
+        return error_response(id, "unable to build the graph");
+    }
+    long double time_to_get_graph = chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start).count();
+
+    // a graph the partitioner can not handle fails this request only, not the service
+    PartitionResult result;
+    try {
+        result = partitionate_graph(*graph, options);
+    } catch (const exception& e) {
+        return error_response(id, string("unable to partition the graph: ") + e.what());
+    } catch (...) {
+        return error_response(id, "unable to partition the graph");
+    }
+    const auto& statistics = result.statistics;
+
+    rapidjson::StringBuffer s;
+    Writer writer(s);
+    writer.StartObject();
+    if (id != nullptr) {
+        writer.Key("id");
+        id->Accept(writer);
+    }
+    writer.Key("partitions");
+    write_partitions_array(writer, result.partitions);
+    writer.Key("statistics");
+    writer.StartObject();
+    writer.Key("time_to_get_graph");
+    writer.Double(time_to_get_graph);
+    writer.Key("time_to_initial_partition");
+    writer.Double(statistics.time_to_initial_partition);
+    writer.Key("time_to_refine");
+    writer.Double(statistics.time_to_refine);
+    writer.Key("iterations");
+    writer.Uint(statistics.iterations);
+    writer.Key("budget_exhausted");
+    writer.Bool(statistics.budget_exhausted);
+    writer.Key("edge_cut");
+    writer.Uint(statistics.edge_cut);
+    writer.Key("maximum_imbalance");
+    writer.Double(statistics.maximum_imbalance);
+    writer.EndObject();
+    writer.EndObject();
+
+    return string(s.GetString(), s.GetSize());
+}
+
+}
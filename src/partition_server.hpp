@@ -0,0 +1,112 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "weighted_sb_graph.hpp"
+
+
+namespace sbg_partitioner {
+
+/// Least recently used cache of built sb graphs. Graphs are shared with the requests
+/// using them, so evicting one doesn't invalidate them. If several requests need the
+/// same graph at the same time, it is built once and the rest of them wait for it.
+class GraphCache
+{
+public:
+    using GraphPtr = std::shared_ptr<const WeightedSBGraph>;
+
+    explicit GraphCache(size_t capacity);
+
+    /// Returns the graph cached as key, calling build to get it if it is not cached.
+    GraphPtr get(const std::string& key, const std::function<WeightedSBGraph()>& build);
+
+    size_t size() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_future<GraphPtr>>;
+
+    size_t _capacity;
+    mutable std::mutex _mutex;
+    std::list<Entry> _entries;  // most recently used first
+    std::map<std::string, std::list<Entry>::iterator> _index;
+};
+
+
+/// Partitioning service: it listens on a Unix domain socket and answers partition
+/// requests, one json object per line, so graphs are built once and kept in a
+/// GraphCache between requests. Each connection is served by its own thread, up to
+/// max_connections at the same time, the rest wait to be accepted. Requests of a
+/// connection are answered in order, and they use at most as many threads as the
+/// hardware has.
+///
+/// Request: {"id": ..., "model": "path.json" | "graph": {...}, "k": 4, "epsilon": 0.05,
+///           "strategy": "distributive" | "greedy", "threads": 1, "max_iterations": 0,
+///           "time_budget": 0}
+/// Response: {"id": ..., "partitions": [...], "statistics": {...}} or {"id": ..., "error": "..."}
+///
+/// Only "k" and either "model" or "graph" are required, see PartitionOptions for the rest.
+/// "id" is echoed back as it is. Inline graphs are checked with validate_model before
+/// they are built, and they are cached by their whole contents.
+class PartitionServer
+{
+public:
+    PartitionServer(const std::string& socket_path, size_t cache_capacity, size_t max_connections = 64);
+
+    PartitionServer(const PartitionServer&) = delete;
+    PartitionServer& operator=(const PartitionServer&) = delete;
+
+    ~PartitionServer();
+
+    /// Serves requests until stop is called. Returns false if the socket can not be created.
+    bool run();
+
+    /// Makes run return once the connections being served are closed. It is
+    /// async-signal-safe, so it can be called from a signal handler.
+    void stop();
+
+    /// Answers a single request line, it is what run does for each line it receives.
+    std::string handle_request(const std::string& request);
+
+private:
+    void serve_connection(int fd);
+
+    std::string _socket_path;
+    GraphCache _cache;
+    int _listen_fd;
+    std::atomic<bool> _stopped;
+
+    std::mutex _connections_mutex;
+    std::condition_variable _connections_done;
+    size_t _connections;
+    size_t _max_connections;
+};
+
+}
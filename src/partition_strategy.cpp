@@ -20,8 +20,10 @@
 #include <bits/stdc++.h>
 
 #include "build_sb_graph.hpp"
+#include "partition_graph.hpp"
 #include "partition_strategy.hpp"
 #include "sbg_partitioner_log.hpp"
+#include "trace.hpp"
 
 
 #define DEBUG_PARTITION_STRATEGY_ENABLED 0
@@ -34,11 +36,14 @@ using namespace SBG::LIB;
 namespace sbg_partitioner {
 
 
-PartitionStrategyGreedy::PartitionStrategyGreedy(unsigned number_of_partitions, const WeightedSBGraph graph)
+PartitionStrategyGreedy::PartitionStrategyGreedy(unsigned number_of_partitions, const WeightedSBGraph graph, const vector<float>& targets)
     : PartitionStrategy(),
     _number_of_partitions(number_of_partitions),
     _current_partition(0),
-    _node_weight(graph.get_node_weights())
+    _node_weight(graph.get_node_weights()),
+    _constraint_weights(graph.get_constraint_weights()),
+    _expected_constraint_size(_constraint_weights.size()),
+    _current_constraint_size(_constraint_weights.size())
 {
     // get total of nodes by accumulating all interval values
     _total_of_nodes = get_node_size(graph.V(), NodeWeight());
@@ -48,12 +53,45 @@ PartitionStrategyGreedy::PartitionStrategyGreedy(unsigned number_of_partitions,
     unsigned surplus = actual_total_of_nodes % number_of_partitions;
     // unsigned acceptable_surplus = ceil(min_amount_by_partition * 0.05);
 
-    logging::sbg_log << "PartitionStrategyGreedy::PartitionStrategyGreedy " << actual_total_of_nodes << ", " << min_amount_by_partition << ", " << surplus << endl;
-    _expected_size_by_partition = min_amount_by_partition + surplus;
+    logging::strategy_log << "PartitionStrategyGreedy::PartitionStrategyGreedy " << actual_total_of_nodes << ", " << min_amount_by_partition << ", " << surplus << endl;
+
+    // Each partition expects its fraction of the total, or the same if there are no targets
+    const auto fractions = target_fractions(targets, number_of_partitions);
+    auto expected_size = [&targets, number_of_partitions, &fractions] (size_t total, unsigned i) {
+        return targets.empty() ? unsigned(total / number_of_partitions + total % number_of_partitions) : unsigned(ceil(total * fractions[i]));
+    };
 
     for (unsigned i = 0; i < number_of_partitions; i++) {
         _current_size_by_partition[i] = 0;
+        _expected_size_by_partition[i] = expected_size(actual_total_of_nodes, i);
     }
+
+    for (size_t c = 0; c < _constraint_weights.size(); c++) {
+        size_t total = get_node_size(graph.V(), _constraint_weights[c]);
+        for (unsigned i = 0; i < number_of_partitions; i++) {
+            _expected_constraint_size[c][i] = expected_size(total, i);
+            _current_constraint_size[c][i] = 0;
+        }
+    }
+}
+
+
+/// Sorts partitions by how full they are relative to their expected size.
+vector<unsigned> sort_keys_by_load(const map<unsigned, unsigned>& current_size_by_partition, const map<unsigned, unsigned>& expected_size_by_partition)
+{
+    vector<unsigned> keys;
+    keys.reserve(current_size_by_partition.size());
+
+    for (const auto& it : current_size_by_partition) {
+        keys.push_back(it.first);
+    }
+
+    sort(keys.begin(), keys.end(), [&current_size_by_partition, &expected_size_by_partition](const auto& a, const auto& b) {
+        return uint64_t(current_size_by_partition.at(a)) * expected_size_by_partition.at(b)
+            < uint64_t(current_size_by_partition.at(b)) * expected_size_by_partition.at(a);
+    });
+
+    return keys;
 }
 
 
@@ -74,8 +112,10 @@ vector<unsigned> sort_keys_by_value(const map<unsigned, unsigned>& current_size_
 
 void PartitionStrategyGreedy::operator() (const SetPiece& node)
 {
+    trace::Span span("greedy_strategy", "initial partition");
+
 #if DEBUG_PARTITION_STRATEGY_ENABLED
-    logging::sbg_log << "Adding node " << node << endl;
+    logging::strategy_log << "Adding node " << node << endl;
 #endif
     OrdSet node_to_be_added = node;
 
@@ -84,19 +124,36 @@ void PartitionStrategyGreedy::operator() (const SetPiece& node)
     unsigned pending_node_elements = get_node_size(node, NodeWeight());
     unsigned node_weight = get_set_cost(node, _node_weight);
 
-    auto keys_sort_by_value = sort_keys_by_value(_current_size_by_partition);
+    vector<unsigned> constraint_weight;
+    for (const auto& weights : _constraint_weights) {
+        constraint_weight.push_back(get_set_cost(node, weights));
+    }
+
+    auto keys_sort_by_value = sort_keys_by_load(_current_size_by_partition, _expected_size_by_partition);
     for (const auto i : keys_sort_by_value) {
-        if (_expected_size_by_partition > _current_size_by_partition[i]) { // nothing to do for now
-            auto available = _expected_size_by_partition - _current_size_by_partition[i];
+        if (_expected_size_by_partition[i] > _current_size_by_partition[i]) { // nothing to do for now
+            auto available = _expected_size_by_partition[i] - _current_size_by_partition[i];
             unsigned elements_can_take = available / node_weight;
+
+            // it can't take more than what fits in any of the other constraints
+            for (size_t c = 0; c < _constraint_weights.size(); c++) {
+                auto& current = _current_constraint_size[c][i];
+                unsigned expected = _expected_constraint_size[c][i];
+                unsigned available_c = expected > current ? expected - current : 0;
+                elements_can_take = min(elements_can_take, constraint_weight[c] > 0 ? available_c / constraint_weight[c] : elements_can_take);
+            }
+
             elements_can_take = min(pending_node_elements, elements_can_take);
             pending_node_elements -= elements_can_take;
             size_by_partition[i] = elements_can_take * node_weight;
             _current_size_by_partition[i] += size_by_partition[i];
+            for (size_t c = 0; c < _constraint_weights.size(); c++) {
+                _current_constraint_size[c][i] += elements_can_take * constraint_weight[c];
+            }
         }
     }
 
-    keys_sort_by_value = sort_keys_by_value(_current_size_by_partition);
+    keys_sort_by_value = sort_keys_by_load(_current_size_by_partition, _expected_size_by_partition);
     if (pending_node_elements > 0) {
         // look for the partion that has least elements
         unsigned p = keys_sort_by_value.front();
@@ -105,6 +162,9 @@ void PartitionStrategyGreedy::operator() (const SetPiece& node)
 
         size_by_partition[p] += to_be_added;
         _current_size_by_partition[p] += to_be_added;
+        for (size_t c = 0; c < _constraint_weights.size(); c++) {
+            _current_constraint_size[c][p] += pending_node_elements * constraint_weight[c];
+        }
     }
 
     OrdSet remaining_node = OrdSet(node);
@@ -134,15 +194,25 @@ map<unsigned, set<SetPiece>> PartitionStrategyGreedy::partitions() const
 /* PartitionStrategyDistributive */
 
 
-PartitionStrategyDistributive::PartitionStrategyDistributive(unsigned number_of_partitions, const WeightedSBGraph graph)
+PartitionStrategyDistributive::PartitionStrategyDistributive(unsigned number_of_partitions, const WeightedSBGraph graph, const vector<float>& targets)
     : PartitionStrategy(),
     _number_of_partitions(number_of_partitions),
     _nodes(graph.V()),
-    _node_weight(graph.get_node_weights())
+    _node_weight(graph.get_node_weights()),
+    _fractions(targets.empty() ? vector<float>() : target_fractions(targets, number_of_partitions)),
+    _constraint_weights(graph.get_constraint_weights()),
+    _current_constraint_size(_constraint_weights.size())
 {
     for (unsigned i = 0; i < _number_of_partitions; i++) {
         auto p = make_pair(i, 0);
         _current_size_by_partition.insert(p);
+        for (auto& current : _current_constraint_size) {
+            current.insert(p);
+        }
+    }
+
+    for (const auto& weights : _constraint_weights) {
+        _total_constraint_size.push_back(max(get_node_size(graph.V(), weights), 1u));
     }
 }
 
@@ -166,7 +236,7 @@ void add_surplus_sorting_by_value(const map<unsigned, unsigned>& current_size_by
 
     // Print the sorted value
     for (const auto& it : current_size_by_partition_vector) {
-        logging::sbg_log << "surplus " << it.first << ", " << size_by_partition[it.first] << endl;
+        logging::strategy_log << "surplus " << it.first << ", " << size_by_partition[it.first] << endl;
         size_by_partition[it.first]++;
         surplus--;
         if (surplus == 0) {
@@ -180,8 +250,10 @@ void add_surplus_sorting_by_value(const map<unsigned, unsigned>& current_size_by
 
 void PartitionStrategyDistributive::operator() (const SBG::LIB::SetPiece& node)
 {
+    trace::Span span("distributive_strategy", "initial partition");
+
 #if DEBUG_PARTITION_STRATEGY_ENABLED
-    logging::sbg_log << "Adding " << node << " distributively to partitions" << endl;
+    logging::strategy_log << "Adding " << node << " distributively to partitions" << endl;
 #endif
     auto s = get_node_size(node, NodeWeight());
     unsigned size_by_part = s / _number_of_partitions;
@@ -193,14 +265,39 @@ void PartitionStrategyDistributive::operator() (const SBG::LIB::SetPiece& node)
         size_by_partition[i] = size_by_part;
     }
 
-    if (surplus > 0) {
+    // with targets, each partition takes its fraction of the node
+    if (not _fractions.empty()) {
+        unsigned assigned = 0;
+        for (auto& [i, size] : size_by_partition) {
+            size = floor(s * _fractions[i]);
+            assigned += size;
+        }
+        surplus = s - assigned;
+    }
+
+    if (surplus > 0 and _constraint_weights.empty() and _fractions.empty()) {
         add_surplus_sorting_by_value(_current_size_by_partition, size_by_partition, surplus);
+    } else if (surplus > 0) {
+        // the surplus goes to the partitions with the least load in their heaviest
+        // constraint, each constraint relative to its total and to the partition target
+        unsigned total = max(get_node_size(_nodes, _node_weight), 1u);
+        map<unsigned, unsigned> load_by_partition;
+        for (const auto& [i, size] : _current_size_by_partition) {
+            float fraction = _fractions.empty() ? 1.0 / _number_of_partitions : _fractions[i];
+            unsigned load = size * 1000.0 / (total * fraction);
+            for (size_t c = 0; c < _constraint_weights.size(); c++) {
+                load = max(load, unsigned(_current_constraint_size[c][i] * 1000.0 / (_total_constraint_size[c] * fraction)));
+            }
+            load_by_partition[i] = load;
+        }
+
+        add_surplus_sorting_by_value(load_by_partition, size_by_partition, surplus);
     }
 
     OrdSet node_to_be_added = node;
     for (const auto [i, n] : size_by_partition) {
 #if DEBUG_PARTITION_STRATEGY_ENABLED
-        logging::sbg_log << "For partition " << i << " size: " << n << endl;
+        logging::strategy_log << "For partition " << i << " size: " << n << endl;
 #endif
         if (size_by_partition[i] == 0) {
             continue;
@@ -210,10 +307,13 @@ void PartitionStrategyDistributive::operator() (const SBG::LIB::SetPiece& node)
 
         tie(temp_node, node_to_be_added) = cut_interval_by_dimension(node_to_be_added, NodeWeight(), size_by_partition[i]);
 #if DEBUG_PARTITION_STRATEGY_ENABLED
-        logging::sbg_log << "About to add " << temp_node << " to " << i << ", remaining: " << node_to_be_added << endl;
+        logging::strategy_log << "About to add " << temp_node << " to " << i << ", remaining: " << node_to_be_added << endl;
 #endif
         for_each(temp_node.begin(), temp_node.end(), [&p](const SetPiece& s) { p.insert(s); });
         _current_size_by_partition[i] += get_node_size(temp_node, _node_weight);
+        for (size_t c = 0; c < _constraint_weights.size(); c++) {
+            _current_constraint_size[c][i] += get_node_size(temp_node, _constraint_weights[c]);
+        }
     }
 }
 
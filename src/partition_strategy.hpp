@@ -24,6 +24,7 @@
 #include <utility>
 #include <stdlib.h>
 #include <set>
+#include <vector>
 
 #include "sbg/sbg.hpp"
 #include "weighted_sb_graph.hpp"
@@ -46,7 +47,8 @@ public:
 class PartitionStrategyGreedy : public PartitionStrategy
 {
 public:
-    PartitionStrategyGreedy(unsigned number_of_partitions, const WeightedSBGraph graph);
+    /// targets are the relative target weights of the partitions, see target_fractions.
+    PartitionStrategyGreedy(unsigned number_of_partitions, const WeightedSBGraph graph, const std::vector<float>& targets = std::vector<float>());
 
     virtual ~PartitionStrategyGreedy() = default;
 
@@ -61,9 +63,14 @@ private:
     unsigned _acceptable_surplus;
     unsigned _acceptable_amount;
     std::map<unsigned, std::set<SBG::LIB::SetPiece>> _partitions;
-    size_t _expected_size_by_partition;
+    std::map<unsigned, unsigned> _expected_size_by_partition;
     std::map<unsigned, unsigned> _current_size_by_partition;
     NodeWeight _node_weight;
+
+    // Same as above for the other balance constraints of the graph
+    std::vector<NodeWeight> _constraint_weights;
+    std::vector<std::map<unsigned, unsigned>> _expected_constraint_size;
+    std::vector<std::map<unsigned, unsigned>> _current_constraint_size;
 };
 
 
@@ -78,7 +85,7 @@ struct SizeCmp
 class PartitionStrategyDistributive : public PartitionStrategy
 {
 public:
-    PartitionStrategyDistributive(unsigned number_of_partitions, const WeightedSBGraph graph);
+    PartitionStrategyDistributive(unsigned number_of_partitions, const WeightedSBGraph graph, const std::vector<float>& targets = std::vector<float>());
 
     virtual ~PartitionStrategyDistributive() = default;
 
@@ -96,6 +103,14 @@ private:
     std::map<unsigned, unsigned> _current_size_by_partition;
     SBG::LIB::OrdSet _nodes;
     NodeWeight _node_weight;
+
+    // Fraction of each node that goes to each partition, empty if they all take the same
+    std::vector<float> _fractions;
+
+    // Same as above for the other balance constraints of the graph, and their totals
+    std::vector<NodeWeight> _constraint_weights;
+    std::vector<unsigned> _total_constraint_size;
+    std::vector<std::map<unsigned, unsigned>> _current_constraint_size;
 };
 
 std::ostream& operator<<(std::ostream& os, const PartitionStrategy& pgraph);
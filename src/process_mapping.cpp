@@ -0,0 +1,288 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "process_mapping.hpp"
+#include "sbg_partitioner_log.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+/// Swap passes over every pair of ranks, each one only continues if the previous one improved.
+constexpr unsigned max_swap_passes = 10;
+
+
+/// Communication cost of partition p if it is on rank, with the rest of the partitions
+/// on their ranks in rank_of_partition. Partitions without rank are not counted.
+unsigned long partition_cost(
+    const QuotientGraph& quotient_graph,
+    const Topology& topology,
+    const vector<unsigned>& rank_of_partition,
+    unsigned p,
+    unsigned rank)
+{
+    unsigned long cost = 0;
+    for (const auto& [q, weight] : quotient_graph.adjacents(p)) {
+        if (q != p and rank_of_partition[q] != numeric_limits<unsigned>::max()) {
+            cost += (unsigned long)weight * topology.distance(rank, rank_of_partition[q]);
+        }
+    }
+
+    return cost;
+}
+
+
+unsigned long mapping_cost(const QuotientGraph& quotient_graph, const Topology& topology, const vector<unsigned>& rank_of_partition)
+{
+    unsigned long cost = 0;
+    for (unsigned p = 0; p < rank_of_partition.size(); p++) {
+        cost += partition_cost(quotient_graph, topology, rank_of_partition, p, rank_of_partition[p]);
+    }
+
+    // each edge was counted from both ends
+    return cost / 2;
+}
+
+
+vector<unsigned> greedy_mapping(const QuotientGraph& quotient_graph, const Topology& topology)
+{
+    const unsigned number_of_partitions = quotient_graph.size();
+    constexpr unsigned unassigned = numeric_limits<unsigned>::max();
+    vector<unsigned> rank_of_partition(number_of_partitions, unassigned);
+    vector<bool> free_rank(topology.size(), true);
+
+    // communication of each unplaced partition with the placed ones, and in total
+    vector<unsigned long> placed_communication(number_of_partitions, 0);
+    vector<unsigned long> total_communication(number_of_partitions, 0);
+    for (unsigned p = 0; p < number_of_partitions; p++) {
+        for (const auto& [q, weight] : quotient_graph.adjacents(p)) {
+            total_communication[p] += weight;
+        }
+    }
+
+    for (unsigned placed = 0; placed < number_of_partitions; placed++) {
+        // the partition that communicates the most with the placed ones, and with the
+        // rest to break ties, so the first one is the one that communicates the most
+        unsigned p = unassigned;
+        for (unsigned q = 0; q < number_of_partitions; q++) {
+            if (rank_of_partition[q] != unassigned) {
+                continue;
+            }
+            if (p == unassigned or placed_communication[q] > placed_communication[p]
+                or (placed_communication[q] == placed_communication[p] and total_communication[q] > total_communication[p])) {
+                p = q;
+            }
+        }
+
+        // the free rank closest to the partitions it communicates with
+        unsigned best_rank = unassigned;
+        unsigned long best_cost = numeric_limits<unsigned long>::max();
+        for (unsigned rank = 0; rank < topology.size(); rank++) {
+            if (not free_rank[rank]) {
+                continue;
+            }
+            unsigned long cost = partition_cost(quotient_graph, topology, rank_of_partition, p, rank);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_rank = rank;
+            }
+        }
+
+        rank_of_partition[p] = best_rank;
+        free_rank[best_rank] = false;
+        for (const auto& [q, weight] : quotient_graph.adjacents(p)) {
+            placed_communication[q] += weight;
+        }
+    }
+
+    return rank_of_partition;
+}
+
+
+/// Swaps the ranks of pairs of partitions, or moves a partition to a free rank, while
+/// the cost improves.
+void refine_mapping(const QuotientGraph& quotient_graph, const Topology& topology, vector<unsigned>& rank_of_partition)
+{
+    constexpr unsigned no_partition = numeric_limits<unsigned>::max();
+    vector<unsigned> partition_of_rank(topology.size(), no_partition);
+    for (unsigned p = 0; p < rank_of_partition.size(); p++) {
+        partition_of_rank[rank_of_partition[p]] = p;
+    }
+
+    auto cost_at = [&] (unsigned p, unsigned rank) {
+        return p == no_partition ? 0 : partition_cost(quotient_graph, topology, rank_of_partition, p, rank);
+    };
+
+    bool improved = true;
+    for (unsigned pass = 0; improved and pass < max_swap_passes; pass++) {
+        improved = false;
+        for (unsigned r1 = 0; r1 < topology.size(); r1++) {
+            for (unsigned r2 = r1 + 1; r2 < topology.size(); r2++) {
+                unsigned p1 = partition_of_rank[r1];
+                unsigned p2 = partition_of_rank[r2];
+                if (p1 == no_partition and p2 == no_partition) {
+                    continue;
+                }
+
+                // cost_at(p1, r2) still sees p2 on r2, so the edge between p1 and p2 is only
+                // counted before the swap, but its distance doesn't change
+                long between = 0;
+                if (p1 != no_partition and p2 != no_partition) {
+                    between = 2l * quotient_graph.weight(p1, p2) * topology.distance(r1, r2);
+                }
+                long before = cost_at(p1, r1) + cost_at(p2, r2) - between;
+                long after = cost_at(p1, r2) + cost_at(p2, r1);
+
+                if (after < before) {
+                    if (p1 != no_partition) {
+                        rank_of_partition[p1] = r2;
+                    }
+                    if (p2 != no_partition) {
+                        rank_of_partition[p2] = r1;
+                    }
+                    swap(partition_of_rank[r1], partition_of_rank[r2]);
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+}
+
+
+Topology::Topology(vector<TopologyLevel> levels)
+    : _levels(move(levels))
+{
+    for (const auto& level : _levels) {
+        _size *= level.arity;
+    }
+}
+
+
+unsigned Topology::distance(unsigned r1, unsigned r2) const
+{
+    unsigned cost = 0;
+    for (const auto& level : _levels) {
+        if (r1 == r2) {
+            break;
+        }
+
+        cost = level.cost;
+        r1 /= level.arity;
+        r2 /= level.arity;
+    }
+
+    return cost;
+}
+
+
+bool read_topology(const string& filename, Topology& topology)
+{
+    ifstream ifs(filename);
+    if (not ifs) {
+        cerr << "Unable to open " << filename << endl;
+        return false;
+    }
+
+    vector<TopologyLevel> levels;
+    string line;
+    for (size_t line_number = 1; getline(ifs, line); line_number++) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos or line[first] == '#') {
+            continue;
+        }
+
+        TopologyLevel level;
+        istringstream fields(line);
+        if (not (fields >> level.name >> level.arity >> level.cost) or level.arity == 0) {
+            cerr << filename << ":" << line_number << " should be name arity cost" << endl;
+            return false;
+        }
+
+        levels.push_back(level);
+    }
+
+    if (levels.empty()) {
+        cerr << filename << " has no levels" << endl;
+        return false;
+    }
+
+    topology = Topology(move(levels));
+
+    return true;
+}
+
+
+ProcessMapping map_processes(const QuotientGraph& quotient_graph, const Topology& topology)
+{
+    ProcessMapping mapping;
+    if (topology.size() < quotient_graph.size()) {
+        cerr << "The topology has " << topology.size() << " ranks for " << quotient_graph.size() << " partitions" << endl;
+        return mapping;
+    }
+
+    vector<unsigned> identity(quotient_graph.size());
+    for (unsigned p = 0; p < identity.size(); p++) {
+        identity[p] = p;
+    }
+    mapping.initial_communication_cost = mapping_cost(quotient_graph, topology, identity);
+
+    mapping.rank_of_partition = greedy_mapping(quotient_graph, topology);
+    logging::sbg_log << "greedy mapping cost " << mapping_cost(quotient_graph, topology, mapping.rank_of_partition) << endl;
+
+    refine_mapping(quotient_graph, topology, mapping.rank_of_partition);
+    mapping.communication_cost = mapping_cost(quotient_graph, topology, mapping.rank_of_partition);
+
+    logging::sbg_log << "mapping cost " << mapping.communication_cost
+                     << ", it was " << mapping.initial_communication_cost << endl;
+
+    return mapping;
+}
+
+
+PartitionMap renumber_partitions(const PartitionMap& partitions, const ProcessMapping& mapping, unsigned number_of_ranks)
+{
+    PartitionMap renumbered;
+    for (unsigned rank = 0; rank < number_of_ranks; rank++) {
+        renumbered[rank];
+    }
+
+    for (const auto& [p, partition] : partitions) {
+        renumbered[mapping.rank_of_partition[p]] = partition;
+    }
+
+    return renumbered;
+}
+
+}
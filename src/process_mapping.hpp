@@ -0,0 +1,98 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "partition_graph.hpp"
+#include "quotient_graph.hpp"
+
+
+namespace sbg_partitioner {
+
+/// A level of a machine: each element of the level above has arity elements of this
+/// one, and communicating between two ranks whose closest common element is one of this
+/// level costs cost, e.g. the cores of a socket, the sockets of a node or the nodes of a rack.
+struct TopologyLevel {
+    std::string name;
+    unsigned arity;
+    unsigned cost;
+};
+
+
+/// Tree of the ranks of a machine, given by its levels from the innermost one, the
+/// cores, to the outermost one. Ranks are numbered as the leaves of the tree, so the
+/// ranks of a socket, a node and so on are consecutive.
+class Topology
+{
+public:
+    Topology() = default;
+    Topology(std::vector<TopologyLevel> levels);
+
+    /// Number of ranks, the product of the arities of all levels.
+    unsigned size() const { return _size; }
+
+    /// Cost of communicating ranks r1 and r2, the cost of the outermost level where they
+    /// are in different elements, 0 if they are the same rank.
+    unsigned distance(unsigned r1, unsigned r2) const;
+
+    const std::vector<TopologyLevel>& levels() const { return _levels; }
+
+private:
+    std::vector<TopologyLevel> _levels;
+    unsigned _size = 1;
+};
+
+
+/// Reads a topology from filename, a text file with a "name arity cost" line for each
+/// level, from the innermost one, e.g.:
+/// core 8 1
+/// socket 2 4
+/// node 16 20
+/// Empty lines and lines starting with # are ignored.
+/// Returns false, printing why, if it can not be read.
+bool read_topology(const std::string& filename, Topology& topology);
+
+
+/// Rank of each partition of a partition mapped onto a topology.
+struct ProcessMapping {
+    std::vector<unsigned> rank_of_partition;
+    unsigned long communication_cost = 0;          // sum of edge cut by distance between ranks
+    unsigned long initial_communication_cost = 0;  // the same, with partition i on rank i
+};
+
+
+/// Assigns a rank of topology to each partition of quotient_graph, minimizing the edge cut
+/// between partitions weighted by the distance between their ranks. Partitions are placed
+/// greedily, the one that communicates the most with the placed ones first on the free
+/// rank closest to them, and then pairs of ranks are swapped while the cost improves.
+/// topology must have at least a rank for each partition, otherwise rank_of_partition is empty.
+ProcessMapping map_processes(const QuotientGraph& quotient_graph, const Topology& topology);
+
+
+/// Returns partitions renumbered by mapping, with a partition for each of the
+/// number_of_ranks ranks, empty for the ranks no partition was mapped to. The outputs
+/// give partition r to rank r by its position, so the ranks in between are padded, and
+/// metrics::maximum_imbalance and flat_metrics skip empty partitions.
+PartitionMap renumber_partitions(const PartitionMap& partitions, const ProcessMapping& mapping, unsigned number_of_ranks);
+
+}
@@ -0,0 +1,127 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include "build_sb_graph.hpp"
+#include "quotient_graph.hpp"
+#include "sbg_partitioner_log.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+
+
+namespace sbg_partitioner {
+
+QuotientGraph::QuotientGraph(const WeightedSBGraph& graph, const PartitionMap& partitions)
+    : _graph(graph)
+{
+    for (const auto& [i, _] : partitions) {
+        _adjacency[i];
+    }
+
+    for (const auto& [i, _] : partitions) {
+        update_partition(partitions, i);
+    }
+
+    logging::sbg_log << "Quotient graph: " << *this << endl;
+}
+
+
+void QuotientGraph::update(const PartitionMap& partitions, unsigned i, unsigned j)
+{
+    update_partition(partitions, i);
+    update_partition(partitions, j);
+
+    logging::sbg_log << "Quotient graph updated for " << i << " and " << j << ": " << *this << endl;
+}
+
+
+void QuotientGraph::update_partition(const PartitionMap& partitions, unsigned i)
+{
+    // remove old edges, in both directions
+    auto& adjacents = _adjacency[i];
+    for (const auto& [j, _] : adjacents) {
+        _adjacency[j].erase(i);
+    }
+    adjacents.clear();
+
+    const auto edge_costs = _graph.get_edge_costs();
+    for (const auto& [j, edges] : get_connectivity_set_by_partition(_graph, partitions, i)) {
+        unsigned cost = get_edge_set_cost(edges, edge_costs);
+        adjacents[j] = cost;
+        _adjacency[j][i] = cost;
+    }
+}
+
+
+bool QuotientGraph::connected(unsigned i, unsigned j) const
+{
+    const auto& adjacents = _adjacency.at(i);
+    return adjacents.find(j) != adjacents.end();
+}
+
+
+unsigned QuotientGraph::weight(unsigned i, unsigned j) const
+{
+    const auto& adjacents = _adjacency.at(i);
+    auto it = adjacents.find(j);
+
+    return it != adjacents.end() ? it->second : 0;
+}
+
+
+const map<unsigned, unsigned>& QuotientGraph::adjacents(unsigned i) const
+{
+    return _adjacency.at(i);
+}
+
+
+unsigned QuotientGraph::edge_cut() const
+{
+    unsigned acc = 0;
+    for (const auto& [i, adjacents] : _adjacency) {
+        for (const auto& [j, cost] : adjacents) {
+            // each edge is stored twice
+            if (i < j) {
+                acc += cost;
+            }
+        }
+    }
+
+    return acc;
+}
+
+
+ostream& operator<<(ostream& os, const QuotientGraph& quotient_graph)
+{
+    os << "{ ";
+    for (size_t i = 0; i < quotient_graph.size(); i++) {
+        for (const auto& [j, cost] : quotient_graph.adjacents(i)) {
+            if (i < j) {
+                os << "(" << i << ", " << j << ") ↦ " << cost << ", ";
+            }
+        }
+    }
+    os << "}";
+
+    return os;
+}
+
+}
@@ -0,0 +1,73 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <iostream>
+#include <map>
+
+#include "partition_graph.hpp"
+#include "weighted_sb_graph.hpp"
+
+
+namespace sbg_partitioner {
+
+/// Quotient graph of a partition: there is a node for each partition and an edge
+/// between two partitions if at least one edge of the sb graph connects them. Each
+/// edge is weighted with the cost of the sb graph edges it represents, i.e. the
+/// edge cut between both partitions.
+/// It is built once, and then only the partitions modified by a swap have to be
+/// updated, so we don't need to intersect every pair of partitions to know which
+/// of them are connected.
+class QuotientGraph
+{
+public:
+    /// @note graph object should live while this class does
+    QuotientGraph(const WeightedSBGraph& graph, const PartitionMap& partitions);
+
+    /// Recomputes the adjacency of partitions i and j. It must be called every time
+    /// those partitions are modified.
+    void update(const PartitionMap& partitions, unsigned i, unsigned j);
+
+    bool connected(unsigned i, unsigned j) const;
+
+    /// Returns the cost of the edges between partitions i and j, 0 if they are not connected.
+    unsigned weight(unsigned i, unsigned j) const;
+
+    /// Returns the partitions connected to i and the cost of the edges between them.
+    const std::map<unsigned, unsigned>& adjacents(unsigned i) const;
+
+    /// Sum of the costs of all the edges of the quotient graph, that is, the edge cut
+    /// of the partition.
+    unsigned edge_cut() const;
+
+    size_t size() const { return _adjacency.size(); }
+
+private:
+    void update_partition(const PartitionMap& partitions, unsigned i);
+
+    const WeightedSBGraph& _graph;
+
+    std::map<unsigned, std::map<unsigned, unsigned>> _adjacency;
+};
+
+
+std::ostream& operator<<(std::ostream& os, const QuotientGraph& quotient_graph);
+
+}
@@ -0,0 +1,286 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "build_sb_graph.hpp"
+#include "element_index.hpp"
+#include "quotient_graph.hpp"
+#include "repartition.hpp"
+#include "sbg_partitioner_log.hpp"
+#include "set_ops.hpp"
+
+
+using namespace std;
+
+using namespace SBG::LIB;
+
+
+namespace sbg_partitioner {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+/// Nodes of partition p at an end of the edges that connect it to other partitions.
+OrdSet boundary_nodes(const WeightedSBGraph& graph, const OrdSet& partition, const OrdSet& edges)
+{
+    auto nodes = set_ops::cup(set_ops::image(edges, graph.map1()), set_ops::image(edges, graph.map2()));
+
+    return set_ops::intersection(nodes, partition);
+}
+
+
+/// Moves elements from overloaded partitions to their least loaded neighbors until every
+/// partition i weighs at most LMax[i], or no move is possible. Loads are relative to the
+/// target weight of each partition. Elements that belonged to the receiving partition in
+/// previous are moved first, then the rest of the boundary, and then any element if the
+/// partitions are not connected.
+void diffuse_load(
+    const WeightedSBGraph& graph, PartitionMap& partitions, const PartitionMap& previous,
+    const vector<unsigned>& target, const vector<unsigned>& LMax)
+{
+    set_ops::PhaseScope phase(set_ops::Phase::DIFFUSION);
+
+    const auto node_weights = graph.get_node_weights();
+
+    vector<unsigned> weights(partitions.size());
+    for (const auto& [i, partition] : partitions) {
+        weights[i] = get_node_size(partition, node_weights);
+    }
+
+    auto load = [&weights, &target] (unsigned i) { return float(weights[i]) / max(target[i], 1u); };
+    auto least_loaded = [&weights, &load] () {
+        unsigned q = 0;
+        for (unsigned i = 1; i < weights.size(); i++) {
+            if (load(i) < load(q)) {
+                q = i;
+            }
+        }
+        return q;
+    };
+
+    QuotientGraph quotient_graph(graph, partitions);
+
+    // each move fixes a partition or fills a receiving one, so this bounds the moves
+    const size_t max_moves = partitions.size() * partitions.size();
+    for (size_t move = 0; move < max_moves; move++) {
+        // the most overloaded partition
+        unsigned p = 0;
+        for (unsigned i = 1; i < weights.size(); i++) {
+            if (long(weights[i]) - LMax[i] > long(weights[p]) - LMax[p]) {
+                p = i;
+            }
+        }
+        if (weights[p] <= LMax[p]) {
+            break;
+        }
+
+        // least loaded neighbor, or the least loaded partition if it has no neighbors
+        unsigned q = p;
+        for (const auto& [j, cost] : quotient_graph.adjacents(p)) {
+            if (q == p or load(j) < load(q)) {
+                q = j;
+            }
+        }
+        if (q == p or weights[q] >= target[q]) {
+            q = least_loaded();
+        }
+
+        if (weights[q] >= target[q]) {
+            break;
+        }
+
+        const unsigned amount = min(weights[p] - target[p], target[q] - weights[q]);
+
+        OrdSet boundary;
+        auto connectivity = get_connectivity_set_by_partition(graph, partitions, p);
+        if (connectivity.find(q) != connectivity.end()) {
+            boundary = boundary_nodes(graph, partitions[p], connectivity[q]);
+        }
+
+        auto previous_q = previous.find(q);
+        OrdSet returning = previous_q != previous.end() ? set_ops::intersection(partitions[p], previous_q->second) : OrdSet();
+        OrdSet returning_boundary = set_ops::intersection(returning, boundary);
+
+        OrdSet moved;
+        for (const OrdSet& candidates : {returning_boundary, set_ops::difference(boundary, returning_boundary), returning, partitions[p]}) {
+            unsigned moved_weight = get_node_size(moved, node_weights);
+            if (moved_weight >= amount) {
+                break;
+            }
+            moved = set_ops::cup(moved, take_weight(set_ops::difference(candidates, moved), node_weights, amount - moved_weight));
+        }
+
+        if (isEmpty(moved)) {
+            break;
+        }
+
+        logging::repartition_log << "diffusion moves " << moved << " from " << p << " to " << q << endl;
+
+        unsigned moved_weight = get_node_size(moved, node_weights);
+        partitions[p] = set_ops::difference(partitions[p], moved);
+        partitions[q] = set_ops::cup(partitions[q], moved);
+        flatten_set(partitions[p], graph);
+        flatten_set(partitions[q], graph);
+        weights[p] -= moved_weight;
+        weights[q] += moved_weight;
+        quotient_graph.update(partitions, p, q);
+    }
+}
+
+}
+
+
+RepartitionResult repartition(
+    const WeightedSBGraph& graph, const PartitionMap& previous_partition, const PartitionOptions& options)
+{
+    // Diffusion and KL index partitions from 0 to k - 1, so previous partitions are
+    // renumbered in the order of their keys, and given their keys back at the end
+    vector<unsigned> keys;
+    PartitionMap previous;
+    for (const auto& [key, partition] : previous_partition) {
+        previous[keys.size()] = partition;
+        keys.push_back(key);
+    }
+
+    RepartitionResult result;
+    result.partitions = previous;
+
+    const unsigned number_of_partitions = previous.size();
+    const auto node_weights = graph.get_node_weights();
+    const unsigned total_weight = get_node_size(graph.V(), node_weights);
+    const auto fractions = target_fractions(options.targets, number_of_partitions);
+
+    vector<unsigned> target, LMax;
+    for (unsigned i = 0; i < number_of_partitions; i++) {
+        target.push_back(options.targets.empty() ? ceil(float(total_weight) / number_of_partitions) : ceil(total_weight * fractions[i]));
+        LMax.push_back(target[i] + unsigned(options.epsilon * target[i]));
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    diffuse_load(graph, result.partitions, previous, target, LMax);
+    auto end = chrono::high_resolution_clock::now();
+    result.statistics.time_to_initial_partition = chrono::duration<double, std::milli>(end - start).count();
+
+    PartitionOptions kl_options = options;
+    kl_options.number_of_partitions = number_of_partitions;
+    kl_options.previous_partition = &previous;
+    refine_partition(graph, result.partitions, kl_options, result.statistics);
+
+    compute_balance(graph, result.partitions, result.statistics, options.targets);
+
+    PartitionMap partitions;
+    for (auto& [i, partition] : result.partitions) {
+        partitions[keys[i]] = move(partition);
+    }
+    result.partitions = move(partitions);
+
+    result.moves = partition_moves(previous_partition, result.partitions);
+    for (const auto& move : result.moves) {
+        result.migrated += cardinality(move.nodes);
+    }
+
+    logging::repartition_log << "repartition migrates " << result.migrated << " elements" << endl;
+
+    return result;
+}
+
+
+bool repartition(
+    const string& filename,
+    const string& previous_partition_filename,
+    const PartitionOptions& options,
+    WeightedSBGraph& sb_graph,
+    RepartitionResult& result,
+    long double& time_to_build_graph,
+    const CostProfile& profile)
+{
+    auto start_build_graph = chrono::high_resolution_clock::now();
+    sb_graph = build_sb_graph(filename, profile);
+    auto end_build_graph = chrono::high_resolution_clock::now();
+    time_to_build_graph = chrono::duration<double, std::milli>(end_build_graph - start_build_graph).count();
+
+    PartitionMap previous_partition;
+    if (not read_partition(previous_partition_filename, sb_graph, previous_partition)) {
+        return false;
+    }
+
+    result = repartition(sb_graph, previous_partition, options);
+
+    return true;
+}
+
+
+vector<PartitionMove> partition_moves(const PartitionMap& previous, const PartitionMap& current)
+{
+    vector<PartitionMove> moves;
+    for (const auto& [from, previous_set] : previous) {
+        for (const auto& [to, current_set] : current) {
+            if (from == to) {
+                continue;
+            }
+
+            auto nodes = set_ops::intersection(previous_set, current_set);
+            if (not isEmpty(nodes)) {
+                moves.push_back(PartitionMove{from, to, nodes});
+            }
+        }
+    }
+
+    return moves;
+}
+
+
+bool write_moves(const vector<PartitionMove>& moves, size_t migrated, const string& filename)
+{
+    return write_json_file(filename, [&moves, migrated] (JsonFileWriter& writer) {
+        writer.StartObject();
+        writer.Key("migrated");
+        writer.Uint64(migrated);
+        writer.Key("moves");
+        writer.StartArray();
+        for (const auto& move : moves) {
+            writer.StartObject();
+            writer.Key("from");
+            writer.Uint(move.from);
+            writer.Key("to");
+            writer.Uint(move.to);
+            writer.Key("nodes");
+            writer.StartArray();
+            for (const SetPiece& set_piece : move.nodes.pieces()) {
+                writer.StartArray();
+                for (const Interval& interval : set_piece.intervals()) {
+                    writer.StartArray();
+                    writer.Uint(interval.begin());
+                    writer.Uint(interval.end());
+                    writer.EndArray();
+                }
+                writer.EndArray();
+            }
+            writer.EndArray();
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    });
+}
+
+}
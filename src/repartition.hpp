@@ -0,0 +1,83 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "kernighan_lin_partitioner.hpp"
+
+
+namespace sbg_partitioner {
+
+/// Elements that moved from a partition to another one between two partitions of a graph.
+struct PartitionMove {
+    unsigned from;
+    unsigned to;
+    SBG::LIB::OrdSet nodes;
+};
+
+
+struct RepartitionResult {
+    PartitionMap partitions;
+    std::vector<PartitionMove> moves;
+    size_t migrated = 0;     // number of elements that changed their partition
+    PartitionStatistics statistics;
+};
+
+
+/// Repartitions graph, whose weights changed since previous_partition was computed, moving
+/// as few elements as possible. Overloaded partitions first give elements to their least
+/// loaded neighbor partitions (diffusion), preferring elements that belonged to the
+/// receiving partition before, until every partition is below the imbalance bound. Then
+/// the partition is refined by KL with a migration term in the gain, weighted by
+/// options.migration_cost, so swaps only happen if the edge cut improvement pays for the
+/// migration. options.previous_partition is ignored, previous_partition is used instead.
+/// Partitions keep the keys they have in previous_partition, which need not be 0 to k - 1,
+/// and options.targets are given in the order of those keys. Empty previous partitions
+/// are kept, so diffusion fills them.
+RepartitionResult repartition(
+    const WeightedSBGraph& graph, const PartitionMap& previous_partition, const PartitionOptions& options);
+
+
+/// Same as above, but the updated graph is built from filename and the previous partition
+/// is read from previous_partition_filename (see read_partition).
+/// Returns false if the previous partition can not be read.
+bool repartition(
+    const std::string& filename,
+    const std::string& previous_partition_filename,
+    const PartitionOptions& options,
+    WeightedSBGraph& sb_graph,
+    RepartitionResult& result,
+    long double& time_to_build_graph,
+    const CostProfile& profile = CostProfile());
+
+
+/// Returns the elements that are in a different partition in current and previous.
+std::vector<PartitionMove> partition_moves(const PartitionMap& previous, const PartitionMap& current);
+
+
+/// Writes the moves in json format to filename:
+/// {"migrated": n, "moves": [{"from": i, "to": j, "nodes": [set pieces]}, ...]}
+/// where set pieces are written as in the partition output.
+/// Returns false if the file could not be written.
+bool write_moves(const std::vector<PartitionMove>& moves, size_t migrated, const std::string& filename);
+
+}
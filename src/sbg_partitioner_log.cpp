@@ -0,0 +1,304 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sbg_partitioner_log.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+namespace logging {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+#ifdef SBG_PARTITIONER_LOGGING
+constexpr Level default_level = Level::DEBUG;
+#else
+constexpr Level default_level = Level::WARNING;
+#endif
+
+/// Messages the queue holds before new ones are dropped.
+constexpr size_t queue_capacity = 8192;
+
+
+atomic<int> levels[number_of_categories] = {
+    {int(default_level)}, {int(default_level)}, {int(default_level)}, {int(default_level)},
+    {int(default_level)}, {int(default_level)}, {int(default_level)}
+};
+
+
+const char* level_name(Level level)
+{
+    static const char* names[] = {"error", "warning", "info", "debug", "trace"};
+    return names[int(level)];
+}
+
+
+const char* category_name(Category category)
+{
+    static const char* names[number_of_categories] = {"general", "build", "dfs", "strategy", "kl", "repartition", "service"};
+    return names[size_t(category)];
+}
+
+
+bool parse_level(const string& name, Level& level)
+{
+    for (int l = int(Level::ERROR); l <= int(Level::TRACE); l++) {
+        if (name == level_name(Level(l))) {
+            level = Level(l);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool parse_category(const string& name, Category& category)
+{
+    for (size_t c = 0; c < number_of_categories; c++) {
+        if (name == category_name(Category(c))) {
+            category = Category(c);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/// Writes the messages of a bounded ring buffer from a background thread, which is
+/// started with the first message.
+class Sink
+{
+public:
+    static Sink& instance()
+    {
+        static Sink _instance;
+        return _instance;
+    }
+
+    void push(string&& message)
+    {
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_size == _queue.size()) {
+                _dropped++;
+                return;
+            }
+
+            _queue[(_head + _size) % _queue.size()] = move(message);
+            _size++;
+
+            if (not _writer.joinable()) {
+                _writer = thread(&Sink::write_messages, this);
+            }
+        }
+        _not_empty.notify_one();
+    }
+
+    void flush()
+    {
+        unique_lock<mutex> lock(_mutex);
+        _empty.wait(lock, [this] () { return (_size == 0 and not _writing) or not _writer.joinable(); });
+        _output->flush();
+    }
+
+    bool set_output(const string& filename)
+    {
+        flush();
+
+        auto file = make_unique<ofstream>(filename);
+        if (not *file) {
+            return false;
+        }
+
+        // the writer thread may be writing a message logged after flush
+        unique_lock<mutex> lock(_mutex);
+        _empty.wait(lock, [this] () { return not _writing; });
+        _file.swap(file);
+        _output = _file.get();
+
+        return true;
+    }
+
+private:
+    Sink() : _queue(queue_capacity), _output(&cout) {}
+
+    ~Sink()
+    {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stop = true;
+        }
+        _not_empty.notify_one();
+
+        if (_writer.joinable()) {
+            _writer.join();
+        }
+    }
+
+    void write_messages()
+    {
+        unique_lock<mutex> lock(_mutex);
+        while (true) {
+            _not_empty.wait(lock, [this] () { return _size > 0 or _stop; });
+            if (_size == 0 and _stop) {
+                break;
+            }
+
+            // write outside the lock, so loggers don't wait for the output
+            string message = move(_queue[_head]);
+            _head = (_head + 1) % _queue.size();
+            _size--;
+            size_t dropped = _dropped;
+            _dropped = 0;
+            _writing = true;
+            ostream* output = _output;
+
+            lock.unlock();
+            if (dropped > 0) {
+                *output << "[warning][general] " << dropped << " log messages were dropped\n";
+            }
+            *output << message;
+            lock.lock();
+
+            _writing = false;
+            _empty.notify_all();
+            if (_size == 0) {
+                _output->flush();
+            }
+        }
+
+        _output->flush();
+    }
+
+    mutex _mutex;
+    condition_variable _not_empty;
+    condition_variable _empty;
+    vector<string> _queue;
+    size_t _head = 0;
+    size_t _size = 0;
+    size_t _dropped = 0;
+    bool _writing = false;
+    bool _stop = false;
+    thread _writer;
+    unique_ptr<ofstream> _file;
+    ostream* _output;
+};
+
+}
+
+
+void set_level(Level level)
+{
+    for (auto& category_level : levels) {
+        category_level.store(int(level), memory_order_relaxed);
+    }
+}
+
+
+void set_level(Category category, Level level)
+{
+    levels[size_t(category)].store(int(level), memory_order_relaxed);
+}
+
+
+bool enabled(Category category, Level level)
+{
+    return int(level) <= levels[size_t(category)].load(memory_order_relaxed);
+}
+
+
+bool configure(const string& spec)
+{
+    istringstream items(spec);
+    string item;
+    bool any = false;
+    while (getline(items, item, ',')) {
+        size_t equal = item.find('=');
+        Level level;
+        if (equal == string::npos) {
+            if (not parse_level(item, level)) {
+                return false;
+            }
+            set_level(level);
+        } else {
+            Category category;
+            if (not parse_category(item.substr(0, equal), category) or not parse_level(item.substr(equal + 1), level)) {
+                return false;
+            }
+            set_level(category, level);
+        }
+        any = true;
+    }
+
+    return any;
+}
+
+
+bool set_output(const string& filename)
+{
+    return Sink::instance().set_output(filename);
+}
+
+
+void flush()
+{
+    Sink::instance().flush();
+}
+
+
+LogStream::LogStream(Category category, Level level)
+{
+    if (enabled(category, level)) {
+        _message = make_unique<ostringstream>();
+        *_message << "[" << level_name(level) << "][" << category_name(category) << "] ";
+    }
+}
+
+
+LogStream::~LogStream()
+{
+    if (not _message) {
+        return;
+    }
+
+    string message = _message->str();
+    if (message.empty() or message.back() != '\n') {
+        message += '\n';
+    }
+
+    Sink::instance().push(move(message));
+}
+
+}
+}
@@ -17,57 +17,115 @@
 
  ******************************************************************************/
 
+
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
 
 
 namespace sbg_partitioner {
 
 namespace logging {
 
+enum class Level { ERROR, WARNING, INFO, DEBUG, TRACE };
 
-class SBGPartitionerLogger {
+/// Part of the partitioner a message comes from, each one has its own level.
+enum class Category { GENERAL, BUILD, DFS, STRATEGY, KL, REPARTITION, SERVICE };
 
-public:
+constexpr size_t number_of_categories = 7;
 
-    static SBGPartitionerLogger& instance()
-    {
-        static SBGPartitionerLogger _instance;
-        return _instance;
-    }
+
+/// Sets the level of every category. Messages above it are neither formatted nor written.
+/// By default it is Level::WARNING, or Level::DEBUG if SBG_PARTITIONER_LOGGING is defined.
+void set_level(Level level);
+
+void set_level(Category category, Level level);
+
+bool enabled(Category category, Level level);
+
+/// Sets the levels from a spec like "info" or "info,kl=debug,dfs=trace": a level for
+/// every category and then levels for some of them. Returns false if it is not valid.
+bool configure(const std::string& spec);
+
+/// Messages are written to filename instead of the standard output. Returns false if it
+/// can not be opened.
+bool set_output(const std::string& filename);
+
+/// Waits until every message logged so far is written.
+void flush();
+
+
+/// A message being logged. It is only formatted if its level is enabled for its category,
+/// and it is queued to be written by a background thread when it is destroyed, at the end
+/// of the statement that logs it. Messages are dropped if the queue is full, so logging
+/// never blocks the partitioner.
+class LogStream
+{
+public:
+    LogStream(Category category, Level level);
+    LogStream(LogStream&& other) = default;
+    ~LogStream();
 
     template<typename T>
-    SBGPartitionerLogger& operator << (const T& x)
+    LogStream& operator<<(const T& x)
     {
-#ifdef SBG_PARTITIONER_LOGGING
-        *log << x;
-#endif
+        if (_message) {
+            *_message << x;
+        }
         return *this;
     }
 
-    SBGPartitionerLogger& operator <<(std::ostream& (*os)(std::ostream&))
+    LogStream& operator<<(std::ostream& (*manipulator)(std::ostream&))
     {
-#ifdef SBG_PARTITIONER_LOGGING
-        *log << os;
-#endif
+        if (_message) {
+            *_message << manipulator;
+        }
         return *this;
     }
 
 private:
-    SBGPartitionerLogger()
+    std::unique_ptr<std::ostringstream> _message;
+};
+
+
+/// Logger of a category, logger << x logs at Level::DEBUG, and logger(level) << x at level.
+class CategoryLogger
+{
+public:
+    constexpr CategoryLogger(Category category) : _category(category) {}
+
+    template<typename T>
+    LogStream operator<<(const T& x) const
     {
-#ifdef SBG_PARTITIONER_LOGGING
-        log = &std::cout;
-#endif
+        LogStream stream(_category, Level::DEBUG);
+        stream << x;
+        return stream;
     }
 
-    ~SBGPartitionerLogger() = default;
+    LogStream operator<<(std::ostream& (*manipulator)(std::ostream&)) const
+    {
+        LogStream stream(_category, Level::DEBUG);
+        stream << manipulator;
+        return stream;
+    }
+
+    LogStream operator()(Level level) const { return LogStream(_category, level); }
 
-    std::ostream* log;
+private:
+    Category _category;
 };
 
-static SBGPartitionerLogger& sbg_log = SBGPartitionerLogger::instance();
 
+constexpr CategoryLogger sbg_log(Category::GENERAL);
+constexpr CategoryLogger build_log(Category::BUILD);
+constexpr CategoryLogger dfs_log(Category::DFS);
+constexpr CategoryLogger strategy_log(Category::STRATEGY);
+constexpr CategoryLogger kl_log(Category::KL);
+constexpr CategoryLogger repartition_log(Category::REPARTITION);
+constexpr CategoryLogger service_log(Category::SERVICE);
+
+}
 }
-}
\ No newline at end of file
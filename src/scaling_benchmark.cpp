@@ -0,0 +1,491 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "build_sb_graph.hpp"
+#include "kernighan_lin_partitioner.hpp"
+#include "memory_usage.hpp"
+#include "partition_metrics_api.hpp"
+
+
+using namespace std;
+
+using namespace sbg_partitioner;
+
+
+namespace {
+
+constexpr size_t output_buffer_size = 64 * 1024;
+
+/// Exit status when a scaling exponent is above the maximum one.
+constexpr int regression_status = 2;
+
+
+/// A partitioning of a model with a configuration of the sweep.
+struct Run {
+    string model;
+    size_t vertices = 0;
+    size_t edges = 0;
+    unsigned partitions = 0;
+    float epsilon = 0;
+    unsigned threads = 0;
+    double build_time = 0;      // ms
+    double initial_time = 0;    // ms
+    double refine_time = 0;     // ms
+    optional<size_t> peak_rss;  // bytes, nullopt if the peak of the run can not be measured
+    unsigned iterations = 0;
+    int edge_cut = 0;
+    int comm_volume = 0;
+    int max_comm_volume = 0;
+    float maximum_imbalance = 0;
+};
+
+
+/// Runs of a configuration of the sweep for different model sizes.
+using Configuration = tuple<unsigned, float, unsigned>;
+
+
+const vector<string> phases = {"build", "initial", "refine", "total", "peak_rss"};
+
+
+double phase_value(const Run& run, const string& phase)
+{
+    if (phase == "build") {
+        return run.build_time;
+    } else if (phase == "initial") {
+        return run.initial_time;
+    } else if (phase == "refine") {
+        return run.refine_time;
+    } else if (phase == "total") {
+        return run.build_time + run.initial_time + run.refine_time;
+    }
+
+    return run.peak_rss.value_or(0);
+}
+
+
+/// Slope of the least squares line of log(value) against log(vertices), that is, the
+/// exponent e of value ~ vertices^e. Runs of the same size are averaged first. It is not
+/// defined, nullopt, with less than two sizes.
+optional<double> scaling_exponent(const vector<const Run*>& runs, const string& phase)
+{
+    map<size_t, pair<double, unsigned>> by_size;
+    for (const Run* run : runs) {
+        double value = phase_value(*run, phase);
+        if (run->vertices > 0 and value > 0) {
+            by_size[run->vertices].first += value;
+            by_size[run->vertices].second++;
+        }
+    }
+
+    if (by_size.size() < 2) {
+        return nullopt;
+    }
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    const double n = by_size.size();
+    for (const auto& [size, values] : by_size) {
+        double x = log(double(size));
+        double y = log(values.first / values.second);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    double denominator = n * sxx - sx * sx;
+    if (denominator == 0) {
+        return nullopt;
+    }
+
+    return (n * sxy - sx * sy) / denominator;
+}
+
+
+/// Parses a comma separated list of values. Returns false if it is not valid.
+template<typename T>
+bool parse_list(const string& arg, vector<T>& values)
+{
+    istringstream items(arg);
+    string item;
+    while (getline(items, item, ',')) {
+        istringstream value_stream(item);
+        T value;
+        if (not (value_stream >> value) or not value_stream.eof()) {
+            return false;
+        }
+        values.push_back(value);
+    }
+
+    return not values.empty();
+}
+
+
+/// Models of a family given as a path with a {n} placeholder for the size, e.g.
+/// ../examples/air_conditioners_{n}.json, sorted by size.
+vector<string> family_models(const string& pattern)
+{
+    const auto placeholder = pattern.find("{n}");
+    if (placeholder == string::npos) {
+        return {pattern};
+    }
+
+    const filesystem::path path(pattern);
+    const filesystem::path directory = path.has_parent_path() ? path.parent_path() : filesystem::path(".");
+    const string name = path.filename().string();
+    const size_t name_placeholder = name.find("{n}");
+
+    // regex_replace escapes the rest of the name, so dots are matched literally
+    const regex special(R"([.^$|()\[\]{}*+?\\])");
+    const regex name_regex(
+        regex_replace(name.substr(0, name_placeholder), special, R"(\$&)") + "([0-9]+)"
+        + regex_replace(name.substr(name_placeholder + 3), special, R"(\$&)"));
+
+    vector<pair<unsigned long, string>> models;
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        smatch match;
+        const string file_name = entry.path().filename().string();
+        if (regex_match(file_name, match, name_regex)) {
+            models.emplace_back(stoul(match[1]), entry.path().string());
+        }
+    }
+    sort(models.begin(), models.end());
+
+    vector<string> result;
+    for (const auto& model : models) {
+        result.push_back(model.second);
+    }
+
+    return result;
+}
+
+
+/// Returns false if the file could not be written.
+bool write_results(
+    const string& filename,
+    const vector<Run>& runs,
+    const map<Configuration, map<string, optional<double>>>& exponents)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char buffer[output_buffer_size];
+    rapidjson::FileWriteStream os(file, buffer, sizeof(buffer));
+    rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(os);
+    writer.StartObject();
+
+    writer.Key("runs");
+    writer.StartArray();
+    for (const Run& run : runs) {
+        writer.StartObject();
+        writer.Key("model");
+        writer.String(run.model.c_str());
+        writer.Key("vertices");
+        writer.Uint64(run.vertices);
+        writer.Key("edges");
+        writer.Uint64(run.edges);
+        writer.Key("partitions");
+        writer.Uint(run.partitions);
+        writer.Key("epsilon");
+        writer.Double(run.epsilon);
+        writer.Key("threads");
+        writer.Uint(run.threads);
+        writer.Key("build_ms");
+        writer.Double(run.build_time);
+        writer.Key("initial_ms");
+        writer.Double(run.initial_time);
+        writer.Key("refine_ms");
+        writer.Double(run.refine_time);
+        writer.Key("peak_rss_bytes");
+        if (run.peak_rss) {
+            writer.Uint64(*run.peak_rss);
+        } else {
+            writer.Null();
+        }
+        writer.Key("iterations");
+        writer.Uint(run.iterations);
+        writer.Key("edge_cut");
+        writer.Int(run.edge_cut);
+        writer.Key("comm_volume");
+        writer.Int(run.comm_volume);
+        writer.Key("max_comm_volume");
+        writer.Int(run.max_comm_volume);
+        writer.Key("maximum_imbalance");
+        writer.Double(run.maximum_imbalance);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("exponents");
+    writer.StartArray();
+    for (const auto& [configuration, phase_exponents] : exponents) {
+        writer.StartObject();
+        writer.Key("partitions");
+        writer.Uint(get<0>(configuration));
+        writer.Key("epsilon");
+        writer.Double(get<1>(configuration));
+        writer.Key("threads");
+        writer.Uint(get<2>(configuration));
+        for (const auto& [phase, exponent] : phase_exponents) {
+            writer.Key(phase.c_str());
+            if (exponent) {
+                writer.Double(*exponent);
+            } else {
+                writer.Null();
+            }
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.EndObject();
+    os.Put('\n');
+    os.Flush();
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 and ok;
+
+    return ok;
+}
+
+}
+
+
+void usage()
+{
+    cout << "Usage sbg-partitioner-scaling" << endl;
+    cout << endl;
+    cout << "-h, --help          Display this information and exit" << endl;
+    cout << "-f, --filename      Path to a model, it can be repeated. A {n} in the path stands for the" << endl;
+    cout << "                    size of a family of models, e.g. ../examples/air_conditioners_{n}.json" << endl;
+    cout << "                    runs every model of the family, from the smallest to the largest." << endl;
+    cout << "-p, --partitions    Comma separated numbers of partitions, 4 by default." << endl;
+    cout << "-e, --epsilon       Comma separated imbalance epsilons, 0.05 by default." << endl;
+    cout << "-t, --threads       Comma separated numbers of KL threads, 1 by default (0 means all)." << endl;
+    cout << "-o, --output        Output json file with every run and the scaling exponents." << endl;
+    cout << "-x, --max-exponent  Maximum scaling exponent of the time of a phase, if one is larger" << endl;
+    cout << "                    the exit status is " << regression_status << "." << endl;
+    cout << endl;
+    cout << "SBG Partitioner home page: https://github.com/CIFASIS/sbg-partitioner " << endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    vector<string> models;
+    vector<unsigned> partitions;
+    vector<float> epsilons;
+    vector<unsigned> threads;
+    optional<string> output_file = nullopt;
+    optional<double> max_exponent = nullopt;
+
+    while (true) {
+        static struct option long_options[] = {
+            {"filename", required_argument, 0, 'f'},
+            {"partitions", required_argument, 0, 'p'},
+            {"epsilon", required_argument, 0, 'e'},
+            {"threads", required_argument, 0, 't'},
+            {"output", required_argument, 0, 'o'},
+            {"max-exponent", required_argument, 0, 'x'},
+            {"help", no_argument, 0, 'h'}
+        };
+
+        int option_index = 0;
+        int opt = getopt_long(argc, argv, "f:p:e:t:o:x:h", long_options, &option_index);
+        if (opt == EOF) break;
+
+        bool ok = true;
+        switch (opt) {
+        case 'f': {
+            auto family = family_models(optarg);
+            if (family.empty()) {
+                cerr << "No models match " << optarg << endl;
+                exit(1);
+            }
+            models.insert(models.end(), family.begin(), family.end());
+            break;
+        }
+
+        case 'p':
+            ok = parse_list(optarg, partitions);
+            break;
+
+        case 'e':
+            ok = parse_list(optarg, epsilons);
+            break;
+
+        case 't':
+            ok = parse_list(optarg, threads);
+            break;
+
+        case 'o':
+            output_file = string(optarg);
+            break;
+
+        case 'x':
+            max_exponent = atof(optarg);
+            break;
+
+        case 'h':
+            usage();
+            exit(0);
+
+        default:
+            usage();
+            exit(-1);
+        }
+
+        if (not ok) {
+            cerr << "Invalid argument " << optarg << endl;
+            usage();
+            exit(1);
+        }
+    }
+
+    if (models.empty()) {
+        usage();
+        exit(1);
+    }
+
+    if (partitions.empty()) {
+        partitions.push_back(4);
+    }
+    if (epsilons.empty()) {
+        epsilons.push_back(0.05);
+    }
+    if (threads.empty()) {
+        threads.push_back(1);
+    }
+
+    vector<Run> runs;
+    for (const string& model : models) {
+        // The graph of each model is built once for the whole sweep
+        auto start_build = chrono::high_resolution_clock::now();
+        WeightedSBGraph graph = build_sb_graph(model);
+        double build_time = chrono::duration<double, std::milli>(chrono::high_resolution_clock::now() - start_build).count();
+
+        const size_t vertices = get_OrdSet_size(graph.V());
+        size_t edges = 0;
+        for (const auto& map : graph.map1().maps()) {
+            edges += get_OrdSet_size(map.dom());
+        }
+        cout << model << ": " << vertices << " vertices, " << edges << " edges, built in " << build_time << " ms" << endl;
+
+        for (unsigned k : partitions) {
+            for (float epsilon : epsilons) {
+                for (unsigned t : threads) {
+                    PartitionOptions options;
+                    options.number_of_partitions = k;
+                    options.epsilon = epsilon;
+                    options.threads = t;
+
+                    // if it can not be reset, peak_rss is the peak of the whole process so far
+                    const bool peak_rss_available = memory_usage::reset_peak_rss();
+                    PartitionResult result = partitionate_graph(graph, options);
+
+                    Run run;
+                    run.model = model;
+                    run.vertices = vertices;
+                    run.edges = edges;
+                    run.partitions = k;
+                    run.epsilon = epsilon;
+                    run.threads = t;
+                    run.build_time = build_time;
+                    run.initial_time = result.statistics.time_to_initial_partition;
+                    run.refine_time = result.statistics.time_to_refine;
+                    if (peak_rss_available) {
+                        run.peak_rss = memory_usage::peak_rss();
+                    }
+                    run.iterations = result.statistics.iterations;
+                    run.edge_cut = metrics::edge_cut(result.partitions, graph);
+                    tie(run.comm_volume, run.max_comm_volume) = metrics::communication_volume(result.partitions, graph);
+                    run.maximum_imbalance = result.statistics.maximum_imbalance;
+                    runs.push_back(run);
+
+                    cout << "  k=" << k << " epsilon=" << epsilon << " threads=" << t
+                         << ": initial " << run.initial_time << " ms, refine " << run.refine_time << " ms"
+                         << ", edge cut " << run.edge_cut << ", imbalance " << run.maximum_imbalance << endl;
+                }
+            }
+        }
+    }
+
+    map<Configuration, vector<const Run*>> by_configuration;
+    for (const Run& run : runs) {
+        by_configuration[Configuration(run.partitions, run.epsilon, run.threads)].push_back(&run);
+    }
+
+    bool regression = false;
+    map<Configuration, map<string, optional<double>>> exponents;
+    cout << endl << left << setw(8) << "k" << setw(10) << "epsilon" << setw(10) << "threads" << right;
+    for (const string& phase : phases) {
+        cout << setw(10) << phase;
+    }
+    cout << endl;
+    for (const auto& [configuration, configuration_runs] : by_configuration) {
+        cout << left << setw(8) << get<0>(configuration) << setw(10) << get<1>(configuration)
+             << setw(10) << get<2>(configuration) << right;
+        for (const string& phase : phases) {
+            auto exponent = scaling_exponent(configuration_runs, phase);
+            exponents[configuration][phase] = exponent;
+            if (exponent) {
+                cout << setw(10) << fixed << setprecision(2) << *exponent << defaultfloat;
+            } else {
+                cout << setw(10) << "-";
+            }
+
+            if (exponent and max_exponent and phase != "peak_rss" and *exponent > *max_exponent) {
+                regression = true;
+            }
+        }
+        cout << endl;
+    }
+
+    if (output_file and not write_results(*output_file, runs, exponents)) {
+        cerr << "Unable to write output file " << *output_file << endl;
+        return 1;
+    }
+
+    if (regression) {
+        cout << "Some phase scales worse than vertices^" << *max_exponent << endl;
+    }
+
+    return regression ? regression_status : 0;
+}
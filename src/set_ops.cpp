@@ -0,0 +1,169 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+
+#include "set_ops.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+namespace set_ops {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+struct AtomicStats {
+    atomic<uint64_t> calls{0};
+    atomic<uint64_t> nanoseconds{0};
+    atomic<uint64_t> input_pieces{0};
+    atomic<uint64_t> output_pieces{0};
+};
+
+
+atomic<bool> counting(false);
+
+AtomicStats stats[number_of_operations][number_of_phases];
+
+thread_local Phase current_phase = Phase::OTHER;
+
+}
+
+
+const char* operation_name(Operation operation)
+{
+    static const char* names[number_of_operations] = {"image", "preImage", "intersection", "difference", "cup", "canonize"};
+    return names[size_t(operation)];
+}
+
+
+const char* phase_name(Phase phase)
+{
+    static const char* names[number_of_phases] = {"other", "build", "dfs", "initial partition", "kl", "diffusion"};
+    return names[size_t(phase)];
+}
+
+
+void enable_counters()
+{
+    counting.store(true, memory_order_release);
+}
+
+
+bool counters_enabled()
+{
+    return counting.load(memory_order_relaxed);
+}
+
+
+Stats counters()
+{
+    Stats result;
+    for (size_t o = 0; o < number_of_operations; o++) {
+        for (size_t p = 0; p < number_of_phases; p++) {
+            result[o][p].calls = stats[o][p].calls.load(memory_order_relaxed);
+            result[o][p].nanoseconds = stats[o][p].nanoseconds.load(memory_order_relaxed);
+            result[o][p].input_pieces = stats[o][p].input_pieces.load(memory_order_relaxed);
+            result[o][p].output_pieces = stats[o][p].output_pieces.load(memory_order_relaxed);
+        }
+    }
+
+    return result;
+}
+
+
+void reset_counters()
+{
+    for (auto& operation_stats : stats) {
+        for (auto& phase_stats : operation_stats) {
+            phase_stats.calls = 0;
+            phase_stats.nanoseconds = 0;
+            phase_stats.input_pieces = 0;
+            phase_stats.output_pieces = 0;
+        }
+    }
+}
+
+
+void print_counters(ostream& os)
+{
+    const Stats result = counters();
+    const auto flags = os.flags();
+
+    os << left << setw(18) << "phase" << setw(14) << "operation" << right
+       << setw(12) << "calls" << setw(12) << "ms"
+       << setw(14) << "pieces in" << setw(14) << "pieces out" << endl;
+    for (size_t p = 0; p < number_of_phases; p++) {
+        for (size_t o = 0; o < number_of_operations; o++) {
+            const OperationStats& s = result[o][p];
+            if (s.calls == 0) {
+                continue;
+            }
+
+            os << left << setw(18) << phase_name(Phase(p)) << setw(14) << operation_name(Operation(o)) << right
+               << setw(12) << s.calls << setw(12) << fixed << setprecision(2) << s.nanoseconds / 1e6
+               << setw(14) << s.input_pieces << setw(14) << s.output_pieces << endl;
+        }
+    }
+
+    os.flags(flags);
+}
+
+
+PhaseScope::PhaseScope(Phase phase)
+    : _previous(current_phase)
+{
+    current_phase = phase;
+}
+
+
+PhaseScope::~PhaseScope()
+{
+    current_phase = _previous;
+}
+
+
+namespace detail {
+
+uint64_t now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void record(Operation operation, uint64_t nanoseconds, uint64_t input_pieces, uint64_t output_pieces)
+{
+    AtomicStats& s = stats[size_t(operation)][size_t(current_phase)];
+    s.calls.fetch_add(1, memory_order_relaxed);
+    s.nanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+    s.input_pieces.fetch_add(input_pieces, memory_order_relaxed);
+    s.output_pieces.fetch_add(output_pieces, memory_order_relaxed);
+}
+
+}
+
+}
+
+}
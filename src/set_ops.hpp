@@ -0,0 +1,168 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+#include <sbg/sbg.hpp>
+
+
+namespace sbg_partitioner {
+
+/// Instrumented wrappers of the SBG set operations, where almost all the time of the
+/// partitioner goes. They forward to the SBG library and, once counters are enabled,
+/// count the calls, the time and the set pieces of the operands and results of each
+/// operation in each phase of the pipeline. Call them qualified, set_ops::image(...),
+/// unqualified calls find the SBG functions by argument dependent lookup.
+namespace set_ops {
+
+enum class Operation { IMAGE, PRE_IMAGE, INTERSECTION, DIFFERENCE, CUP, CANONIZE };
+
+constexpr size_t number_of_operations = 6;
+
+
+enum class Phase { OTHER, BUILD, DFS, INITIAL_PARTITION, KL, DIFFUSION };
+
+constexpr size_t number_of_phases = 6;
+
+
+const char* operation_name(Operation operation);
+
+const char* phase_name(Phase phase);
+
+
+struct OperationStats {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t input_pieces = 0;   // set pieces of the set operands, maps are not counted
+    uint64_t output_pieces = 0;
+};
+
+
+/// Stats of each operation in each phase, stats[operation][phase].
+using Stats = std::array<std::array<OperationStats, number_of_phases>, number_of_operations>;
+
+
+/// Starts counting. Until it is called wrappers only check a flag.
+void enable_counters();
+
+bool counters_enabled();
+
+/// Returns the stats counted so far, of every thread.
+Stats counters();
+
+void reset_counters();
+
+/// Prints a table with the operations of each phase that were called.
+void print_counters(std::ostream& os);
+
+
+/// Sets the phase of the operations of this thread while it lives. Threads start in
+/// Phase::OTHER, so workers have to set their own phase.
+class PhaseScope
+{
+public:
+    PhaseScope(Phase phase);
+    ~PhaseScope();
+
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    Phase _previous;
+};
+
+
+namespace detail {
+
+inline uint64_t pieces(const SBG::LIB::OrdSet& set) { return set.pieces().size(); }
+
+template<typename T>
+uint64_t pieces(const T&) { return 0; }
+
+uint64_t now();
+
+void record(Operation operation, uint64_t nanoseconds, uint64_t input_pieces, uint64_t output_pieces);
+
+
+template<typename F, typename... Args>
+auto counted(Operation operation, F&& function, const Args&... args)
+{
+    if (not counters_enabled()) {
+        return function();
+    }
+
+    const uint64_t start = now();
+    auto result = function();
+    record(operation, now() - start, (pieces(args) + ... + 0), pieces(result));
+
+    return result;
+}
+
+}
+
+
+template<typename... Args>
+auto image(const Args&... args)
+{
+    return detail::counted(Operation::IMAGE, [&] () { return SBG::LIB::image(args...); }, args...);
+}
+
+
+template<typename... Args>
+auto preImage(const Args&... args)
+{
+    return detail::counted(Operation::PRE_IMAGE, [&] () { return SBG::LIB::preImage(args...); }, args...);
+}
+
+
+template<typename A, typename B>
+auto intersection(const A& a, const B& b)
+{
+    return detail::counted(Operation::INTERSECTION, [&] () { return SBG::LIB::intersection(a, b); }, a, b);
+}
+
+
+template<typename A, typename B>
+auto difference(const A& a, const B& b)
+{
+    return detail::counted(Operation::DIFFERENCE, [&] () { return SBG::LIB::difference(a, b); }, a, b);
+}
+
+
+template<typename A, typename B>
+auto cup(const A& a, const B& b)
+{
+    return detail::counted(Operation::CUP, [&] () { return SBG::LIB::cup(a, b); }, a, b);
+}
+
+
+template<typename A>
+auto canonize(const A& a)
+{
+    return detail::counted(Operation::CANONIZE, [&] () { return SBG::LIB::canonize(a); }, a);
+}
+
+}
+
+}
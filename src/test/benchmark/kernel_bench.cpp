@@ -0,0 +1,302 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <getopt.h>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <rapidjson/filewritestream.h>
+#include <rapidjson/prettywriter.h>
+
+#include <build_sb_graph.hpp>
+#include <kernighan_lin_partitioner.hpp>
+
+using namespace SBG::LIB;
+using namespace sbg_partitioner;
+
+namespace {
+
+/// Keeps the results of the kernels alive, so the compiler can not remove them.
+volatile size_t sink = 0;
+
+struct Shape {
+  unsigned dimensions;
+  unsigned pieces;
+  unsigned size;  // elements of each dimension of each piece
+};
+
+struct Result {
+  std::string kernel;
+  Shape shape;
+  size_t iterations;  // of each sample
+  double min_ns;
+  double median_ns;
+};
+
+/// Model of a chain of pieces, each one with size^dimensions elements connected one to
+/// one to the elements of the previous piece.
+std::string chain_model(const Shape& shape)
+{
+  auto expression = [&shape]() {
+    std::string exp = "[";
+    for (unsigned d = 0; d < shape.dimensions; d++) {
+      exp += std::string(d > 0 ? "," : "") + "[1,0]";
+    }
+    return exp + "]";
+  };
+
+  std::ostringstream model;
+  model << "{\"nodes\":[";
+  for (unsigned i = 1; i <= shape.pieces; i++) {
+    model << (i > 1 ? "," : "") << "{\"id\":" << i << ",\"interval\":[";
+    for (unsigned d = 0; d < shape.dimensions; d++) {
+      model << (d > 0 ? "," : "") << "[1," << shape.size << "]";
+    }
+    model << "],\"lhs\":[{\"id\":\"x" << i << "\",\"exp\":" << expression() << ",\"defs\":[]}],\"rhs\":[";
+    if (i > 1) {
+      model << "{\"id\":\"x" << i - 1 << "\",\"exp\":" << expression() << ",\"defs\":[" << i - 1 << "]}";
+    }
+    model << "]}";
+  }
+  model << "]}";
+
+  return model.str();
+}
+
+/// Runs kernel in batches of iterations that take at least min_time ms, and returns the
+/// time of each call of the fastest and the median batch.
+Result measure(const std::string& name, const Shape& shape, double min_time, unsigned samples, const std::function<size_t()>& kernel)
+{
+  using clock = std::chrono::steady_clock;
+
+  auto run = [&kernel](size_t iterations) {
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      sink = sink + kernel();
+    }
+    return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+  };
+
+  size_t iterations = 1;
+  while (run(iterations) < min_time * 1e6 and iterations < (size_t(1) << 30)) {
+    iterations *= 2;
+  }
+
+  std::vector<double> times;
+  for (unsigned s = 0; s < samples; s++) {
+    times.push_back(run(iterations) / iterations);
+  }
+  std::sort(times.begin(), times.end());
+
+  return Result{name, shape, iterations, times.front(), times[times.size() / 2]};
+}
+
+std::vector<Result> run_kernels(const Shape& shape, double min_time, unsigned samples)
+{
+  WeightedSBGraph graph = build_sb_graph_from_json(chain_model(shape));
+  const auto node_weights = graph.get_node_weights();
+  const auto edge_costs = graph.get_edge_costs();
+
+  std::vector<SetPiece> pieces(graph.V().pieces().begin(), graph.V().pieces().end());
+
+  // partitions a and b are the first and the second half of the chain
+  OrdSet a, b;
+  for (size_t i = 0; i < pieces.size(); i++) {
+    (i < (pieces.size() + 1) / 2 ? a : b).emplace(pieces[i]);
+  }
+  const OrdSet first(pieces.front());
+  const OrdSet boundary_a(pieces[(pieces.size() - 1) / 2]);
+  const OrdSet boundary_b = pieces.size() > 1 ? OrdSet(pieces[(pieces.size() + 1) / 2]) : boundary_a;
+  const OrdSet middle(pieces[pieces.size() / 2]);
+
+  OrdSet edges;
+  for (const auto& map : graph.map1().maps()) {
+    edges = cup(edges, map.dom());
+  }
+
+  const size_t half = get_node_size(first, node_weights) / 2;
+
+  std::vector<Result> results;
+  auto add = [&](const std::string& name, const std::function<size_t()>& kernel) {
+    results.push_back(measure(name, shape, min_time, samples, kernel));
+  };
+
+  // kernels that modify their input run on a copy of it
+  add("cut_interval_by_dimension", [&]() {
+    OrdSet set = first;
+    return cut_interval_by_dimension(set, node_weights, half).first.size();
+  });
+  if (shape.dimensions == 2) {
+    add("cut_bidimensional_interval", [&]() { return cut_bidimensional_interval(pieces.front(), half).first.size(); });
+  }
+  add("get_node_size", [&]() { return size_t(get_node_size(graph.V(), node_weights)); });
+  add("get_edge_set_cost", [&]() { return size_t(get_edge_set_cost(edges, edge_costs)); });
+  add("flatten_set", [&]() {
+    OrdSet set = a;
+    flatten_set(set, graph);
+    return set.size();
+  });
+  add("compute_EC_IC", [&]() { return compute_EC_IC(a, boundary_a, b, graph.map1(), graph.map2()).first.size(); });
+  add("get_c_ab", [&]() { return get_c_ab(boundary_a, boundary_b, graph.map1(), graph.map2(), edge_costs); });
+  add("get_adjacents", [&]() { return get_adjacents(graph, middle).size(); });
+
+  return results;
+}
+
+template<typename Writer>
+void write_results(Writer& writer, const std::vector<Result>& results)
+{
+  writer.StartObject();
+  writer.Key("benchmarks");
+  writer.StartArray();
+  for (const Result& result : results) {
+    writer.StartObject();
+    writer.Key("kernel");
+    writer.String(result.kernel.c_str());
+    writer.Key("dimensions");
+    writer.Uint(result.shape.dimensions);
+    writer.Key("pieces");
+    writer.Uint(result.shape.pieces);
+    writer.Key("size");
+    writer.Uint(result.shape.size);
+    writer.Key("iterations");
+    writer.Uint64(result.iterations);
+    writer.Key("min_ns");
+    writer.Double(result.min_ns);
+    writer.Key("median_ns");
+    writer.Double(result.median_ns);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+}
+
+bool parse_list(const std::string& arg, std::vector<unsigned>& values)
+{
+  std::istringstream items(arg);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    std::istringstream value_stream(item);
+    unsigned value;
+    if (!(value_stream >> value) || !value_stream.eof() || value == 0) {
+      return false;
+    }
+    values.push_back(value);
+  }
+
+  return !values.empty();
+}
+
+void usage()
+{
+  std::cout << "Usage: bench-sbg-partitioner [-p <pieces>] [-s <size_1d>] [-S <size_2d>] [-t <ms>] [-n <samples>] [-o <output>]" << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  -p <pieces>   Comma separated numbers of set pieces of the synthetic sets, default: 1,8,64" << std::endl;
+  std::cout << "  -s <size_1d>  Elements of each 1D piece, default: 1000" << std::endl;
+  std::cout << "  -S <size_2d>  Elements of each dimension of each 2D piece, default: 100" << std::endl;
+  std::cout << "  -t <ms>       Minimum time of each sample, default: 10" << std::endl;
+  std::cout << "  -n <samples>  Samples of each kernel, default: 5" << std::endl;
+  std::cout << "  -o <output>   Output json file, default: stdout" << std::endl;
+  std::cout << "  -h            Display this information and exit" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  std::vector<unsigned> pieces;
+  unsigned size_1d = 1000;
+  unsigned size_2d = 100;
+  double min_time = 10;
+  unsigned samples = 5;
+  std::optional<std::string> output;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:s:S:t:n:o:h")) != -1) {
+    switch (opt) {
+    case 'p':
+      if (!parse_list(optarg, pieces)) {
+        usage();
+        return EXIT_FAILURE;
+      }
+      break;
+    case 's':
+      size_1d = std::stoul(optarg);
+      break;
+    case 'S':
+      size_2d = std::stoul(optarg);
+      break;
+    case 't':
+      min_time = std::stod(optarg);
+      break;
+    case 'n':
+      samples = std::max(std::stoul(optarg), 1ul);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    default:
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (pieces.empty()) {
+    pieces = {1, 8, 64};
+  }
+
+  std::vector<Result> results;
+  for (unsigned dimensions : {1u, 2u}) {
+    for (unsigned p : pieces) {
+      auto shape_results = run_kernels(Shape{dimensions, p, dimensions == 1 ? size_1d : size_2d}, min_time, samples);
+      results.insert(results.end(), shape_results.begin(), shape_results.end());
+    }
+  }
+
+  FILE* file = output ? std::fopen(output->c_str(), "wb") : stdout;
+  if (file == nullptr) {
+    std::cerr << "Error opening file: " << *output << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  char buffer[64 * 1024];
+  rapidjson::FileWriteStream os(file, buffer, sizeof(buffer));
+  rapidjson::PrettyWriter<rapidjson::FileWriteStream> writer(os);
+  write_results(writer, results);
+  os.Put('\n');
+  os.Flush();
+
+  if (output) {
+    std::fclose(file);
+  }
+
+  return 0;
+}
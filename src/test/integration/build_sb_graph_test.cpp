@@ -0,0 +1,123 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "build_sb_graph.hpp"
+#include "cost_profile.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+/// Building sb graphs from models, with and without cost profiles.
+class BuildSBGraphTest : public ::testing::Test {
+  public:
+  BuildSBGraphTest()
+  {
+    _dir = std::filesystem::temp_directory_path() /
+           ("sbg-partitioner-build-test-" + std::to_string(getpid()));
+    std::filesystem::create_directories(_dir);
+  }
+
+  virtual ~BuildSBGraphTest() { std::filesystem::remove_all(_dir); }
+
+  /// Writes a model with a single node X[i] = f(X[i - 1]) for i in [1:10] and returns its path.
+  std::string write_model() const
+  {
+    const std::string filename = (_dir / "model.json").string();
+    std::ofstream file(filename);
+    file << "{\"nodes\": [{\"id\": 1, \"interval\": [[1, 10]],"
+            " \"lhs\": [{\"id\": \"X\", \"exp\": [[1, 0]], \"defs\": []}],"
+            " \"rhs\": [{\"id\": \"X\", \"exp\": [[1, -1]], \"defs\": [1]}]}]}";
+    return filename;
+  }
+
+  /// Writes contents as a model and returns its path.
+  std::string write_model(const std::string& contents) const
+  {
+    const std::string filename = (_dir / "invalid_model.json").string();
+    std::ofstream file(filename);
+    file << contents;
+    return filename;
+  }
+
+  /// Weight of the elements [begin, end] of the graph.
+  static unsigned weight(const sbg_partitioner::WeightedSBGraph& graph, int begin, int end)
+  {
+    return sbg_partitioner::get_node_size(OrdSet(SetPiece(Interval(begin, 1, end))), graph.get_node_weights());
+  }
+
+  private:
+  std::filesystem::path _dir;
+};
+
+TEST_F(BuildSBGraphTest, without_profile)
+{
+  auto graph = sbg_partitioner::build_sb_graph(write_model());
+
+  // nodes are numbered from 0
+  EXPECT_EQ(10u, weight(graph, 0, 9));
+}
+
+TEST_F(BuildSBGraphTest, invalid_model)
+{
+  // a weight array with a value that is not an integer
+  auto filename = write_model(
+      "{\"nodes\": [{\"id\": 1, \"weight\": [1, \"2\"], \"interval\": [[1, 10]],"
+      " \"lhs\": [{\"id\": \"X\", \"exp\": [[1, 0]], \"defs\": []}], \"rhs\": []}]}");
+  EXPECT_THROW(sbg_partitioner::build_sb_graph(filename), std::invalid_argument);
+
+  EXPECT_THROW(sbg_partitioner::build_sb_graph(write_model("{\"nodes\": [")), std::invalid_argument);
+}
+
+TEST_F(BuildSBGraphTest, profile_splits_ranges)
+{
+  // the mean cost per element is 2, so the first half weighs 50 and the second one 150
+  sbg_partitioner::CostProfile profile = {{1, 1, 5, 5.0}, {1, 6, 10, 15.0}};
+  auto graph = sbg_partitioner::build_sb_graph(write_model(), profile);
+
+  EXPECT_EQ(5u * 50, weight(graph, 0, 4));
+  EXPECT_EQ(5u * 150, weight(graph, 5, 9));
+}
+
+TEST_F(BuildSBGraphTest, profile_overlapping_measures_add_up)
+{
+  // 20 over 15 measured elements, [1:5] costs 1 per element and [6:10] costs 1 + 2
+  sbg_partitioner::CostProfile profile = {{1, 1, 10, 10.0}, {1, 6, 10, 10.0}};
+  auto graph = sbg_partitioner::build_sb_graph(write_model(), profile);
+
+  EXPECT_EQ(5u * 75, weight(graph, 0, 4));
+  EXPECT_EQ(5u * 225, weight(graph, 5, 9));
+}
+
+TEST_F(BuildSBGraphTest, profile_unmeasured_ranges_weigh_the_mean)
+{
+  // [4:5] costs 3 per element, the mean, so the whole node weighs profile_mean_weight
+  sbg_partitioner::CostProfile profile = {{1, 4, 5, 6.0}, {7, 1, 10, 1.0}};
+  auto graph = sbg_partitioner::build_sb_graph(write_model(), profile);
+
+  EXPECT_EQ(10u * sbg_partitioner::profile_mean_weight, weight(graph, 0, 9));
+}
@@ -0,0 +1,59 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+
+#include "csr_graph.hpp"
+#include "test_graphs.hpp"
+
+/// CSR expansion of 1D and 2D sb graphs.
+class CSRGraphTest : public ::testing::Test {
+  public:
+  CSRGraphTest() {}
+
+  virtual ~CSRGraphTest() {}
+};
+
+TEST_F(CSRGraphTest, chain)
+{
+  auto csr = sbg_partitioner::build_csr_graph<int32_t>(test_graphs::chain(5, 2, 3), 2);
+
+  EXPECT_EQ(5, csr.number_of_vertices());
+  EXPECT_EQ(8, csr.number_of_arcs());
+  EXPECT_EQ(std::vector<int32_t>({0, 1, 3, 5, 7, 8}), csr.xadj);
+  EXPECT_EQ(std::vector<int32_t>({1, 0, 2, 1, 3, 2, 4, 3}), csr.adjncy);
+  EXPECT_EQ(std::vector<int32_t>(5, 2), csr.vwgt);
+  EXPECT_EQ(std::vector<int32_t>(8, 3), csr.ewgt);
+}
+
+TEST_F(CSRGraphTest, grid)
+{
+  // 2x3 grid, vertex r * 3 + c is the element (r + 1, c + 1)
+  auto csr = sbg_partitioner::build_csr_graph<int64_t>(test_graphs::grid(2, 3, 4, 5), 1);
+
+  EXPECT_EQ(6, csr.number_of_vertices());
+  EXPECT_EQ(14, csr.number_of_arcs());
+  EXPECT_EQ(std::vector<int64_t>({0, 2, 5, 7, 9, 12, 14}), csr.xadj);
+  EXPECT_EQ(std::vector<int64_t>({1, 3, 0, 2, 4, 1, 5, 0, 4, 1, 3, 5, 2, 4}), csr.adjncy);
+  EXPECT_EQ(std::vector<int64_t>(6, 4), csr.vwgt);
+  EXPECT_EQ(std::vector<int64_t>(14, 5), csr.ewgt);
+}
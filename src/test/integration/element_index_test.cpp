@@ -0,0 +1,217 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "element_index.hpp"
+#include "owner_vector.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+namespace {
+
+SetPiece piece_2d(SBG::Util::INT row_begin, SBG::Util::INT row_end, SBG::Util::INT col_begin, SBG::Util::INT col_end)
+{
+  SetPiece set_piece(Interval(row_begin, 1, row_end));
+  set_piece.emplaceBack(Interval(col_begin, 1, col_end));
+  return set_piece;
+}
+
+}  // namespace
+
+/// Element numbering of 1D and 2D node sets, and the owner vectors built on it.
+class ElementIndexTest : public ::testing::Test {
+  public:
+  ElementIndexTest() {}
+
+  virtual ~ElementIndexTest() {}
+};
+
+TEST_F(ElementIndexTest, cardinality)
+{
+  EXPECT_EQ(size_t(10), sbg_partitioner::cardinality(SetPiece(Interval(0, 1, 9))));
+  EXPECT_EQ(size_t(5), sbg_partitioner::cardinality(SetPiece(Interval(0, 2, 9))));
+  EXPECT_EQ(size_t(12), sbg_partitioner::cardinality(piece_2d(1, 3, 1, 4)));
+  EXPECT_EQ(size_t(0), sbg_partitioner::cardinality(SetPiece()));
+}
+
+TEST_F(ElementIndexTest, size_1d)
+{
+  OrdSet nodes;
+  nodes.emplaceBack(SetPiece(Interval(0, 1, 9)));
+  nodes.emplaceBack(SetPiece(Interval(10, 1, 14)));
+
+  sbg_partitioner::ElementIndex index(nodes);
+
+  EXPECT_EQ(size_t(15), index.size());
+  ASSERT_EQ(size_t(2), index.number_of_nodes());
+  EXPECT_EQ(size_t(0), index.node(0).offset);
+  EXPECT_EQ(size_t(10), index.node(1).offset);
+  EXPECT_EQ(size_t(12), index.index(1, {12}));
+}
+
+TEST_F(ElementIndexTest, size_and_index_2d)
+{
+  // a 3x4 grid followed by a 2x2 one
+  OrdSet nodes;
+  nodes.emplaceBack(piece_2d(1, 3, 1, 4));
+  nodes.emplaceBack(piece_2d(4, 5, 1, 2));
+
+  sbg_partitioner::ElementIndex index(nodes);
+
+  EXPECT_EQ(size_t(16), index.size());
+  ASSERT_EQ(size_t(2), index.number_of_nodes());
+  EXPECT_EQ(size_t(0), index.node(0).offset);
+  EXPECT_EQ(size_t(12), index.node(0).size);
+  EXPECT_EQ(size_t(12), index.node(1).offset);
+  EXPECT_EQ(size_t(4), index.node(1).size);
+
+  // row-major numbering
+  EXPECT_EQ(size_t(0), index.index(0, {1, 1}));
+  EXPECT_EQ(size_t(3), index.index(0, {1, 4}));
+  EXPECT_EQ(size_t(4), index.index(0, {2, 1}));
+  EXPECT_EQ(size_t(11), index.index(0, {3, 4}));
+  EXPECT_EQ(size_t(12), index.index(1, {4, 1}));
+  EXPECT_EQ(size_t(15), index.index(1, {5, 2}));
+
+  EXPECT_EQ(size_t(1), index.find_node(piece_2d(4, 4, 2, 2)));
+  EXPECT_EQ(sbg_partitioner::ElementIndex::npos, index.find_node(piece_2d(6, 6, 1, 1)));
+}
+
+TEST_F(ElementIndexTest, ranges_2d)
+{
+  OrdSet nodes;
+  nodes.emplaceBack(piece_2d(1, 3, 1, 4));
+
+  sbg_partitioner::ElementIndex index(nodes);
+
+  // whole rows are merged into a single range
+  std::vector<std::pair<size_t, size_t>> ranges;
+  index.for_each_range(piece_2d(2, 3, 1, 4), [&ranges](size_t first, size_t last) {
+    ranges.emplace_back(first, last);
+  });
+  ASSERT_EQ(size_t(1), ranges.size());
+  EXPECT_EQ(std::make_pair(size_t(4), size_t(11)), ranges[0]);
+
+  // a column produces a range per row
+  ranges.clear();
+  index.for_each_range(piece_2d(1, 3, 2, 2), [&ranges](size_t first, size_t last) {
+    ranges.emplace_back(first, last);
+  });
+  ASSERT_EQ(size_t(3), ranges.size());
+  EXPECT_EQ(std::make_pair(size_t(1), size_t(1)), ranges[0]);
+  EXPECT_EQ(std::make_pair(size_t(5), size_t(5)), ranges[1]);
+  EXPECT_EQ(std::make_pair(size_t(9), size_t(9)), ranges[2]);
+}
+
+TEST_F(ElementIndexTest, owner_vector_1d)
+{
+  OrdSet nodes(SetPiece(Interval(0, 1, 9)));
+  sbg_partitioner::ElementIndex index(nodes);
+
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = OrdSet(SetPiece(Interval(0, 1, 3)));
+  partitions[1] = OrdSet(SetPiece(Interval(4, 1, 9)));
+
+  std::vector<uint8_t> owner(index.size(), 0xff);
+  sbg_partitioner::fill_owner_vector(partitions, index, owner.data(), 2);
+
+  EXPECT_EQ(std::vector<uint8_t>({0, 0, 0, 0, 1, 1, 1, 1, 1, 1}), owner);
+}
+
+TEST_F(ElementIndexTest, owner_vector_2d)
+{
+  OrdSet nodes;
+  nodes.emplaceBack(piece_2d(1, 3, 1, 4));
+  sbg_partitioner::ElementIndex index(nodes);
+
+  // the first two columns and the last two columns
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = OrdSet(piece_2d(1, 3, 1, 2));
+  partitions[1] = OrdSet(piece_2d(1, 3, 3, 4));
+
+  std::vector<uint16_t> owner(index.size(), 0xffff);
+  sbg_partitioner::fill_owner_vector(partitions, index, owner.data(), 1);
+
+  EXPECT_EQ(std::vector<uint16_t>({0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1}), owner);
+}
+
+TEST_F(ElementIndexTest, compress_owner_vector_1d)
+{
+  OrdSet nodes;
+  nodes.emplaceBack(SetPiece(Interval(0, 1, 9)));
+  nodes.emplaceBack(SetPiece(Interval(10, 1, 14)));
+  sbg_partitioner::ElementIndex index(nodes);
+
+  const std::vector<uint32_t> owner = {0, 0, 1, 1, 1, 2, 0, 0, 2, 2, 2, 2, 1, 1, 0};
+  auto partitions = sbg_partitioner::compress_owner_vector(owner.data(), index, 4);
+
+  ASSERT_EQ(size_t(4), partitions.size());
+  EXPECT_EQ(size_t(3), partitions[0].pieces().size());
+  EXPECT_EQ(size_t(2), partitions[1].pieces().size());
+  EXPECT_EQ(size_t(3), partitions[2].pieces().size());
+  EXPECT_EQ(size_t(0), partitions[3].pieces().size());
+
+  std::vector<uint32_t> filled(index.size(), 0xff);
+  sbg_partitioner::fill_owner_vector(partitions, index, filled.data(), 1);
+  EXPECT_EQ(owner, filled);
+}
+
+TEST_F(ElementIndexTest, compress_owner_vector_2d)
+{
+  OrdSet nodes;
+  nodes.emplaceBack(piece_2d(1, 3, 1, 4));
+  nodes.emplaceBack(piece_2d(4, 5, 1, 2));
+  sbg_partitioner::ElementIndex index(nodes);
+
+  // columns of the first node, rows of the second one
+  const std::vector<uint16_t> owner = {0, 0, 1, 1,
+                                       0, 0, 1, 1,
+                                       0, 0, 1, 1,
+                                       1, 1,
+                                       0, 0};
+  auto partitions = sbg_partitioner::compress_owner_vector(owner.data(), index, 2);
+
+  // runs repeated in consecutive rows are merged into blocks
+  ASSERT_EQ(size_t(2), partitions.size());
+  EXPECT_EQ(size_t(2), partitions[0].pieces().size());
+  EXPECT_EQ(size_t(2), partitions[1].pieces().size());
+  EXPECT_EQ(*partitions[0].begin(), piece_2d(1, 3, 1, 2));
+  EXPECT_EQ(*partitions[1].begin(), piece_2d(1, 3, 3, 4));
+
+  std::vector<uint16_t> filled(index.size(), 0xffff);
+  sbg_partitioner::fill_owner_vector(partitions, index, filled.data(), 2);
+  EXPECT_EQ(owner, filled);
+}
+
+TEST_F(ElementIndexTest, compress_owner_vector_rejects_invalid_owners)
+{
+  sbg_partitioner::ElementIndex index(OrdSet(SetPiece(Interval(0, 1, 3))));
+
+  const std::vector<uint32_t> too_large = {0, 1, 0xffffffff, 1};
+  EXPECT_TRUE(sbg_partitioner::compress_owner_vector(too_large.data(), index, 2).empty());
+
+  const std::vector<int32_t> negative = {0, 1, -1, 1};
+  EXPECT_TRUE(sbg_partitioner::compress_owner_vector(negative.data(), index, 2).empty());
+}
@@ -0,0 +1,256 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "build_sb_graph.hpp"
+#include "element_index.hpp"
+#include "kernighan_lin_partitioner.hpp"
+#include "partition_graph.hpp"
+#include "partition_metrics_api.hpp"
+#include "test_graphs.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+namespace {
+
+OrdSet range(int begin, int end) { return OrdSet(SetPiece(Interval(begin, 1, end))); }
+
+/// A chain of 10 nodes whose second constraint weighs 5 on both ends, [1:2] and [9:10],
+/// and 1 in the middle, so halves [1:5] and [6:10] balance both constraints.
+sbg_partitioner::WeightedSBGraph two_constraint_chain()
+{
+  auto graph = test_graphs::chain({{2, 1}, {6, 1}, {2, 1}});
+
+  std::vector<sbg_partitioner::NodeWeight> constraint_weights(1);
+  constraint_weights[0][range(1, 2)] = 5;
+  constraint_weights[0][range(3, 8)] = 1;
+  constraint_weights[0][range(9, 10)] = 5;
+  graph.set_constraint_weights(constraint_weights);
+
+  return graph;
+}
+
+/// Partitions {1, 3} and {2, 4} of a chain of 4 nodes, where swapping 2 and 3 reduces
+/// the edge cut from 3 to 1.
+sbg_partitioner::PartitionMap interleaved_partition()
+{
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = range(1, 1);
+  partitions[0].emplaceBack(*range(3, 3).begin());
+  partitions[1] = range(2, 2);
+  partitions[1].emplaceBack(*range(4, 4).begin());
+
+  return partitions;
+}
+
+}  // namespace
+
+/// Balance of the partitions, with targets and several constraints, and KL refinement.
+class KernighanLinPartitionerTest : public ::testing::Test {
+  public:
+  KernighanLinPartitionerTest() {}
+
+  virtual ~KernighanLinPartitionerTest() {}
+};
+
+TEST_F(KernighanLinPartitionerTest, compute_balance_with_targets)
+{
+  auto graph = test_graphs::chain(12);
+
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = range(1, 4);
+  partitions[1] = range(5, 12);
+
+  sbg_partitioner::PartitionStatistics statistics;
+  sbg_partitioner::compute_balance(graph, partitions, statistics, {1, 2});
+  EXPECT_EQ(std::vector<unsigned>({4, 8}), statistics.weights);
+  EXPECT_FLOAT_EQ(0, statistics.maximum_imbalance);
+  EXPECT_TRUE(statistics.constraint_imbalance.empty());
+
+  // without targets both partitions should weigh 6
+  sbg_partitioner::compute_balance(graph, partitions, statistics);
+  EXPECT_FLOAT_EQ(2.0 / 6, statistics.maximum_imbalance);
+}
+
+TEST_F(KernighanLinPartitionerTest, compute_balance_with_constraints)
+{
+  auto graph = two_constraint_chain();
+
+  // partitions are split at the weight keys, as flatten_set leaves them
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = range(1, 2);
+  partitions[1] = range(3, 8);
+  partitions[1].emplaceBack(*range(9, 10).begin());
+
+  sbg_partitioner::PartitionStatistics statistics;
+  sbg_partitioner::compute_balance(graph, partitions, statistics);
+  EXPECT_FLOAT_EQ(3.0 / 5, statistics.maximum_imbalance);
+  ASSERT_EQ(1u, statistics.constraint_imbalance.size());
+  EXPECT_FLOAT_EQ(3.0 / 13, statistics.constraint_imbalance[0]);
+}
+
+TEST_F(KernighanLinPartitionerTest, partitionate_graph_meets_target_bounds)
+{
+  auto graph = test_graphs::chain(12);
+
+  sbg_partitioner::PartitionOptions options;
+  options.epsilon = 0.25;
+  options.targets = {1, 2};
+  options.threads = 1;
+  auto result = sbg_partitioner::partitionate_graph(graph, options);
+
+  ASSERT_EQ(2u, result.statistics.weights.size());
+  EXPECT_EQ(12u, result.statistics.weights[0] + result.statistics.weights[1]);
+  EXPECT_LE(result.statistics.weights[0], 5u);
+  EXPECT_LE(result.statistics.weights[1], 10u);
+  EXPECT_LE(result.statistics.maximum_imbalance, options.epsilon);
+}
+
+TEST_F(KernighanLinPartitionerTest, partitionate_graph_meets_every_constraint)
+{
+  auto graph = two_constraint_chain();
+
+  sbg_partitioner::PartitionOptions options;
+  options.epsilon = 0.2;
+  options.threads = 1;
+  auto result = sbg_partitioner::partitionate_graph(graph, options);
+
+  ASSERT_EQ(2u, result.partitions.size());
+  EXPECT_LE(result.statistics.maximum_imbalance, options.epsilon);
+  ASSERT_EQ(1u, result.statistics.constraint_imbalance.size());
+  EXPECT_LE(result.statistics.constraint_imbalance[0], options.epsilon);
+}
+
+TEST_F(KernighanLinPartitionerTest, refine_partition_within_a_block)
+{
+  auto graph = test_graphs::chain(4);
+  auto partitions = interleaved_partition();
+  ASSERT_EQ(3, sbg_partitioner::metrics::edge_cut(partitions, graph));
+
+  sbg_partitioner::PartitionOptions options;
+  options.number_of_partitions = 2;
+  options.threads = 1;
+  options.blocks = {0, 0};
+  sbg_partitioner::PartitionStatistics statistics;
+  sbg_partitioner::refine_partition(graph, partitions, options, statistics);
+
+  EXPECT_EQ(1, sbg_partitioner::metrics::edge_cut(partitions, graph));
+}
+
+TEST_F(KernighanLinPartitionerTest, refine_partition_keeps_blocks)
+{
+  auto graph = test_graphs::chain(4);
+  auto partitions = interleaved_partition();
+
+  // partitions of different blocks never swap elements, even if it reduces the edge cut
+  sbg_partitioner::PartitionOptions options;
+  options.number_of_partitions = 2;
+  options.threads = 1;
+  options.blocks = {0, 1};
+  sbg_partitioner::PartitionStatistics statistics;
+  sbg_partitioner::refine_partition(graph, partitions, options, statistics);
+
+  EXPECT_EQ(3, sbg_partitioner::metrics::edge_cut(partitions, graph));
+  auto expected = interleaved_partition();
+  for (unsigned i = 0; i < 2; i++) {
+    EXPECT_EQ(sbg_partitioner::get_node_size(expected[i], graph.get_node_weights()),
+              sbg_partitioner::get_node_size(partitions[i], graph.get_node_weights()));
+    EXPECT_TRUE(SBG::LIB::isEmpty(SBG::LIB::difference(expected[i], partitions[i])));
+  }
+}
+
+TEST_F(KernighanLinPartitionerTest, partitionate_nodes_for_each_number_of_partitions)
+{
+  // a single node X[i] = f(X[i - 1]) for i in [1:10]
+  const auto filename = std::filesystem::temp_directory_path() /
+                        ("sbg-partitioner-kl-test-" + std::to_string(getpid()) + ".json");
+  {
+    std::ofstream file(filename);
+    file << "{\"nodes\": [{\"id\": 1, \"interval\": [[1, 10]],"
+            " \"lhs\": [{\"id\": \"X\", \"exp\": [[1, 0]], \"defs\": []}],"
+            " \"rhs\": [{\"id\": \"X\", \"exp\": [[1, -1]], \"defs\": [1]}]}]}";
+  }
+
+  std::vector<unsigned> numbers_of_partitions;
+  ASSERT_TRUE(sbg_partitioner::parse_partitions("2,4:8:2", numbers_of_partitions));
+  ASSERT_EQ(std::vector<unsigned>({2, 4, 6, 8}), numbers_of_partitions);
+
+  std::optional<std::string> graph_str;
+  sbg_partitioner::WeightedSBGraph graph;
+  long double time_to_build_graph, time_to_partitionate;
+  auto partitions_by_k = sbg_partitioner::partitionate_nodes(
+      filename.string(), numbers_of_partitions, 0.0, graph_str, graph, time_to_build_graph, time_to_partitionate);
+  std::filesystem::remove(filename);
+
+  // one partition of each k, and each one covers the graph without overlaps
+  ASSERT_EQ(numbers_of_partitions.size(), partitions_by_k.size());
+  for (unsigned k : numbers_of_partitions) {
+    ASSERT_EQ(1u, partitions_by_k.count(k)) << k;
+    const auto& partitions = partitions_by_k[k];
+    ASSERT_EQ(k, partitions.size());
+
+    OrdSet covered;
+    size_t elements = 0;
+    for (const auto& [id, partition] : partitions) {
+      EXPECT_LT(id, k);
+      EXPECT_TRUE(SBG::LIB::isEmpty(SBG::LIB::intersection(covered, partition))) << k;
+      covered = SBG::LIB::cup(covered, partition);
+      elements += sbg_partitioner::cardinality(partition);
+    }
+    EXPECT_EQ(10u, elements) << k;
+    EXPECT_TRUE(SBG::LIB::isEmpty(SBG::LIB::difference(graph.V(), covered))) << k;
+  }
+}
+
+TEST_F(KernighanLinPartitionerTest, refine_partition_stops_at_max_iterations)
+{
+  // the first iteration improves the interleaved partition, so KL would go on
+  auto graph = test_graphs::chain(4);
+  auto partitions = interleaved_partition();
+
+  sbg_partitioner::PartitionOptions options;
+  options.number_of_partitions = 2;
+  options.threads = 1;
+  options.max_iterations = 1;
+  sbg_partitioner::PartitionStatistics statistics;
+  sbg_partitioner::refine_partition(graph, partitions, options, statistics);
+
+  EXPECT_EQ(1u, statistics.iterations);
+  EXPECT_TRUE(statistics.budget_exhausted);
+  EXPECT_EQ(1, sbg_partitioner::metrics::edge_cut(partitions, graph));
+
+  // without a budget it runs until an iteration doesn't change anything
+  partitions = interleaved_partition();
+  options.max_iterations = 0;
+  statistics = sbg_partitioner::PartitionStatistics();
+  sbg_partitioner::refine_partition(graph, partitions, options, statistics);
+
+  EXPECT_GT(statistics.iterations, 1u);
+  EXPECT_FALSE(statistics.budget_exhausted);
+}
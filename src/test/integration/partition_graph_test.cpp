@@ -0,0 +1,306 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+#include "partition_binary_format.hpp"
+#include "partition_graph.hpp"
+#include "partition_metrics_api.hpp"
+#include "test_graphs.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+namespace {
+
+OrdSet range(int begin, int end) { return OrdSet(SetPiece(Interval(begin, 1, end))); }
+
+bool same_set(const OrdSet& a, const OrdSet& b)
+{
+  return SBG::LIB::isEmpty(SBG::LIB::difference(a, b)) and SBG::LIB::isEmpty(SBG::LIB::difference(b, a));
+}
+
+}  // namespace
+
+/// Reading and writing of partition files, and the edges between partitions.
+class PartitionGraphTest : public ::testing::Test {
+  public:
+  PartitionGraphTest()
+  {
+    _dir = std::filesystem::temp_directory_path() /
+           ("sbg-partitioner-test-" + std::to_string(getpid()));
+    std::filesystem::create_directories(_dir);
+  }
+
+  virtual ~PartitionGraphTest() { std::filesystem::remove_all(_dir); }
+
+  std::string path(const std::string& filename) const { return (_dir / filename).string(); }
+
+  /// Writes contents to filename in the test directory and returns its path.
+  std::string write(const std::string& filename, const std::string& contents) const
+  {
+    std::ofstream file(path(filename));
+    file << contents;
+    return path(filename);
+  }
+
+  /// Reads a json partition given its partitions array.
+  bool read_json(const std::string& partitions_array, sbg_partitioner::PartitionMap& partitions) const
+  {
+    auto filename = write("partition.json", "{\"partitions\": " + partitions_array + "}");
+    return sbg_partitioner::read_partition(filename, test_graphs::chain(10), partitions);
+  }
+
+  private:
+  std::filesystem::path _dir;
+};
+
+TEST_F(PartitionGraphTest, binary_round_trip)
+{
+  SetPiece grid(Interval(1, 1, 3));
+  grid.emplaceBack(Interval(5, 1, 7));
+
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0].emplaceBack(SetPiece(Interval(0, 1, 9)));
+  partitions[0].emplaceBack(SetPiece(Interval(20, 1, 29)));
+  partitions[1].emplaceBack(grid);
+  partitions[2] = OrdSet();
+
+  const std::string filename = path("partition.bin");
+  ASSERT_TRUE(sbg_partitioner::write_binary_output(partitions, filename));
+
+  sbg_partitioner::binary_output::Reader reader(filename);
+  ASSERT_TRUE(reader.is_open());
+  ASSERT_EQ(3u, reader.number_of_partitions());
+  ASSERT_EQ(2u, reader.dimensions());
+
+  auto first = reader.partition(0);
+  ASSERT_EQ(2u, first.size());
+  EXPECT_EQ(0, first.range(0, 0).begin);
+  EXPECT_EQ(9, first.range(0, 0).end);
+  EXPECT_TRUE(first.range(0, 1).empty());
+  EXPECT_EQ(20, first.range(1, 0).begin);
+  EXPECT_EQ(29, first.range(1, 0).end);
+  EXPECT_TRUE(first.range(1, 1).empty());
+
+  auto second = reader.partition(1);
+  ASSERT_EQ(1u, second.size());
+  EXPECT_EQ(1, second.range(0, 0).begin);
+  EXPECT_EQ(3, second.range(0, 0).end);
+  EXPECT_EQ(5, second.range(0, 1).begin);
+  EXPECT_EQ(7, second.range(0, 1).end);
+
+  EXPECT_EQ(0u, reader.partition(2).size());
+}
+
+TEST_F(PartitionGraphTest, binary_rejects_invalid_files)
+{
+  const std::string filename = path("partition.bin");
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = OrdSet(SetPiece(Interval(0, 1, 9)));
+  ASSERT_TRUE(sbg_partitioner::write_binary_output(partitions, filename));
+
+  // a truncated file
+  std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 1);
+  sbg_partitioner::binary_output::Reader reader;
+  EXPECT_FALSE(reader.open(filename));
+  EXPECT_FALSE(reader.is_open());
+
+  EXPECT_FALSE(reader.open(path("missing.bin")));
+}
+
+TEST_F(PartitionGraphTest, binary_rejects_crafted_headers)
+{
+  sbg_partitioner::binary_output::Header header;
+  memcpy(header.magic, sbg_partitioner::binary_output::MAGIC, sizeof(header.magic));
+  header.version = sbg_partitioner::binary_output::VERSION;
+  header.number_of_partitions = 2;
+  sbg_partitioner::binary_output::Reader reader;
+
+  // no dimensions, so any number of set pieces takes no bytes
+  header.dimensions = 0;
+  const uint64_t many_pieces[] = {uint64_t(1) << 40, uint64_t(1) << 40};
+  std::string filename = write("zero_dimensions.bin", std::string(reinterpret_cast<const char*>(&header), sizeof(header)) +
+                                                      std::string(reinterpret_cast<const char*>(many_pieces), sizeof(many_pieces)));
+  EXPECT_FALSE(reader.open(filename));
+
+  // counts whose sizes wrap around to the size of the file
+  header.dimensions = 1;
+  const uint64_t wrapping_pieces[] = {uint64_t(1) << 63, uint64_t(1) << 63};
+  filename = write("wrapping_counts.bin", std::string(reinterpret_cast<const char*>(&header), sizeof(header)) +
+                                          std::string(reinterpret_cast<const char*>(wrapping_pieces), sizeof(wrapping_pieces)));
+  EXPECT_FALSE(reader.open(filename));
+}
+
+TEST_F(PartitionGraphTest, read_partition)
+{
+  sbg_partitioner::PartitionMap partitions;
+  ASSERT_TRUE(read_json(R"([{"id": 0, "nodes": [[[1, 4]]]}, {"id": 1, "nodes": [[[5, 6]], [[7, 10]]]}])", partitions));
+  ASSERT_EQ(2u, partitions.size());
+  EXPECT_EQ(1u, partitions[0].pieces().size());
+  EXPECT_EQ(2u, partitions[1].pieces().size());
+
+  auto filename = write("partition.txt", "0\n0\n0\n1\n1\n1\n1\n0\n0\n0\n");
+  ASSERT_TRUE(sbg_partitioner::read_partition(filename, test_graphs::chain(10), partitions));
+  ASSERT_EQ(2u, partitions.size());
+  EXPECT_EQ(2u, partitions[0].pieces().size());
+  EXPECT_EQ(1u, partitions[1].pieces().size());
+}
+
+TEST_F(PartitionGraphTest, read_partition_rejects_invalid_json)
+{
+  sbg_partitioner::PartitionMap partitions;
+  EXPECT_FALSE(read_json(R"({"nodes": []})", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [1]}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[]]}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[1, 10, 1]]]}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[["1", 10]]]}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[1, 10.5]]]}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[10, 1]]]}])", partitions));
+}
+
+TEST_F(PartitionGraphTest, read_partition_rejects_wrong_coverage)
+{
+  sbg_partitioner::PartitionMap partitions;
+
+  // partitions that overlap, with the right number of elements
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[1, 5]]]}, {"id": 1, "nodes": [[[5, 9]]]}])", partitions));
+
+  // set pieces of a partition that overlap
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[1, 6]], [[5, 10]]]}])", partitions));
+
+  // elements missing, and elements out of the graph
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[1, 4]]]}, {"id": 1, "nodes": [[[6, 10]]]}])", partitions));
+  EXPECT_FALSE(read_json(R"([{"id": 0, "nodes": [[[2, 11]]]}])", partitions));
+
+  // flat files with the wrong number of elements or negative partitions
+  auto filename = write("short.txt", "0\n0\n1\n");
+  EXPECT_FALSE(sbg_partitioner::read_partition(filename, test_graphs::chain(10), partitions));
+  filename = write("negative.txt", "0\n0\n0\n0\n0\n-1\n1\n1\n1\n1\n");
+  EXPECT_FALSE(sbg_partitioner::read_partition(filename, test_graphs::chain(10), partitions));
+
+  // partitions that can not exist, there are more of them than elements
+  filename = write("too_many.txt", "0\n0\n0\n0\n0\n10\n1\n1\n1\n1\n");
+  EXPECT_FALSE(sbg_partitioner::read_partition(filename, test_graphs::chain(10), partitions));
+  filename = write("wrapping.txt", "0\n0\n0\n0\n0\n4294967295\n1\n1\n1\n1\n");
+  EXPECT_FALSE(sbg_partitioner::read_partition(filename, test_graphs::chain(10), partitions));
+
+  EXPECT_FALSE(sbg_partitioner::read_partition(path("missing.json"), test_graphs::chain(10), partitions));
+}
+
+TEST_F(PartitionGraphTest, read_partition_from_file)
+{
+  auto graph = test_graphs::chain(4);
+
+  auto partitions = sbg_partitioner::metrics::read_partition_from_file(write("owners.txt", "0\n0\n1\n1\n"), graph);
+  ASSERT_EQ(2u, partitions.size());
+  EXPECT_EQ(*OrdSet(SetPiece(Interval(1, 1, 2))).begin(), *partitions[0].begin());
+
+  // negative, non numeric and too large partitions
+  EXPECT_TRUE(sbg_partitioner::metrics::read_partition_from_file(write("negative.txt", "0\n-1\n1\n1\n"), graph).empty());
+  EXPECT_TRUE(sbg_partitioner::metrics::read_partition_from_file(write("text.txt", "0\nzero\n1\n1\n"), graph).empty());
+  EXPECT_TRUE(sbg_partitioner::metrics::read_partition_from_file(write("large.txt", "0\n4294967295\n1\n1\n"), graph).empty());
+}
+
+TEST_F(PartitionGraphTest, parse_partitions)
+{
+  std::vector<unsigned> numbers_of_partitions;
+  ASSERT_TRUE(sbg_partitioner::parse_partitions("3", numbers_of_partitions));
+  EXPECT_EQ(std::vector<unsigned>({3}), numbers_of_partitions);
+
+  // lists and ranges can be mixed, and repeated numbers are added once
+  numbers_of_partitions.clear();
+  ASSERT_TRUE(sbg_partitioner::parse_partitions("2,4:8:2,6,9:10", numbers_of_partitions));
+  EXPECT_EQ(std::vector<unsigned>({2, 4, 6, 8, 9, 10}), numbers_of_partitions);
+
+  // the step doesn't have to reach last, nor wrap around if it is large
+  numbers_of_partitions.clear();
+  ASSERT_TRUE(sbg_partitioner::parse_partitions("2:7:2,1:5:4294967295", numbers_of_partitions));
+  EXPECT_EQ(std::vector<unsigned>({2, 4, 6, 1}), numbers_of_partitions);
+
+  for (const char* invalid : {"", "-2", "+2", "0", "2:", "4:2", "2:8:0", "2;4", "2,,4", "1:100000000"}) {
+    numbers_of_partitions.clear();
+    EXPECT_FALSE(sbg_partitioner::parse_partitions(invalid, numbers_of_partitions)) << invalid;
+  }
+}
+
+TEST_F(PartitionGraphTest, connectivity_set)
+{
+  // edge 103 joins 3 and 4, and edge 106 joins 6 and 7
+  auto graph = test_graphs::chain(9);
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = range(1, 3);
+  partitions[1] = range(4, 6);
+  partitions[2] = range(7, 9);
+
+  EXPECT_TRUE(same_set(range(103, 103), sbg_partitioner::get_connectivity_set(graph, partitions, 0)));
+  EXPECT_TRUE(same_set(range(106, 106), sbg_partitioner::get_connectivity_set(graph, partitions, 2)));
+  auto middle = sbg_partitioner::get_connectivity_set(graph, partitions, 1);
+  auto boundary = range(103, 103);
+  boundary.emplaceBack(*range(106, 106).begin());
+  EXPECT_TRUE(same_set(boundary, middle));
+
+  // the middle partition is split by neighbor, while the ends only have one of them
+  auto by_partition = sbg_partitioner::get_connectivity_set_by_partition(graph, partitions, 1);
+  ASSERT_EQ(2u, by_partition.size());
+  EXPECT_TRUE(same_set(range(103, 103), by_partition[0]));
+  EXPECT_TRUE(same_set(range(106, 106), by_partition[2]));
+
+  by_partition = sbg_partitioner::get_connectivity_set_by_partition(graph, partitions, 0);
+  ASSERT_EQ(1u, by_partition.size());
+  EXPECT_TRUE(same_set(range(103, 103), by_partition[1]));
+
+  by_partition = sbg_partitioner::get_connectivity_set_by_partition(graph, partitions, 2);
+  ASSERT_EQ(1u, by_partition.size());
+  EXPECT_TRUE(same_set(range(106, 106), by_partition[1]));
+}
+
+TEST_F(PartitionGraphTest, write_output_matches_get_output)
+{
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = range(1, 3);
+  partitions[0].emplaceBack(*range(7, 10).begin());
+  partitions[1] = range(4, 6);
+
+  const auto filename = path("output.json");
+  ASSERT_TRUE(sbg_partitioner::write_output(partitions, filename));
+  std::ifstream file(filename, std::ios::binary);
+  std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(sbg_partitioner::get_output(partitions) + "\n", written);
+
+  // and it is read back as it was written
+  sbg_partitioner::PartitionMap read;
+  ASSERT_TRUE(sbg_partitioner::read_partition(filename, test_graphs::chain(10), read));
+  ASSERT_EQ(partitions.size(), read.size());
+  for (const auto& [id, partition] : partitions) {
+    EXPECT_TRUE(same_set(partition, read[id])) << id;
+  }
+
+  EXPECT_FALSE(sbg_partitioner::write_output(partitions, path("missing/output.json")));
+}
@@ -0,0 +1,110 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "csr_graph.hpp"
+#include "flat_metrics.hpp"
+#include "process_mapping.hpp"
+#include "test_graphs.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+namespace {
+
+/// Partitions of a chain of 8 nodes, two nodes each, in the order 0, 2, 1, 3 along the
+/// chain, so partitions i and i + 1 don't communicate when i is even.
+sbg_partitioner::PartitionMap shuffled_partition()
+{
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = OrdSet(SetPiece(Interval(1, 1, 2)));
+  partitions[2] = OrdSet(SetPiece(Interval(3, 1, 4)));
+  partitions[1] = OrdSet(SetPiece(Interval(5, 1, 6)));
+  partitions[3] = OrdSet(SetPiece(Interval(7, 1, 8)));
+
+  return partitions;
+}
+
+}  // namespace
+
+/// Mapping of partitions onto the ranks of a machine.
+class ProcessMappingTest : public ::testing::Test {
+  public:
+  ProcessMappingTest() {}
+
+  virtual ~ProcessMappingTest() {}
+};
+
+TEST_F(ProcessMappingTest, map_processes_is_not_worse_than_identity)
+{
+  auto graph = test_graphs::chain(8);
+  auto partitions = shuffled_partition();
+
+  // two nodes of two cores, every edge of the identity mapping crosses nodes
+  sbg_partitioner::Topology topology({{"core", 2, 1}, {"node", 2, 10}});
+  sbg_partitioner::QuotientGraph quotient_graph(graph, partitions);
+  auto mapping = sbg_partitioner::map_processes(quotient_graph, topology);
+
+  ASSERT_EQ(4u, mapping.rank_of_partition.size());
+  auto ranks = mapping.rank_of_partition;
+  std::sort(ranks.begin(), ranks.end());
+  EXPECT_EQ(std::vector<unsigned>({0, 1, 2, 3}), ranks);
+
+  EXPECT_EQ(30u, mapping.initial_communication_cost);
+  EXPECT_LE(mapping.communication_cost, mapping.initial_communication_cost);
+  EXPECT_LT(mapping.communication_cost, 30u);
+}
+
+TEST_F(ProcessMappingTest, renumber_partitions_pads_ranks)
+{
+  auto graph = test_graphs::chain(8);
+  auto partitions = shuffled_partition();
+
+  sbg_partitioner::Topology topology({{"core", 4, 1}, {"node", 2, 10}});
+  sbg_partitioner::QuotientGraph quotient_graph(graph, partitions);
+  auto mapping = sbg_partitioner::map_processes(quotient_graph, topology);
+  auto renumbered = sbg_partitioner::renumber_partitions(partitions, mapping, topology.size());
+
+  ASSERT_EQ(8u, renumbered.size());
+  unsigned empty = 0;
+  for (const auto& [rank, partition] : renumbered) {
+    empty += partition.pieces().empty();
+  }
+  EXPECT_EQ(4u, empty);
+  for (const auto& [p, partition] : partitions) {
+    EXPECT_EQ(*partition.begin(), *renumbered[mapping.rank_of_partition[p]].begin());
+  }
+}
+
+TEST_F(ProcessMappingTest, flat_metrics_skip_empty_partitions)
+{
+  auto csr = sbg_partitioner::build_csr_graph<int32_t>(test_graphs::chain(6), 1);
+
+  // partition 1 is a rank without a partition
+  std::vector<uint32_t> owner = {0, 0, 0, 2, 2, 2};
+  auto metrics = sbg_partitioner::metrics::flat_metrics(csr, owner.data(), 3);
+  EXPECT_EQ(1, metrics.edge_cut);
+  EXPECT_FLOAT_EQ(0, metrics.maximum_imbalance);
+}
@@ -0,0 +1,90 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include "quotient_graph.hpp"
+#include "test_graphs.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+/// Adjacency of partitions and its update after a swap.
+class QuotientGraphTest : public ::testing::Test {
+  public:
+  QuotientGraphTest() {}
+
+  virtual ~QuotientGraphTest() {}
+};
+
+TEST_F(QuotientGraphTest, chain)
+{
+  // edges cost 2
+  auto graph = test_graphs::chain(6, 1, 2);
+
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = OrdSet(SetPiece(Interval(1, 1, 2)));
+  partitions[1] = OrdSet(SetPiece(Interval(3, 1, 4)));
+  partitions[2] = OrdSet(SetPiece(Interval(5, 1, 6)));
+
+  sbg_partitioner::QuotientGraph quotient_graph(graph, partitions);
+  ASSERT_EQ(3u, quotient_graph.size());
+  EXPECT_TRUE(quotient_graph.connected(0, 1));
+  EXPECT_TRUE(quotient_graph.connected(2, 1));
+  EXPECT_FALSE(quotient_graph.connected(0, 2));
+  EXPECT_EQ(2u, quotient_graph.weight(0, 1));
+  EXPECT_EQ(2u, quotient_graph.weight(1, 2));
+  EXPECT_EQ(0u, quotient_graph.weight(0, 2));
+  EXPECT_EQ(1u, quotient_graph.adjacents(0).size());
+  EXPECT_EQ(2u, quotient_graph.adjacents(1).size());
+  EXPECT_EQ(4u, quotient_graph.edge_cut());
+}
+
+TEST_F(QuotientGraphTest, update_after_a_swap)
+{
+  auto graph = test_graphs::chain(6, 1, 2);
+
+  sbg_partitioner::PartitionMap partitions;
+  partitions[0] = OrdSet(SetPiece(Interval(1, 1, 2)));
+  partitions[1] = OrdSet(SetPiece(Interval(3, 1, 4)));
+  partitions[2] = OrdSet(SetPiece(Interval(5, 1, 6)));
+  sbg_partitioner::QuotientGraph quotient_graph(graph, partitions);
+
+  // 0 takes 5 from 2, and gets connected to 2, and to 1 on both sides of it
+  partitions[0].emplaceBack(SetPiece(Interval(5, 1, 5)));
+  partitions[2] = OrdSet(SetPiece(Interval(6, 1, 6)));
+  quotient_graph.update(partitions, 0, 2);
+
+  EXPECT_EQ(4u, quotient_graph.weight(0, 1));
+  EXPECT_EQ(4u, quotient_graph.weight(1, 0));
+  EXPECT_EQ(2u, quotient_graph.weight(0, 2));
+  EXPECT_FALSE(quotient_graph.connected(1, 2));
+  EXPECT_EQ(6u, quotient_graph.edge_cut());
+
+  // the same as building it again
+  sbg_partitioner::QuotientGraph rebuilt(graph, partitions);
+  for (unsigned i = 0; i < 3; i++) {
+    for (unsigned j = 0; j < 3; j++) {
+      EXPECT_EQ(rebuilt.weight(i, j), quotient_graph.weight(i, j));
+    }
+  }
+  EXPECT_EQ(rebuilt.edge_cut(), quotient_graph.edge_cut());
+}
@@ -0,0 +1,148 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include "build_sb_graph.hpp"
+#include "element_index.hpp"
+#include "repartition.hpp"
+#include "test_graphs.hpp"
+
+using SBG::LIB::Interval;
+using SBG::LIB::OrdSet;
+using SBG::LIB::SetPiece;
+
+namespace {
+
+size_t migrated_by_moves(const std::vector<sbg_partitioner::PartitionMove>& moves)
+{
+  size_t migrated = 0;
+  for (const auto& move : moves) {
+    for (const auto& set_piece : move.nodes.pieces()) {
+      migrated += sbg_partitioner::cardinality(set_piece);
+    }
+  }
+
+  return migrated;
+}
+
+}  // namespace
+
+/// Repartitioning after the node weights change.
+class RepartitionTest : public ::testing::Test {
+  public:
+  RepartitionTest() {}
+
+  virtual ~RepartitionTest() {}
+};
+
+TEST_F(RepartitionTest, partition_moves)
+{
+  sbg_partitioner::PartitionMap previous, current;
+  previous[0] = OrdSet(SetPiece(Interval(1, 1, 5)));
+  previous[1] = OrdSet(SetPiece(Interval(6, 1, 10)));
+  current[0] = OrdSet(SetPiece(Interval(1, 1, 7)));
+  current[1] = OrdSet(SetPiece(Interval(8, 1, 10)));
+
+  auto moves = sbg_partitioner::partition_moves(previous, current);
+  ASSERT_EQ(1u, moves.size());
+  EXPECT_EQ(1u, moves[0].from);
+  EXPECT_EQ(0u, moves[0].to);
+  EXPECT_EQ(2u, migrated_by_moves(moves));
+}
+
+TEST_F(RepartitionTest, balanced_partition_does_not_migrate)
+{
+  auto graph = test_graphs::chain({{5, 1}, {5, 1}});
+
+  // keys need not be 0 to k - 1
+  sbg_partitioner::PartitionMap previous;
+  previous[0] = OrdSet(SetPiece(Interval(1, 1, 5)));
+  previous[2] = OrdSet(SetPiece(Interval(6, 1, 10)));
+
+  sbg_partitioner::PartitionOptions options;
+  options.epsilon = 0.1;
+  options.migration_cost = 1;
+  auto result = sbg_partitioner::repartition(graph, previous, options);
+
+  ASSERT_EQ(2u, result.partitions.size());
+  EXPECT_EQ(1u, result.partitions.count(0));
+  EXPECT_EQ(1u, result.partitions.count(2));
+  EXPECT_EQ(0u, result.migrated);
+  EXPECT_TRUE(result.moves.empty());
+}
+
+TEST_F(RepartitionTest, diffusion_moves_load_to_the_neighbor)
+{
+  // the second half got three times heavier, 5 + 15 over two partitions of 10
+  auto graph = test_graphs::chain({{5, 1}, {5, 3}});
+
+  sbg_partitioner::PartitionMap previous;
+  previous[0] = OrdSet(SetPiece(Interval(1, 1, 5)));
+  previous[1] = OrdSet(SetPiece(Interval(6, 1, 10)));
+
+  sbg_partitioner::PartitionOptions options;
+  options.epsilon = 0.2;
+  options.migration_cost = 100;
+  auto result = sbg_partitioner::repartition(graph, previous, options);
+
+  ASSERT_EQ(2u, result.partitions.size());
+  const auto node_weights = graph.get_node_weights();
+  EXPECT_LE(sbg_partitioner::get_node_size(result.partitions[1], node_weights), 12u);
+  EXPECT_LE(sbg_partitioner::get_node_size(result.partitions[0], node_weights), 12u);
+
+  // only a few elements of the boundary move, all of them from 1 to 0
+  EXPECT_GT(result.migrated, 0u);
+  EXPECT_LE(result.migrated, 3u);
+  EXPECT_EQ(result.migrated, migrated_by_moves(result.moves));
+  for (const auto& move : result.moves) {
+    EXPECT_EQ(1u, move.from);
+    EXPECT_EQ(0u, move.to);
+  }
+}
+
+TEST_F(RepartitionTest, migration_cost_keeps_elements_in_their_partition)
+{
+  // balanced, but the pieces alternate, so the cut is 3 and swapping [3:4] with [5:6]
+  // or [1:2] with [7:8] brings it down to 1 by migrating 4 elements
+  auto graph = test_graphs::chain(8);
+
+  sbg_partitioner::PartitionMap previous;
+  previous[0] = OrdSet(SetPiece(Interval(1, 1, 2)));
+  previous[0].emplaceBack(SetPiece(Interval(5, 1, 6)));
+  previous[1] = OrdSet(SetPiece(Interval(3, 1, 4)));
+  previous[1].emplaceBack(SetPiece(Interval(7, 1, 8)));
+
+  sbg_partitioner::PartitionOptions options;
+  options.epsilon = 0.1;
+  options.threads = 1;
+
+  options.migration_cost = 0;
+  auto free_result = sbg_partitioner::repartition(graph, previous, options);
+  EXPECT_EQ(1u, free_result.statistics.edge_cut);
+  EXPECT_EQ(4u, free_result.migrated);
+
+  // the swap gains 2 in the cut but migrating costs 4
+  options.migration_cost = 1;
+  auto costly_result = sbg_partitioner::repartition(graph, previous, options);
+  EXPECT_EQ(3u, costly_result.statistics.edge_cut);
+  EXPECT_EQ(0u, costly_result.migrated);
+  EXPECT_TRUE(costly_result.moves.empty());
+}
@@ -0,0 +1,108 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "weighted_sb_graph.hpp"
+
+/// Small sb graphs shared by the integration tests.
+namespace test_graphs {
+
+/// A chain of nodes 1..n with weight, where edge 100 + i joins nodes i and i + 1 with cost.
+inline sbg_partitioner::WeightedSBGraph chain(SBG::Util::INT n, int weight = 1, unsigned cost = 1)
+{
+  using namespace SBG::LIB;
+
+  OrdSet nodes(SetPiece(Interval(1, 1, n)));
+  sbg_partitioner::NodeWeight weights{{nodes, weight}};
+  auto graph = sbg_partitioner::addSVW(nodes, weights, sbg_partitioner::WeightedSBGraph());
+
+  OrdSet edges(SetPiece(Interval(101, 1, 100 + n - 1)));
+  CanonPWMap map_1(CanonMap(edges, Exp(LExp(1, -100))));
+  CanonPWMap map_2(CanonMap(edges, Exp(LExp(1, -99))));
+  sbg_partitioner::EdgeCost costs{{edges, cost}};
+
+  return sbg_partitioner::addSEW(map_1, map_2, costs, graph);
+}
+
+/// A chain like the one above, where the nodes are split in pieces of the given lengths
+/// and node weights, numbered from 1 one after the other.
+inline sbg_partitioner::WeightedSBGraph chain(const std::vector<std::pair<SBG::Util::INT, int>>& pieces, unsigned cost = 1)
+{
+  using namespace SBG::LIB;
+
+  OrdSet nodes;
+  sbg_partitioner::NodeWeight weights;
+  SBG::Util::INT n = 0;
+  for (const auto& [length, weight] : pieces) {
+    OrdSet piece(SetPiece(Interval(n + 1, 1, n + length)));
+    nodes.emplaceBack(*piece.begin());
+    weights[piece] = weight;
+    n += length;
+  }
+  auto graph = sbg_partitioner::addSVW(nodes, weights, sbg_partitioner::WeightedSBGraph());
+
+  OrdSet edges(SetPiece(Interval(101, 1, 100 + n - 1)));
+  CanonPWMap map_1(CanonMap(edges, Exp(LExp(1, -100))));
+  CanonPWMap map_2(CanonMap(edges, Exp(LExp(1, -99))));
+  sbg_partitioner::EdgeCost costs{{edges, cost}};
+
+  return sbg_partitioner::addSEW(map_1, map_2, costs, graph);
+}
+
+/// A rows x cols grid of nodes [1:rows]x[1:cols] with weight, where each node is joined
+/// with cost to the node on its right and to the node below it.
+inline sbg_partitioner::WeightedSBGraph grid(SBG::Util::INT rows, SBG::Util::INT cols, int weight = 1, unsigned cost = 1)
+{
+  using namespace SBG::LIB;
+
+  SetPiece node_piece(Interval(1, 1, rows));
+  node_piece.emplaceBack(Interval(1, 1, cols));
+  OrdSet nodes(node_piece);
+  sbg_partitioner::NodeWeight weights{{nodes, weight}};
+  auto graph = sbg_partitioner::addSVW(nodes, weights, sbg_partitioner::WeightedSBGraph());
+
+  // horizontal edges [101:100+rows]x[1:cols-1] and vertical edges [201:200+rows-1]x[1:cols]
+  SetPiece horizontal_piece(Interval(101, 1, 100 + rows));
+  horizontal_piece.emplaceBack(Interval(1, 1, cols - 1));
+  SetPiece vertical_piece(Interval(201, 1, 200 + rows - 1));
+  vertical_piece.emplaceBack(Interval(1, 1, cols));
+  OrdSet horizontal(horizontal_piece), vertical(vertical_piece);
+
+  Exp horizontal_1(LExp(1, -100)), horizontal_2(LExp(1, -100));
+  horizontal_1.emplaceBack(LExp(1, 0));
+  horizontal_2.emplaceBack(LExp(1, 1));
+  Exp vertical_1(LExp(1, -200)), vertical_2(LExp(1, -199));
+  vertical_1.emplaceBack(LExp(1, 0));
+  vertical_2.emplaceBack(LExp(1, 0));
+
+  CanonPWMap map_1(CanonMap(horizontal, horizontal_1));
+  map_1.emplaceBack(CanonMap(vertical, vertical_1));
+  CanonPWMap map_2(CanonMap(horizontal, horizontal_2));
+  map_2.emplaceBack(CanonMap(vertical, vertical_2));
+  sbg_partitioner::EdgeCost costs{{horizontal, cost}, {vertical, cost}};
+
+  return sbg_partitioner::addSEW(map_1, map_2, costs, graph);
+}
+
+}  // namespace test_graphs
@@ -0,0 +1,121 @@
+/*****************************************************************************
+
+ This file is part of QSSModelInstance Solver.
+
+ QSSModelInstance Solver is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ QSSModelInstance Solver is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with QSSModelInstance Solver.  If not, see
+ <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const std::string SOCKET_PATH = "/tmp/sbg-partitioner-test.sock";
+
+// A response that takes longer than this fails the test instead of blocking it
+constexpr time_t RESPONSE_TIMEOUT = 60;  // s
+
+int connect_to_server()
+{
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, SOCKET_PATH.c_str(), sizeof(address.sun_path) - 1);
+
+  // the server may still be starting
+  for (int attempt = 0; attempt < 50; attempt++) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+      timeval timeout{RESPONSE_TIMEOUT, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      return fd;
+    }
+    close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  return -1;
+}
+
+std::string request(int fd, const std::string& req)
+{
+  std::string line = req + "\n";
+  send(fd, line.data(), line.size(), 0);
+
+  std::string response;
+  char c;
+  while (recv(fd, &c, 1, 0) == 1 and c != '\n') {
+    response += c;
+  }
+
+  return response;
+}
+
+size_t count(const std::string& str, const std::string& sub)
+{
+  size_t n = 0;
+  for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + 1)) {
+    n++;
+  }
+
+  return n;
+}
+
+}
+
+TEST(SBGServerTests, PartitionsRequests)
+{
+  const std::string SBG_PART = "../../bin/sbg-partitioner";
+  const std::string MODEL = "./system/gt_data/toy_example/toy_example.json";
+  const std::string SERVE_CMD = SBG_PART + " --serve " + SOCKET_PATH + " > /tmp/output_server &";
+  std::system(SERVE_CMD.c_str());
+
+  int fd = connect_to_server();
+  ASSERT_GE(fd, 0);
+
+  // the second request uses the cached graph
+  for (int i = 0; i < 2; i++) {
+    std::string response = request(fd, "{\"id\": " + std::to_string(i) + ", \"model\": \"" + MODEL + "\", \"k\": 2}");
+    EXPECT_NE(response.find("\"id\":" + std::to_string(i)), std::string::npos);
+    EXPECT_EQ(count(response, "\"nodes\""), 2u);
+    EXPECT_NE(response.find("\"edge_cut\""), std::string::npos);
+  }
+
+  std::string response = request(fd, "{\"id\": 2, \"k\": 2}");
+  EXPECT_NE(response.find("\"error\""), std::string::npos);
+
+  // invalid inline graphs are rejected before they are built
+  response = request(fd, "{\"id\": 3, \"graph\": {\"nodes\": [{\"id\": 1}]}, \"k\": 2}");
+  EXPECT_NE(response.find("\"id\":3"), std::string::npos);
+  EXPECT_NE(response.find("\"error\""), std::string::npos);
+
+  // and the service keeps answering
+  response = request(fd, "{\"id\": 4, \"model\": \"" + MODEL + "\", \"k\": 2}");
+  EXPECT_EQ(count(response, "\"nodes\""), 2u);
+
+  close(fd);
+  std::system("pkill -TERM -f 'sbg-partitioner --serve'");
+}
@@ -0,0 +1,228 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "partition_graph.hpp"
+#include "trace.hpp"
+
+
+using namespace std;
+
+
+namespace sbg_partitioner {
+
+namespace trace {
+
+// Using an unnamed namespace to define functions with internal linkage
+namespace {
+
+// Events kept by each buffer, about 20 MB, later ones are counted and dropped
+constexpr size_t max_events_per_buffer = 256 * 1024;
+
+
+struct Event {
+    const char* name;
+    const char* category;
+    long long start;     // ns since tracing was enabled
+    long long duration;  // ns
+    const char* keys[Span::max_arguments];
+    long values[Span::max_arguments];
+    unsigned arguments;
+};
+
+
+/// Events of a thread, only that thread writes them.
+struct ThreadBuffer {
+    unsigned tid;
+    vector<Event> events;
+    size_t dropped = 0;
+};
+
+
+atomic<bool> tracing(false);
+
+chrono::steady_clock::time_point epoch;
+
+// Buffers outlive their threads, e.g. the KL workers, so they can be written at the end.
+// When a thread exits its buffer is taken by the next thread that records a span, so a
+// long running process, e.g. the server, which starts threads for each request, keeps
+// as many buffers as threads it runs at once. The mutex is only taken the first time a
+// thread records a span and when it exits.
+mutex buffers_mutex;
+vector<unique_ptr<ThreadBuffer>> buffers;
+vector<ThreadBuffer*> free_buffers;
+
+
+/// Gives the buffer of a thread back when the thread exits.
+struct BufferOwner {
+    ThreadBuffer* buffer = nullptr;
+
+    ~BufferOwner()
+    {
+        if (buffer != nullptr) {
+            lock_guard<mutex> lock(buffers_mutex);
+            free_buffers.push_back(buffer);
+        }
+    }
+};
+
+
+ThreadBuffer& thread_buffer()
+{
+    thread_local BufferOwner owner;
+    if (owner.buffer == nullptr) {
+        lock_guard<mutex> lock(buffers_mutex);
+        if (free_buffers.empty()) {
+            buffers.push_back(make_unique<ThreadBuffer>());
+            owner.buffer = buffers.back().get();
+            owner.buffer->tid = buffers.size();
+            owner.buffer->events.reserve(1024);
+        } else {
+            owner.buffer = free_buffers.back();
+            free_buffers.pop_back();
+        }
+    }
+
+    return *owner.buffer;
+}
+
+
+long long now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+}
+
+
+void enable()
+{
+    epoch = chrono::steady_clock::now();
+    tracing.store(true, memory_order_release);
+}
+
+
+bool enabled()
+{
+    return tracing.load(memory_order_relaxed);
+}
+
+
+Span::Span(const char* name, const char* category)
+    : _name(name),
+    _category(category),
+    _start(enabled() ? now() : -1)
+{
+}
+
+
+Span::~Span()
+{
+    if (_start < 0) {
+        return;
+    }
+
+    Event event{_name, _category, _start, now() - _start, {}, {}, _arguments};
+    for (unsigned i = 0; i < _arguments; i++) {
+        event.keys[i] = _keys[i];
+        event.values[i] = _values[i];
+    }
+
+    ThreadBuffer& buffer = thread_buffer();
+    if (buffer.events.size() < max_events_per_buffer) {
+        buffer.events.push_back(event);
+    } else {
+        buffer.dropped++;
+    }
+}
+
+
+void Span::arg(const char* key, long value)
+{
+    if (_start < 0 or _arguments == max_arguments) {
+        return;
+    }
+
+    _keys[_arguments] = key;
+    _values[_arguments] = value;
+    _arguments++;
+}
+
+
+bool write_trace(const string& filename)
+{
+    return write_json_file(filename, [] (JsonFileWriter& writer) {
+        writer.StartObject();
+        writer.Key("displayTimeUnit");
+        writer.String("ms");
+        writer.Key("traceEvents");
+        writer.StartArray();
+        size_t dropped = 0;
+        {
+            lock_guard<mutex> lock(buffers_mutex);
+            for (const auto& thread_events : buffers) {
+                dropped += thread_events->dropped;
+                for (const Event& event : thread_events->events) {
+                    writer.StartObject();
+                    writer.Key("name");
+                    writer.String(event.name);
+                    writer.Key("cat");
+                    writer.String(event.category);
+                    writer.Key("ph");
+                    writer.String("X");
+                    writer.Key("ts");
+                    writer.Double(event.start / 1000.0);
+                    writer.Key("dur");
+                    writer.Double(event.duration / 1000.0);
+                    writer.Key("pid");
+                    writer.Uint(1);
+                    writer.Key("tid");
+                    writer.Uint(thread_events->tid);
+                    if (event.arguments > 0) {
+                        writer.Key("args");
+                        writer.StartObject();
+                        for (unsigned i = 0; i < event.arguments; i++) {
+                            writer.Key(event.keys[i]);
+                            writer.Int64(event.values[i]);
+                        }
+                        writer.EndObject();
+                    }
+                    writer.EndObject();
+                }
+            }
+        }
+        writer.EndArray();
+        writer.Key("otherData");
+        writer.StartObject();
+        writer.Key("dropped_events");
+        writer.Uint64(dropped);
+        writer.EndObject();
+        writer.EndObject();
+    });
+}
+
+}
+
+}
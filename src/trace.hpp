@@ -0,0 +1,74 @@
+/*****************************************************************************
+
+ This file is part of SBG Partitioner.
+
+ SBG Partitioner is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ SBG Partitioner is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with SBG Partitioner.  If not, see <http://www.gnu.org/licenses/>.
+
+ ******************************************************************************/
+
+
+#pragma once
+
+#include <string>
+
+
+namespace sbg_partitioner {
+
+namespace trace {
+
+/// Starts recording spans. Until it is called spans cost a flag check.
+void enable();
+
+bool enabled();
+
+
+/// Records the time between its construction and its destruction as a complete event
+/// of the Chrome trace format, in a buffer of the thread that creates it, so threads
+/// never wait for each other to record. name, category and argument keys must be
+/// string literals, only their pointers are kept. Threads that exit leave their buffer
+/// to the next thread, so their spans share a tid, and each buffer keeps a bounded
+/// number of spans, the dropped ones are counted in the trace.
+class Span
+{
+public:
+    Span(const char* name, const char* category = "partitioner");
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    /// Adds an argument shown along with the span, e.g. the KL iteration. Up to
+    /// max_arguments are kept.
+    void arg(const char* key, long value);
+
+    static constexpr unsigned max_arguments = 2;
+
+private:
+    const char* _name;
+    const char* _category;
+    long long _start;
+    const char* _keys[max_arguments];
+    long _values[max_arguments];
+    unsigned _arguments = 0;
+};
+
+
+/// Writes the recorded spans of every thread in Chrome trace json format to filename, to
+/// be opened with chrome://tracing or Perfetto. It must be called once the traced threads
+/// are done. Returns false if the file could not be written.
+bool write_trace(const std::string& filename);
+
+}
+
+}
@@ -31,8 +31,10 @@ WeightedSBGraph addSEW(CanonPWMap pw1, CanonPWMap pw2, EdgeCost costs, WeightedS
 {
     //save node weights
     auto weights = g.get_node_weights();
+    auto constraint_weights = g.get_constraint_weights();
     WeightedSBGraph graph = addSE(pw1, pw2, g);
     graph.set_node_weights(weights);
+    graph.set_constraint_weights(constraint_weights);
     graph.set_edge_costs(costs);
 
     return graph;
@@ -41,8 +43,10 @@ WeightedSBGraph addSEW(CanonPWMap pw1, CanonPWMap pw2, EdgeCost costs, WeightedS
 
 WeightedSBGraph addSVW(OrdSet nodes, NodeWeight weights, WeightedSBGraph g)
 {
+    auto constraint_weights = g.get_constraint_weights();
     WeightedSBGraph graph = addSV(nodes, g);
     graph.set_node_weights(weights);
+    graph.set_constraint_weights(constraint_weights);
 
     return graph;
 }
@@ -20,6 +20,7 @@
 
 #include <map>
 #include <iostream>
+#include <vector>
 
 #include <sbg/sbg.hpp>
 
@@ -44,6 +45,15 @@ public:
 
     int get_node_weight(const SBG::LIB::OrdSet& node_set) const { return _node_weights.at(node_set); }
 
+    /// Weights of the other balance constraints besides node weights, e.g. the memory
+    /// of each node. Each one is balanced on its own, like Metis does with ncon > 1.
+    void set_constraint_weights(std::vector<NodeWeight>& constraint_weights) { _constraint_weights = std::move(constraint_weights); }
+
+    const std::vector<NodeWeight>& get_constraint_weights() const { return _constraint_weights; }
+
+    /// Node weights are the first constraint.
+    size_t number_of_constraints() const { return 1 + _constraint_weights.size(); }
+
 
     void set_edge_costs(EdgeCost& edge_costs) { _edge_costs = std::move(edge_costs); }
 
@@ -56,6 +66,8 @@ public:
 private:
     NodeWeight _node_weights;
 
+    std::vector<NodeWeight> _constraint_weights;
+
     EdgeCost _edge_costs;
 };
 